@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <hsql/SQLParser.h>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class WhereClause;
+
+// Bloom filters over the chosen columns of a table, one per column and row
+// group, so equality scans on columns without an index can skip the groups
+// that can't hold the value. Filters live in bloom.dat inside the table
+// folder, after a header, as one fixed size record per group. Their size
+// and number of hashes follow from the group size and the false positive
+// rate they were created with.
+//
+// Values are hashed as stored, so DATE literals are hashed as the day number
+// they stand for. Registers updated or deleted leave their old
+// values behind, which only costs skipping less.
+class BloomFilter
+{
+public:
+  BloomFilter(std::string const& table_path,
+              std::vector<hsql::ColumnDefinition*> const* columns,
+              std::vector<std::string> const& filter_columns);
+
+  // Starts empty filters sized for group_rows registers per group
+  static void create(std::string const& table_path, uint32_t group_rows,
+                     double false_positive_rate, size_t column_count);
+
+  bool exists() const { return header.magic == MAGIC; }
+  uint32_t hashes() const { return header.hashes; }
+  uint32_t bits() const { return header.bits; }
+  int group(int reg_id) const { return (reg_id - 1) / header.group_rows; }
+
+  // Adds the values of a register to the filters of its group. Nothing is
+  // written until save, which merges the changes with the filters on disk
+  template <typename Row>
+  void add(int reg_id, Row const& row)
+  {
+    if (!exists())
+      return;
+    std::vector<uint64_t>& words = pending[group(reg_id)];
+    if (words.empty())
+      words.assign(filter_pos.size() * wordsPerFilter(), 0);
+    for (size_t i = 0; i < filter_pos.size(); i++)
+      set(words, i, std::string(row[filter_pos[i]]));
+  }
+  bool save();
+
+  // For every row group, whether it may hold registers matching a clause.
+  // Empty when no group can be ruled out
+  std::vector<bool> candidates(WhereClause const& clause) const;
+
+private:
+  static constexpr uint64_t MAGIC = 0x6d6f6f6c62616c66;    // "flabloom"
+
+  struct Header
+  {
+    uint64_t magic;
+    uint32_t group_rows;
+    uint32_t bits;
+    uint32_t hashes;
+    uint32_t columns;
+  };
+
+  std::string path;
+  Header header{};
+  // Positions and types of the filtered columns
+  std::vector<int> filter_pos;
+  std::vector<hsql::DataType> filter_types;
+  std::map<int, std::vector<uint64_t>> pending;
+
+  size_t wordsPerFilter() const { return header.bits / 64; }
+  // A literal compared against a column, spelled as the column stores it
+  std::string canonical(size_t column, std::string_view value) const;
+  void set(std::vector<uint64_t>& words, size_t column,
+           std::string const& value) const;
+  bool test(uint64_t const* filter, std::string const& value) const;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+struct TableStats
+{
+  // Registers that weren't deleted
+  int64_t rows = 0;
+  // Deleted registers vacuum hasn't reclaimed yet
+  int64_t deleted = 0;
+};
+
+// System catalog: the schema of every table, with its constraints, storage
+// and indexes, and its statistics, in a single binary file that is mapped
+// into memory. Opening a table reads its schema from here instead of
+// parsing its metadata.dat and listing its indexes folder, and SHOW TABLES
+// lists it instead of the data folder.
+//
+// The file starts with a header, followed by the statistics of every table
+// and then by the schemas. Schemas are only rewritten by DDL, which writes a
+// new file and renames it over the old one; they are covered by a checksum
+// and a file that fails it, or of another version, is treated as empty and
+// rebuilt from the tables. Statistics change with every statement, so they
+// are updated in place in the mapping and aren't checksummed.
+//
+// Schemas are kept as opaque records, see Table. metadata.dat stays the
+// source of truth, a record is only used while it matches it.
+class Catalog
+{
+public:
+  explicit Catalog(std::string const& path);
+  ~Catalog();
+
+  // The catalog of the data folder
+  static Catalog& instance();
+
+  // Whether the file was there and valid when it was mapped
+  bool valid() const { return this->was_valid; }
+  // Registers every table of the data folder when the file wasn't valid
+  void open();
+
+  bool find(std::string const& table, std::string& record) const;
+  // Replaces the record of a table, keeping its statistics. A new table
+  // starts with the given ones
+  void put(std::string const& table, std::string const& record,
+           TableStats const& stats = {});
+  void remove(std::string const& table);
+  // Table names, sorted
+  std::vector<std::string> tables() const;
+
+  TableStats stats(std::string const& table) const;
+  void count(std::string const& table, int64_t rows, int64_t deleted);
+
+private:
+  static constexpr uint64_t MAGIC = 0x676c746163616c66;    // "flacatlg"
+  static constexpr uint32_t VERSION = 1;
+
+  struct Header
+  {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t tables;
+    uint64_t checksum;
+  };
+
+  // Where a table's record is in the mapping, and its statistics slot
+  struct Entry
+  {
+    uint32_t slot;
+    size_t offset;
+    uint32_t size;
+  };
+
+  std::string path;
+  mutable std::mutex mutex;
+  char* data = nullptr;
+  size_t size = 0;
+  ino_t inode = 0;
+  bool was_valid = 0;
+  std::map<std::string, Entry, std::less<>> entries;
+
+  void map();
+  void unmap();
+  // Maps the file again if another process replaced it
+  void refresh();
+  TableStats* slots() const;
+  std::string_view record(Entry const& entry) const;
+
+  // A table's new record, or nullptr to drop it, and the statistics it
+  // starts with if it is new
+  struct Change
+  {
+    const std::string* record;
+    TableStats stats;
+  };
+  // Writes a new file with the changes made to the records
+  void rewrite(std::map<std::string, Change> const& changes);
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Connection to a FlaviaDB server. Each query waits for its reply, and the
+// queries of a client share one session on the server, transactions
+// included.
+class Client
+{
+  int fd = -1;
+
+public:
+  // Throws CANNOT_CONNECT when the server can't be reached
+  explicit Client(std::string const& socket_path);
+  Client(std::string const& host, uint16_t port);
+  ~Client();
+
+  Client(Client const&) = delete;
+  Client& operator=(Client const&) = delete;
+
+  // Runs a query on the server and returns everything it printed. Throws
+  // CONNECTION_LOST when the server goes away
+  std::string query(std::string const& query);
+};
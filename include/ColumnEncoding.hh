@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <hsql/SQLParser.h>
+#include <string>
+#include <string_view>
+
+class Where;
+
+enum ColumnEncoding : uint32_t
+{
+  kEncodingPlain,
+  kEncodingDictionary,
+  kEncodingRunLength,
+  kEncodingFrameOfReference,
+  kEncodingDelta,
+};
+
+// Encodings of the values of one column in a row group of a columnar table.
+// Decoded values are rows cells of the column width, padded with '\0',
+// which is also how plain chunks are stored.
+//
+//   Dictionary          distinct CHAR values, and a bit packed code per row
+//   Run length          runs of equal values, for any type
+//   Frame of reference  INT and DATE values bit packed as offsets from the
+//                       smallest one
+//   Delta               INT and DATE values bit packed as differences from
+//                       the previous one, for near sorted columns
+namespace columnEncoding
+{
+// Encodes cells with the encoding that makes them smallest. INT and DATE
+// values are only packed as numbers when they read back exactly as stored
+ColumnEncoding encode(std::string const& cells, size_t width,
+                      hsql::DataType type, std::string& chunk);
+bool decode(std::string_view chunk, ColumnEncoding encoding, size_t width,
+            uint32_t rows, std::string& cells);
+// Clears in selected the rows whose value fails a comparison, working on
+// the encoded values. Returns 0, leaving selected alone, when the chunk
+// can't be filtered that way
+bool filter(std::string_view chunk, ColumnEncoding encoding,
+            hsql::DataType type, uint32_t rows, const hsql::Expr* expr,
+            Where& where, std::string& selected);
+}    // namespace columnEncoding
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "ColumnEncoding.hh"
+#include <cstdint>
+#include <functional>
+#include <hsql/SQLParser.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <vector>
+
+enum TableStorage
+{
+  kStorageRow,
+  kStorageColumnar,
+};
+
+// Registers of a columnar table, stored PAX style: every row group of
+// group_rows consecutive register ids is one file in the registers folder,
+// holding a presence flag per register and then the values of each column
+// together. Scans only read the columns they need.
+//
+// Each column of a group is stored in the encoding that makes it smallest,
+// see ColumnEncoding. Scans check their comparisons on the encoded values
+// and only decode the registers that pass.
+//
+// Registers keep their usual "<id>.sqlito" names, so indexes, tombstones and
+// the journal treat both layouts alike. Groups are rewritten whole, through
+// a temporary file, so a crash never leaves one half written.
+class WhereClause;
+
+class ColumnStore
+{
+public:
+  ColumnStore(std::string const& regs_path,
+              std::vector<hsql::ColumnDefinition*> const* columns,
+              uint32_t group_rows);
+
+  uint32_t group_rows() const { return rows_per_group; }
+  int group(int reg_id) const { return (reg_id - 1) / rows_per_group; }
+
+  // Rebuilds the slot of a stored register, as a row table would keep it
+  bool read(int reg_id, std::string& slot) const;
+  std::vector<int> registerIds() const;
+
+  // Calls emit with every register of the groups skip doesn't rule out,
+  // given the first and last register id they may hold, that may match
+  // clause. Only the needed columns are read, the values of the rest are
+  // left empty
+  void scan(std::vector<bool> const& needed, WhereClause const* clause,
+            std::function<bool(int, int)> const& skip,
+            std::function<void(int, std::vector<std::string_view> const&)> const&
+                emit) const;
+
+  // Changes are kept until save, which rewrites every group they touch.
+  // With sync the groups are on disk when it returns. Fails, leaving the
+  // group as it was, if a group to change can't be read
+  template <typename Row>
+  void add(int reg_id, Row const& row)
+  {
+    pending[group(reg_id)].push_back(
+        {position(reg_id), 1, std::vector<std::string>(row.begin(), row.end())});
+  }
+  void erase(int reg_id)
+  {
+    pending[group(reg_id)].push_back({position(reg_id), 0, {}});
+  }
+  bool save(bool sync = 0);
+
+private:
+  static constexpr uint64_t MAGIC = 0x7075726778617066;    // "fpaxgrup"
+
+  struct Header
+  {
+    uint64_t magic;
+    uint32_t group_rows;
+    uint32_t columns;
+  };
+
+  // Where a column's values are, after the presence flags, and how they
+  // are encoded
+  struct Chunk
+  {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t encoding;
+  };
+
+  // A group in memory. Every column holds group_rows values padded with
+  // '\0' to the width of the column
+  struct Group
+  {
+    std::string present;
+    std::vector<std::string> values;
+  };
+
+  struct Change
+  {
+    int pos;
+    bool present;
+    std::vector<std::string> values;
+  };
+
+  std::string regs_path;
+  std::vector<size_t> widths;
+  std::vector<hsql::DataType> types;
+  uint32_t rows_per_group;
+  std::map<int, std::vector<Change>> pending;
+  // The last group read, since lookups tend to hit the same one, and the
+  // file it was read from. Statements reading the table at once share it
+  mutable std::mutex cache_mutex;
+  mutable int cached_group = -1;
+  mutable Group cached;
+  mutable struct stat cached_info;
+
+  int position(int reg_id) const { return (reg_id - 1) % rows_per_group; }
+  std::string groupPath(int group) const;
+  std::vector<int> groupIds() const;
+  // Reads the presence flags and chunk directory of a group. Returns the
+  // open file, or -1
+  int openGroup(int group, std::string& present,
+                std::vector<Chunk>& chunks) const;
+  bool readChunk(int fd, Chunk const& chunk, std::string& raw) const;
+  bool load(int group, Group& data, std::vector<bool> const* needed) const;
+  bool store(int group, Group const& data, bool sync) const;
+  std::string_view value(Group const& data, size_t column, int pos) const;
+};
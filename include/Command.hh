@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ColumnStore.hh"
+#include "Index.hh"
+#include <string>
+#include <vector>
+
+enum CommandType
+{
+  kCommandNone,
+  kCommandCopy,
+  kCommandCreateIndex,
+  kCommandCreateTable,
+  kCommandCreateBloomFilter,
+  kCommandBegin,
+  kCommandCommit,
+  kCommandRollback,
+};
+
+// FlaviaDB statements that the SQL parser doesn't understand. Front-ends try
+// these before handing a query to hsql.
+//
+//   COPY table FROM 'file' [DELIMITER 'c'] [HEADER];
+//   CREATE INDEX [name] ON table [USING HASH|BTREE] (column, ...)
+//       [USING HASH|BTREE] [INCLUDE (column, ...)];
+//   CREATE BLOOM FILTER ON table (column, ...) [FPR rate];
+//   BEGIN [TRANSACTION]; START TRANSACTION; COMMIT; ROLLBACK;
+//
+// CREATE INDEX is only taken here when it has a USING or INCLUDE clause.
+// CREATE TABLE is only taken here when it has PRIMARY KEY or UNIQUE
+// constraints, which are moved to constraints, or ends with
+// WITH (storage = row|columnar), which sets storage. The rest of the
+// statement is left in query for the SQL parser.
+struct Command
+{
+  CommandType type = kCommandNone;
+  std::string table_name;
+  std::string file_path;
+  char delimiter = ',';
+  bool header = 0;
+  std::vector<std::string> columns;
+  std::vector<std::string> include;
+  IndexType index_type = kIndexTree;
+  double false_positive_rate = 0.01;
+  std::string query;
+  std::vector<Constraint> constraints;
+  TableStorage storage = kStorageRow;
+
+  static Command parse(std::string const& query);
+};
@@ -23,6 +23,24 @@ enum ErrorCode
 
   INDEX_ALREADY_EXISTS,
   INDEX_NOT_INT,
+  INDEX_INVALID_TYPE,
+  HASH_INDEX_MULTI_COLUMN,
+  HASH_INDEX_INCLUDE,
+  MULTIPLE_PRIMARY_KEYS,
+  DUPLICATE_KEY,
+
+  UNREADABLE_FILE,
+  UNWRITABLE_FILE,
+
+  TRANSACTION_CONFLICT,
+  TRANSACTION_ALREADY_OPEN,
+  NO_TRANSACTION,
+  DDL_IN_TRANSACTION,
+  LOCK_TIMEOUT,
+
+  CANNOT_LISTEN,
+  CANNOT_CONNECT,
+  CONNECTION_LOST,
 };
 
 class DBException : public std::exception
@@ -42,6 +60,7 @@ public:
                        const std::string& error_table,
                        const std::string& error_column);
   std::string formatErrorMessage();
+  ErrorCode code() const { return error_code; }
   virtual const char* what() const throw();
 };
 
@@ -106,6 +125,40 @@ inline std::string DBException::formatErrorMessage()
     return "ERROR: There's already an index on column " + error_column + ".\n";
   case INDEX_NOT_INT:
     return "ERROR: Indexed column must be of type INT.\n";
+  case INDEX_INVALID_TYPE:
+    return "ERROR: Indexed columns must be of type INT or DATE.\n";
+  case HASH_INDEX_MULTI_COLUMN:
+    return "ERROR: Hash indexes can only be on a single column.\n";
+  case HASH_INDEX_INCLUDE:
+    return "ERROR: Hash indexes can't include other columns.\n";
+  case MULTIPLE_PRIMARY_KEYS:
+    return "ERROR: Table " + error_table + " can only have one PRIMARY KEY.\n";
+  case DUPLICATE_KEY:
+    return "ERROR: Duplicate value for key (" + error_column + ") of table " +
+           error_table + ".\n";
+  case UNREADABLE_FILE:
+    return "ERROR: Could not read file " + error_column + ".\n";
+  case UNWRITABLE_FILE:
+    return "ERROR: Could not write file " + error_column + ".\n";
+  case TRANSACTION_CONFLICT:
+    return "ERROR: Table " + error_table +
+           " is being changed by an older transaction.\n";
+  case TRANSACTION_ALREADY_OPEN:
+    return "ERROR: There is already a transaction in progress.\n";
+  case NO_TRANSACTION:
+    return "ERROR: There is no transaction in progress.\n";
+  case DDL_IN_TRANSACTION:
+    return "ERROR: Tables and indexes can't be created or dropped inside a "
+           "transaction.\n";
+  case LOCK_TIMEOUT:
+    return "ERROR: Gave up waiting for table " + error_table +
+           ", which another transaction is changing.\n";
+  case CANNOT_LISTEN:
+    return "ERROR: Couldn't listen on " + error_column + ".\n";
+  case CANNOT_CONNECT:
+    return "ERROR: Couldn't connect to " + error_column + ".\n";
+  case CONNECTION_LOST:
+    return "ERROR: Lost the connection to the server.\n";
 
   default:
     return "";
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// On-disk linear hashing index of (INT key, register id) entries, used for
+// equality lookups. Buckets are chains of fixed size pages: the first page of
+// bucket b is page b + 1 of hash.dat (page 0 is the header) and overflow
+// pages live in overflow.dat. Whenever the load factor goes over
+// MAX_LOAD_FACTOR the next bucket in line is split in two, so the table grows
+// one bucket at a time and a probe reads a single chain.
+class HashIndex
+{
+public:
+  static constexpr size_t PAGE_SIZE = 4096;
+  static constexpr double MAX_LOAD_FACTOR = 0.75;
+
+  struct Entry
+  {
+    int32_t key;
+    uint32_t reg_id;
+  };
+
+  explicit HashIndex(std::string const& folder);
+  ~HashIndex();
+
+  static bool exists(std::string const& folder);
+  // Creates an index sized for entries, without any splits, writing it one
+  // bucket at a time
+  static void build(std::string const& folder,
+                    std::vector<Entry> const& entries);
+
+  void insert(int key, uint32_t reg_id);
+  bool remove(int key, uint32_t reg_id);
+  std::vector<uint32_t> lookup(int key);
+  uint32_t buckets() const;
+  uint64_t size() const { return header.entries; }
+
+private:
+  static constexpr uint64_t MAGIC = 0x7864696873616866;    // "fhashidx"
+  static constexpr uint32_t INITIAL_BUCKETS = 4;
+  static constexpr size_t ENTRIES_PER_PAGE =
+      (PAGE_SIZE - 2 * sizeof(uint32_t)) / sizeof(Entry);
+
+  struct Header
+  {
+    uint64_t magic;
+    uint32_t level;
+    uint32_t next_split;
+    uint32_t overflow_pages;
+    // Head of the free overflow page list, as page number + 1
+    uint32_t free_overflow;
+    uint64_t entries;
+  };
+
+  // next is the following overflow page number + 1, 0 ends the chain
+  struct Page
+  {
+    uint32_t count;
+    uint32_t next;
+    Entry entries[ENTRIES_PER_PAGE];
+  };
+  static_assert(sizeof(Page) == PAGE_SIZE);
+
+  // A page is a primary bucket page, or an overflow page when overflow is set
+  struct PageRef
+  {
+    uint32_t number;
+    bool overflow;
+  };
+
+  int fd;
+  int overflow_fd;
+  Header header;
+
+  static uint32_t hash(int key);
+  static uint32_t bucketFor(int key, uint32_t level, uint32_t next_split);
+  void readPage(PageRef ref, Page& page) const;
+  void writePage(PageRef ref, Page const& page) const;
+  void writeHeader() const;
+  uint32_t allocateOverflow();
+  std::vector<Entry> readChain(uint32_t bucket) const;
+  void writeChain(uint32_t bucket, std::vector<Entry> const& entries);
+  void split();
+};
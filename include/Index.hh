@@ -1,11 +1,111 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
 
+class Where;
+
+enum IndexType
+{
+  kIndexTree,
+  kIndexHash,
+};
+
+enum ConstraintType
+{
+  kConstraintPrimaryKey,
+  kConstraintUnique,
+};
+
+// PRIMARY KEY or UNIQUE constraint over INT columns. It is enforced through
+// the tree index on its columns, created along with the table
+struct Constraint
+{
+  ConstraintType type;
+  std::vector<std::string> columns;
+};
+
+// Register an index lookup found, with the values the index keeps for it:
+// those of the index columns followed by those of its included columns
+struct IndexEntry
+{
+  std::string filename;
+  std::vector<std::string> values;
+};
+
+// Index over an ordered list of INT or DATE columns, kept in its own folder
+// inside the table's indexes folder and named after its columns joined by
+// commas. Tree indexes hold a folder per value of the first column, which
+// holds a folder per value of the second one and so on, with a file per
+// register at the bottom. Tree indexes may also include other columns of any
+// type: their values are stored in the register's file and the index name
+// lists them after a '+'. Hash indexes are a HashIndex over a single INT
+// column and only serve equality lookups.
 struct Index
 {
   std::string name;
+  std::string path;
+  std::vector<std::string> columns;
+  std::vector<int> column_pos;
+  IndexType type;
+  std::vector<std::string> include;
+  std::vector<int> include_pos;
 
-  Index(std::string name) : name(name) {}
+  Index(std::string name, std::string path, std::vector<std::string> columns,
+        std::vector<int> column_pos, IndexType type = kIndexTree,
+        std::vector<std::string> include = {},
+        std::vector<int> include_pos = {})
+      : name(name), path(path), columns(columns), column_pos(column_pos),
+        type(type), include(include), include_pos(include_pos)
+  {
+  }
   ~Index() {}
+
+  static std::string nameFor(std::vector<std::string> const& columns,
+                             std::vector<std::string> const& include = {});
+
+  // Key of a register, as the path of its folder inside the index
+  template <typename Row>
+  std::string key(Row const& row) const
+  {
+    std::string key;
+    for (const auto& pos : column_pos)
+    {
+      key += row[pos];
+      key += '/';
+    }
+    return key;
+  }
+
+  // Included values of a register, as stored in its file inside the index
+  template <typename Row>
+  std::string payload(Row const& row) const
+  {
+    std::string payload;
+    for (const auto& pos : include_pos)
+    {
+      payload += row[pos];
+      payload += '\t';
+    }
+    return payload;
+  }
+
+  // Whether the index keeps the values of a column
+  bool covers(int column_pos) const;
+
+  void add(std::string const& key, std::string const& filename,
+           std::string const& payload = "") const;
+  void remove(std::string const& key, std::string const& filename) const;
+  // Register files under a key prefix, given as one value per leading
+  // column. When range is set, it filters the values of the next column
+  std::vector<std::string> lookup(std::vector<std::string> const& prefix,
+                                  Where* range = nullptr) const;
+  // Same as lookup, but also returns the values kept for every register so
+  // they can be used without reading the register files
+  std::vector<IndexEntry> scan(std::vector<std::string> const& prefix,
+                               Where* range = nullptr) const;
+  // Adds a batch of registers at once, sorting the entries in parallel
+  void bulk_add(std::vector<const std::vector<std::string>*> const& rows,
+                std::vector<const std::string*> const& filenames) const;
 };
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Before and after images of the registers a statement rewrites in place,
+// or everything a transaction writes to a table at COMMIT: registers it
+// created or changed, with an empty before image, and registers it deleted.
+// Every record is written and synced, followed by a commit mark, before any
+// register is overwritten. The journal is removed once all registers are
+// written and synced, so a crash halfway through is repaired on the next
+// open by replaying the after images and deletions of a committed journal.
+class Journal
+{
+  std::string path;
+  std::string table_path;
+  std::string regs_path;
+  std::string buffer;
+
+public:
+  explicit Journal(std::string const& table_path,
+                   std::string const& regs_path);
+
+  void log_update(std::string const& filename, std::string const& before,
+                  std::string const& after);
+  void log_delete(std::string const& filename);
+  bool commit();
+  void clear();
+
+  // Replays a committed journal left behind by a crash, handing every after
+  // image to write_slot with the filename of its register, and the deleted
+  // registers to mark_deleted
+  static void recover(
+      std::string const& table_path,
+      std::function<bool(std::string const&, std::string const&)> const&
+          write_slot,
+      std::function<bool(std::vector<std::string> const&)> const&
+          mark_deleted);
+};
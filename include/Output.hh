@@ -0,0 +1,33 @@
+#pragma once
+
+#include <ostream>
+#include <sstream>
+#include <string>
+
+// Where statements print their messages and errors. Normally stdout and
+// stderr, but a thread running statements for a server client collects
+// everything they print, in order, to send it back as the reply.
+namespace output
+{
+std::ostream& out();
+std::ostream& err();
+// Stream collecting what the calling thread prints, or nullptr
+std::ostream* captured();
+
+// Captures what the calling thread prints while it lives. Captures nest
+class Capture
+{
+  std::ostringstream buffer;
+  Capture* previous;
+
+public:
+  Capture();
+  ~Capture();
+
+  Capture(Capture const&) = delete;
+  Capture& operator=(Capture const&) = delete;
+
+  std::ostream& stream() { return buffer; }
+  std::string str() const { return buffer.str(); }
+};
+}    // namespace output
@@ -1,27 +1,66 @@
 #pragma once
 
+#include "BloomFilter.hh"
+#include "Command.hh"
+#include "ResultCache.hh"
+#include "ResultSink.hh"
+#include "Settings.hh"
 #include "Table.hh"
+#include "TableLock.hh"
+#include "Vacuum.hh"
 #include "Where.hh"
+#include "ZoneMap.hh"
 #include "filestruct.hh"
 #include "printutils.hh"
+#include <algorithm>
 #include <filesystem>
 
+// Every statement locks the table it uses for as long as it runs: SELECT
+// shares it with other readers, and statements changing it take it alone.
+// Statements given a transaction run inside it, and see what it changed;
+// otherwise each runs in one of its own
 class Processor
 {
   Processor();
   ~Processor();
 
   // std::vector< std::unique_ptr<Table> > tables;
+
+  // Registers a statement has to look at. When an index serves the clause
+  // only the registers it returns are loaded, and otherwise only those in
+  // the row groups the zone map can't rule out, unless all of them are
+  // loaded already
+  static RegisterList* candidate_registers(WhereClause const& clause,
+                                           std::unique_ptr<Table> const& table,
+                                           RegisterList& indexed_regs);
+
 public:
   static bool insert_record(const hsql::InsertStatement* stmt,
-                            std::unique_ptr<Table> const& table);
+                            std::unique_ptr<Table> const& table,
+                            Transaction* txn = nullptr);
   static bool show_records(const hsql::SelectStatement* stmt,
-                           std::unique_ptr<Table> const& table);
+                           std::unique_ptr<Table> const& table,
+                           Transaction* txn = nullptr);
   static bool update_records(const hsql::UpdateStatement* stmt,
-                             std::unique_ptr<Table> const& table);
+                             std::unique_ptr<Table> const& table,
+                             Transaction* txn = nullptr);
   static bool delete_records(const hsql::DeleteStatement* stmt,
-                             std::unique_ptr<Table> const& table);
+                             std::unique_ptr<Table> const& table,
+                             Transaction* txn = nullptr);
   static bool drop_table(std::unique_ptr<Table> const& table);
-  static bool create_index(std::string column,
-                           std::unique_ptr<Table> const& table);
+  static bool create_index(std::vector<std::string> const& columns,
+                           std::unique_ptr<Table> const& table,
+                           IndexType type = kIndexTree,
+                           std::vector<std::string> const& include = {});
+  // Bloom filters on columns, for equality scans to skip row groups
+  static bool create_bloom_filter(std::vector<std::string> const& columns,
+                                  std::unique_ptr<Table> const& table,
+                                  double false_positive_rate = 0.01);
+  static bool copy_records(const Command* stmt,
+                           std::unique_ptr<Table> const& table,
+                           Transaction* txn = nullptr);
+  // Makes everything a transaction wrote durable with one journal sync per
+  // table, or undoes it, and ends the transaction
+  static bool commit(Transaction& txn);
+  static bool rollback(Transaction& txn);
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Messages between the server and its clients are frames: the length of the
+// payload as 4 big-endian bytes, then the payload. A request carries a query
+// and its reply everything running the query printed.
+namespace protocol
+{
+// Longer requests are refused, so a corrupt length can't make the server
+// buffer gigabytes. Replies can take up all 4 bytes of length
+constexpr uint32_t kMaxRequest = 64 << 20;
+
+std::string frame(std::string_view payload);
+
+enum FrameStatus
+{
+  kFrameIncomplete,
+  kFrameReady,
+  kFrameTooLarge
+};
+
+// Puts requests back together out of the bytes read from a socket, however
+// they were split up on the way
+class FrameReader
+{
+  std::string buffer;
+  size_t start = 0;
+
+public:
+  void feed(const char* data, size_t size);
+  // Takes the next frame when it has arrived whole
+  FrameStatus next(std::string& payload);
+};
+
+// Blocking writes and reads of a whole frame on a socket. They return 0 when
+// the connection is gone
+bool sendFrame(int fd, std::string_view payload);
+bool receiveFrame(int fd, std::string& payload);
+}    // namespace protocol
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Hands out register ids for a table from memory. reg_count.dat only records
+// a reservation: ids are reserved REG_ID_RESERVATION at a time, so most
+// inserts never touch the file. A checkpoint writes back the last id
+// actually used. After a crash the unused part of the last reservation is
+// skipped, so ids stay unique.
+//
+// There is a single allocator per table in the process, shared by every
+// Table handle and safe to use from several writers at once.
+class RegIdAllocator
+{
+  std::string table_name;
+  int last_id;
+  int reserved_until;
+  std::mutex mutex;
+
+  explicit RegIdAllocator(std::string const& table_name);
+
+  static std::mutex registry_mutex;
+  static std::map<std::string, std::unique_ptr<RegIdAllocator>>& registry();
+
+public:
+  ~RegIdAllocator();
+
+  static RegIdAllocator& get(std::string const& table_name);
+  // Drops the allocator of a table that was dropped or (re)created
+  static void forget(std::string const& table_name);
+
+  // Returns the first of count consecutive new ids
+  int allocate(int count = 1);
+  int last();
+  void checkpoint();
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <hsql/SQLParser.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct CachedResult
+{
+  std::vector<std::vector<std::string>> regs_data;
+  std::vector<size_t> fields_width;
+  bool indexed = 0;
+  size_t bytes = 0;
+};
+
+// Opt-in cache of SELECT results. Entries are keyed on the normalized
+// statement plus the version counter of the table it reads, and every write
+// to a table bumps that counter and drops the table's cached results.
+// Sessions share the cache, and a result found stays valid for as long as
+// it is held even if it is evicted meanwhile.
+class ResultCache
+{
+public:
+  static ResultCache& instance();
+
+  void enable(size_t byte_budget);
+  void disable();
+  bool enabled() const { return byte_budget > 0; }
+
+  std::string key_for(const hsql::SelectStatement* stmt,
+                      std::string const& table_name);
+  std::shared_ptr<const CachedResult> find(std::string const& key);
+  void store(std::string const& key, std::string const& table_name,
+             CachedResult result);
+  void bump(std::string const& table_name);
+  unsigned long version(std::string const& table_name) const;
+
+  size_t budget() const { return byte_budget; }
+  size_t used() const;
+  size_t entries() const;
+  // Counted as sessions go, so they can be read at any time
+  std::atomic<unsigned long> hits = 0;
+  std::atomic<unsigned long> misses = 0;
+  std::atomic<unsigned long> evictions = 0;
+
+private:
+  ResultCache() = default;
+
+  struct Entry
+  {
+    std::string key;
+    std::string table_name;
+    std::shared_ptr<const CachedResult> result;
+  };
+
+  void evict(std::list<Entry>::iterator it);
+
+  mutable std::mutex mutex;
+  // Only changed under the mutex, but checked without it before every query
+  std::atomic<size_t> byte_budget = 0;
+  size_t bytes_used = 0;
+  // Most recently used entries live at the front
+  std::list<Entry> lru;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_by_key;
+  std::map<std::string, unsigned long> table_versions;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Settings.hh"
+#include <hsql/SQLParser.h>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Append-only buffer in front of a file descriptor. It grows with the
+// output and is written out with write(2) once it reaches capacity, so
+// formatting never goes through iostreams and small results stay small.
+// Output meant for stdout goes to the capture of the thread instead when
+// there is one.
+class OutputBuffer
+{
+  std::string buffer;
+  size_t capacity;
+  int fd;
+  bool owns_fd;
+  std::ostream* captured;
+
+public:
+  explicit OutputBuffer(int fd, bool owns_fd = 0, size_t capacity = 1 << 20);
+  ~OutputBuffer();
+
+  void append(std::string_view data)
+  {
+    buffer.append(data);
+    if (buffer.size() >= capacity)
+      flush();
+  }
+  void append(char c)
+  {
+    buffer.push_back(c);
+    if (buffer.size() >= capacity)
+      flush();
+  }
+  void append(size_t count, char c)
+  {
+    buffer.append(count, c);
+    if (buffer.size() >= capacity)
+      flush();
+  }
+  void flush();
+};
+
+// A result row as views into storage. Sinks copy values only when they
+// have to keep the row around.
+typedef std::vector<std::string_view> RowView;
+
+// Destination of a SELECT result. Each output format decides how rows are
+// laid out; all of them write through a single OutputBuffer.
+class ResultSink
+{
+protected:
+  OutputBuffer out;
+  std::vector<std::string> field_names;
+  std::vector<hsql::DataType> field_types;
+  std::vector<size_t> fields_width;
+  size_t row_count = 0;
+
+  ResultSink(int fd, bool owns_fd, std::vector<hsql::Expr*>* fields,
+             std::vector<hsql::DataType> field_types,
+             std::vector<size_t> fields_width);
+
+public:
+  // Builds the sink selected in Settings. Results go to stdout unless an
+  // output file was configured
+  static std::unique_ptr<ResultSink>
+  make(std::vector<hsql::Expr*>* fields,
+       std::vector<hsql::DataType> field_types,
+       std::vector<size_t> fields_width);
+  virtual ~ResultSink() {}
+
+  virtual void add_row(const RowView& row) = 0;
+  virtual void finish() { out.flush(); }
+  size_t rows() const { return row_count; }
+  const std::vector<size_t>& widths() const { return fields_width; }
+};
+
+// The classic boxed table. When buffering, every row is kept so column
+// widths fit the data. When streaming, widths are fixed up front (from
+// column definitions or a bounded sample of rows) and rows are written as
+// soon as they are produced.
+class BoxSink : public ResultSink
+{
+  bool streaming;
+  size_t sample_rows;
+  bool header_written = 0;
+  std::vector<std::vector<std::string>> pending;
+
+  template <typename Row>
+  void write_row(const Row& row, char separator = '|');
+  void flush_pending();
+
+public:
+  BoxSink(int fd, bool owns_fd, std::vector<hsql::Expr*>* fields,
+          std::vector<hsql::DataType> field_types,
+          std::vector<size_t> fields_width, bool streaming,
+          size_t sample_rows);
+  void add_row(const RowView& row);
+  void finish();
+};
+
+// Comma or tab separated values with a header line. CSV quotes fields as
+// in RFC 4180, TSV backslash-escapes tabs, newlines and backslashes.
+class DelimitedSink : public ResultSink
+{
+  char delimiter;
+
+  void write_field(std::string_view data);
+
+public:
+  DelimitedSink(int fd, bool owns_fd, std::vector<hsql::Expr*>* fields,
+                std::vector<hsql::DataType> field_types, char delimiter);
+  void add_row(const RowView& row);
+};
+
+// One JSON object per row. INT values are written as numbers.
+class JsonLinesSink : public ResultSink
+{
+  void write_string(std::string_view data);
+
+public:
+  JsonLinesSink(int fd, bool owns_fd, std::vector<hsql::Expr*>* fields,
+                std::vector<hsql::DataType> field_types);
+  void add_row(const RowView& row);
+};
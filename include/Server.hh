@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Protocol.hh"
+#include "Session.hh"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Serves the database to other processes over a Unix domain socket or a
+// localhost TCP port, so they all share its open tables and caches.
+//
+// One thread waits on every connection with epoll, reading requests and
+// writing replies without ever blocking on a client. Queries run on a pool
+// of workers, with a Session per connection: the queries of a connection
+// run one at a time and in order, those of different connections in
+// parallel. A worker takes turns between connections after every query.
+// Queries waiting for a table another client's transaction changes give up
+// after the lock timeout, so they can't hold every worker while the COMMIT
+// that would free them waits for one.
+//
+// When a client hangs up, the queries it had queued are dropped and its
+// open transaction is rolled back.
+class Server
+{
+  struct Connection
+  {
+    int fd;
+    Session session;
+    protocol::FrameReader reader;
+    // Replies the loop still has to send
+    std::string outbox;
+    bool writable_wait = 0;
+
+    // Guarded by the server mutex
+    std::deque<std::string> requests;
+    std::string replies;
+    bool running = 0;
+    bool replied = 0;
+    bool hung_up = 0;
+
+    explicit Connection(int fd) : fd(fd) {}
+  };
+
+  int listen_fd = -1;
+  int epoll_fd = -1;
+  int wake_fd = -1;
+  std::string socket_path;
+  uint16_t tcp_port = 0;
+  std::atomic<bool> stopping = 0;
+  std::map<int, std::shared_ptr<Connection>> connections;
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable jobs_cv;
+  std::deque<std::shared_ptr<Connection>> jobs;
+  std::vector<std::shared_ptr<Connection>> replied;
+  bool workers_stopping = 0;
+
+  bool setUp(size_t worker_count);
+  void closeSockets();
+  void watch(int fd, uint32_t events, int op);
+  void wake();
+  void acceptClients();
+  void readRequests(std::shared_ptr<Connection> const& connection);
+  void writeReplies(std::shared_ptr<Connection> const& connection);
+  // Sends the replies workers finished since the last wake up
+  void sendReplies();
+  void hangUp(std::shared_ptr<Connection> const& connection);
+  // Has a worker run the connection, unless one already is. Called locked
+  void schedule(std::shared_ptr<Connection> const& connection);
+  void work();
+
+public:
+  // Listens on a Unix domain socket, replacing a stale one left at the path
+  Server(std::string const& socket_path, size_t worker_count);
+  // Listens on 127.0.0.1. Port 0 picks a free one
+  Server(uint16_t port, size_t worker_count);
+  ~Server();
+
+  Server(Server const&) = delete;
+  Server& operator=(Server const&) = delete;
+
+  uint16_t port() const { return tcp_port; }
+  // Serves clients until stop() is called, then waits for the running
+  // queries and rolls back open transactions
+  void run();
+  // Safe to call from any thread
+  void stop();
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Command.hh"
+#include "TableCache.hh"
+#include "Transactions.hh"
+#include <hsql/SQLParser.h>
+#include <map>
+#include <memory>
+#include <string>
+
+// A client of the database, running its queries one at a time. Statements
+// between BEGIN and COMMIT or ROLLBACK run in the same transaction, and the
+// tables they use stay open until it ends. A transaction still open when the
+// session ends is rolled back.
+class Session
+{
+public:
+  Session() = default;
+  ~Session() { close(); }
+
+  Session(Session const&) = delete;
+  Session& operator=(Session const&) = delete;
+
+  // Runs every statement of a query, printing results and errors
+  void run(std::string const& query);
+  bool inTransaction() const { return transaction != nullptr; }
+  // Rolls back the open transaction, if any
+  void close();
+
+private:
+  std::unique_ptr<Transaction> transaction;
+  std::map<std::string, TableHandle> transaction_tables;
+
+  TableHandle table(std::string const& name);
+  void runCommand(Command const& command);
+  void runStatement(const hsql::SQLStatement* statement,
+                    Command const& command);
+  void endTransaction(bool commit);
+  // Tables and indexes are only created and dropped outside transactions
+  void checkNoTransaction() const;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "flaviadb_definitions.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class OutputMode
+{
+  BUFFERED,
+  STREAMING,
+};
+
+// Session-wide knobs. Defaults can be overridden through FLAVIADB_*
+// environment variables when a front-end starts.
+enum class OutputFormat
+{
+  BOX,
+  CSV,
+  TSV,
+  JSON,
+};
+
+struct Settings
+{
+  static Settings& get();
+  void load_from_env();
+
+  OutputFormat output_format = OutputFormat::BOX;
+  // SELECT results are appended to this file instead of stdout when set
+  std::string output_path;
+  OutputMode output_mode = OutputMode::BUFFERED;
+  // Rows buffered to size columns when streaming. 0 sizes them from the
+  // column definitions so the first row can be printed right away
+  size_t width_sample_rows = 0;
+  // 0 keeps the result cache disabled
+  size_t result_cache_bytes = 0;
+  // Open tables kept by the table cache, and the memory their registers may
+  // take. 0 leaves a limit off
+  size_t table_cache_tables = 64;
+  size_t table_cache_bytes = 256 << 20;
+  bool table_cache_stats = 0;
+  // Registers vacuum reclaims per batch, and the pause between batches.
+  // 0 rows disables background vacuum
+  size_t vacuum_batch_rows = 256;
+  int vacuum_delay_ms = 10;
+  // Registers per row group in the zone maps of new tables
+  uint32_t zone_group_rows = 1024;
+  // Threads the server runs queries on. 0 uses one per core
+  size_t server_workers = 0;
+  // Longest a statement waits for a table a transaction spanning statements
+  // has changed. 0 waits without limit
+  int lock_timeout_ms = 5000;
+};
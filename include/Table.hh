@@ -1,25 +1,71 @@
 #pragma once
 
+#include "Catalog.hh"
+#include "ColumnStore.hh"
 #include "DBException.hh"
 #include "Index.hh"
+#include "Journal.hh"
+#include "RegIdAllocator.hh"
 #include "filestruct.hh"
 #include <algorithm>    // find
+#include <atomic>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <hsql/SQLParser.h>
 #include <iostream>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 #define DATE_FORMAT "%d-%m-%Y"
 typedef std::vector<std::string> RegisterData;
+typedef std::list<std::pair<std::string, RegisterData>> RegisterList;
+
+enum UndoType
+{
+  kUndoInsert,
+  kUndoUpdate,
+  kUndoDelete,
+  kUndoIndexAdd,
+  kUndoIndexRemove
+};
+
+// What a transaction spanning statements changed in a table. Registers and
+// tombstones only reach storage at COMMIT, through a journal synced once,
+// while index entries are changed in place. Every change made in memory or
+// to an index is undone, newest first, on ROLLBACK
+struct TableChanges
+{
+  struct Undo
+  {
+    UndoType type;
+    std::string filename;
+    // The register before it was changed or deleted
+    RegisterData data{};
+    const Index* index = nullptr;
+    std::string key{};
+    std::string payload{};
+  };
+
+  // Latest data of every register written, and which of them are new
+  std::unordered_map<std::string, RegisterData> written;
+  std::unordered_set<std::string> inserted;
+  // Stored registers deleted
+  std::vector<std::string> deleted;
+  std::vector<Undo> undo;
+};
 
 struct Table
 {
   Table(std::string name);
-  Table(std::string name, std::vector<hsql::ColumnDefinition*>* cols);
+  Table(std::string name, std::vector<hsql::ColumnDefinition*>* cols,
+        std::vector<Constraint> constraints = {},
+        TableStorage storage = kStorageRow);
   ~Table();
 
   std::string name;
@@ -27,22 +73,108 @@ struct Table
   std::string regs_path;
   std::string metadata_path;
   std::string indexes_path;
-  std::unique_ptr<std::list<std::pair<std::string, RegisterData>>> registers;
-  std::vector<hsql::ColumnDefinition*>* columns;
-  std::vector<Index*>* indexes;
+  // Deleted registers waiting for vacuum, and the batch vacuum is reclaiming
+  std::string tombstones_path;
+  std::string vacuum_path;
+  std::unique_ptr<RegisterList> registers;
+  // Registers of columnar tables. Row tables keep a file per register
+  std::unique_ptr<ColumnStore> column_store;
+  std::vector<hsql::ColumnDefinition*>* columns = nullptr;
+  // Names of the columns read from disk, which their definitions point to
+  std::deque<std::string> column_names;
+  std::vector<Index*>* indexes = nullptr;
+  std::vector<Constraint> constraints;
+  // Columns with Bloom filters, and the false positive rate they aim for
+  std::vector<std::string> bloom_columns;
+  double bloom_fpr = 0.01;
   int reg_size;
+  // Registers are stored as tab separated text padded to a fixed slot size,
+  // so they can be rewritten in place
+  int slot_size;
+  // Last register id handed out, as seen by this handle
   int reg_count;
+  // Register files that were deleted but may still be on disk
+  std::unordered_set<std::string> tombstones;
+  // SELECTs walking the registers in memory. Registers deleted meanwhile
+  // are only tombstoned, and lingering until purgeDeleted drops them
+  std::atomic<int> scans = 0;
+  bool lingering = 0;
+  // Changes of the transaction owning the table, while it hasn't committed.
+  // Only that transaction reads the table through them
+  std::unique_ptr<TableChanges> pending;
+
+  // Rough size of the registers loaded in memory
+  size_t memoryUsage() const;
+  // Registers in memory, or nullptr if they aren't loaded yet. Statements
+  // only reading the table may load them at the same time, so they go
+  // through these rather than registers
+  RegisterList* loadedRegisters() const;
+  RegisterList* allRegisters();
+  void purgeDeleted();
+  std::string formatRegister(RegisterData const& reg_data) const;
+  // Splits a stored slot into views of its values, without copying them
+  void parseRegister(std::string_view slot,
+                     std::vector<std::string_view>& fields) const;
+  // Registers are reached through these whatever the storage of the table
+  bool readRegister(std::string const& filename, std::string& slot,
+                    std::vector<std::string_view>& fields) const;
+  bool writeRegister(std::string const& filename,
+                     RegisterData const& reg_data) const;
+  // With sync the registers are on disk when it returns, files created for
+  // them included
+  bool writeRegisters(
+      std::vector<std::pair<const std::string*, const RegisterData*>> const&
+          regs,
+      bool sync = 0) const;
+  // Returns how many registers were actually removed
+  size_t removeRegisters(std::vector<std::string> const& filenames) const;
+  std::vector<std::string> registerFilenames() const;
+  bool isDeleted(std::string const& filename) const;
+  // Index that enforces a constraint
+  const Index* constraintIndex(Constraint const& constraint) const;
+  // Tombstones registers with one sequential append. Their files and index
+  // entries are reclaimed later by Vacuum
+  bool markDeleted(std::vector<std::string> const& filenames);
+  // Only appends the tombstones, without a sync when the caller syncs them
+  bool writeTombstones(std::vector<std::string> const& filenames,
+                       bool sync = 1) const;
+  // Writes metadata.dat, and the table's record in the catalog
+  void writeMetadata() const;
+  // Only the catalog record, for changes metadata.dat doesn't hold
+  void writeCatalog(TableStats const& stats = {}) const;
+  // The record and register counts of a table the catalog is missing, read
+  // from its files without opening it. Returns 0 if they can't be read
+  static bool catalogEntry(std::string const& name, std::string& record,
+                           TableStats& stats);
 
 private:
+  Table() = default;
   bool load_metadata();
+  std::string catalogRecord() const;
+  TableStats countRegisters() const;
+  // Returns 0, leaving the table as it was, when the record doesn't match
+  // metadata.dat
+  bool loadCatalogRecord(std::string_view record);
+  // Turns the text dates of a table from before day numbers into them
+  void migrateDates();
+  bool writeSlot(std::string const& filename, std::string const& slot) const;
 
+  mutable std::mutex registers_mutex;
   std::ifstream metadata_file;
   void loadPaths(std::string const& name);
   void checkTableExists();
+  void loadConstraints();
+  void checkConstraints() const;
   void loadIndexes();
+  // Positions of a comma separated list of column names
+  void resolveColumns(std::string const& names,
+                      std::vector<std::string>& columns,
+                      std::vector<int>& column_pos) const;
+  void loadTombstones();
   void loadStoredRegisters();
   void createTableFolders();
   int calculateRegSize();
+  int calculateSlotSize();
   void openMetadataFile();
   void loadMetadataHeader();
   void loadTableName();
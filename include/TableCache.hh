@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Table.hh"
+#include <condition_variable>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+// A table handle stays open for as long as a statement holds it, even if the
+// cache lets go of it meanwhile
+typedef std::shared_ptr<std::unique_ptr<Table>> TableHandle;
+
+// Open Table handles, shared by every session so tables are only loaded
+// once. At most max_tables handles are kept open and the registers they hold
+// in memory are kept under max_bytes: the least recently used handles are
+// closed first. Tables write through to disk, so closing one never loses
+// anything.
+class TableCache
+{
+public:
+  static TableCache& instance();
+
+  // 0 leaves a limit off
+  void configure(size_t max_tables, size_t max_bytes);
+
+  // Handle of a table, opening it if it isn't cached
+  TableHandle get(std::string const& name);
+  // Caches a table that was just created
+  TableHandle put(std::unique_ptr<Table> table);
+  // Closes the handle of a table, if it is open
+  void erase(std::string const& name);
+  void clear();
+
+  size_t tables() const;
+  size_t used() const;
+  size_t max_tables() const { return table_limit; }
+  size_t max_bytes() const { return byte_limit; }
+  unsigned long hits = 0;
+  unsigned long misses = 0;
+  unsigned long evictions = 0;
+
+private:
+  TableCache() = default;
+
+  // Closes least recently used handles until the limits hold again. The
+  // most recently used one is always kept, and so are the ones statements
+  // are still using
+  void evict();
+  bool overLimits() const;
+  // Memory held by handles no statement is using. The others may be
+  // changing under a writer
+  size_t idleBytes() const;
+
+  size_t table_limit = 0;
+  size_t byte_limit = 0;
+  mutable std::mutex mutex;
+  // Most recently used handles live at the front
+  std::list<TableHandle> lru;
+  std::unordered_map<std::string, std::list<TableHandle>::iterator> handles;
+  // Tables a session is opening. Opening one may replay its journal or
+  // migrate its files, so other sessions wait for that handle instead
+  std::set<std::string> opening;
+  std::condition_variable opened;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "DBException.hh"
+#include "Transactions.hh"
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum LockMode
+{
+  kLockShared,
+  kLockExclusive
+};
+
+// Reader/writer lock on tables, held for the length of a statement. Any
+// number of statements may read a table at once, while one writing it has it
+// to itself. There is a single lock per table in the process, shared by
+// every Table handle and by vacuum.
+//
+// Writers waiting on a table go before readers arriving after them, so a
+// stream of scans yielding between batches can't starve them.
+//
+// Statements using several tables lock them all at once, in name order, so
+// two of them never end up waiting on each other.
+class TableLock
+{
+  struct Latch
+  {
+    std::mutex mutex;
+    std::condition_variable released;
+    int readers = 0;
+    int writers_waiting = 0;
+    bool writer = 0;
+
+    void lock(LockMode mode);
+    void unlock(LockMode mode);
+  };
+
+  std::vector<std::pair<Latch*, LockMode>> held;
+
+  static std::mutex registry_mutex;
+  static Latch& of(std::string const& table_name);
+
+public:
+  TableLock(std::string const& table_name, LockMode mode);
+  // A table asked for in both modes is locked exclusively
+  explicit TableLock(
+      std::vector<std::pair<std::string, LockMode>> const& tables);
+  ~TableLock();
+
+  TableLock(TableLock const&) = delete;
+  TableLock& operator=(TableLock const&) = delete;
+
+  // Releases the tables early, in the reverse order they were locked
+  void unlock();
+  // Lets statements waiting on the tables run, then takes them back
+  void yield();
+};
+
+// Writers own the tables they change until their transaction ends, so none
+// changes rows another transaction hasn't committed. It is taken before the
+// table lock, and readers don't need it.
+//
+// Transactions spanning statements only wait for older ones: a younger one
+// asking for a table an older one owns gives up instead, so waits never go
+// round in a circle. Single statements own nothing else while they wait, so
+// they always wait and are always waited for.
+//
+// Waiting for a transaction spanning statements is bounded by the lock
+// timeout. Nothing else ends it but its own client, and a server thread
+// waiting forever could be the one that client's COMMIT needs.
+class TableOwner
+{
+  struct Owner
+  {
+    TxnId txn;
+    bool single_statement;
+  };
+
+  static std::mutex mutex;
+  static std::condition_variable released;
+  static std::map<std::string, Owner> owners;
+
+  std::string table_name;
+
+public:
+  // Throws TRANSACTION_CONFLICT when the transaction has to give up, and
+  // LOCK_TIMEOUT when the owner takes too long
+  TableOwner(std::string const& table_name, TxnId txn, bool single_statement);
+  ~TableOwner();
+
+  TableOwner(TableOwner const&) = delete;
+  TableOwner& operator=(TableOwner const&) = delete;
+};
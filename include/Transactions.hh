@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+typedef uint64_t TxnId;
+
+// The transactions a statement sees: those committed before it started,
+// and the one it runs in. Transactions from xmax on, and those in active,
+// were still running
+struct Snapshot
+{
+  TxnId xmin;
+  TxnId xmax;
+  std::vector<TxnId> active;
+  TxnId own = 0;
+
+  bool sees(TxnId txn) const;
+};
+
+// Hands out transaction ids and snapshots. Ids only order changes made while
+// the process runs: anything on disk when it starts is seen by every
+// snapshot.
+class Transactions
+{
+public:
+  static Transactions& instance();
+
+  TxnId begin();
+  void commit(TxnId txn);
+  // The versions a snapshot needs are kept for as long as it is held. A
+  // statement inside a transaction sees what the transaction changed
+  std::shared_ptr<const Snapshot> snapshot(TxnId own = 0);
+  // Transactions before the horizon are seen by every snapshot, now and
+  // later, so their older versions can go
+  TxnId horizon() const;
+  // Whether any snapshot is held. Without one nobody needs older versions
+  bool reading() const;
+
+private:
+  Transactions() = default;
+
+  mutable std::mutex mutex;
+  TxnId next = 1;
+  std::set<TxnId> active;
+  std::multiset<TxnId> snapshot_xmins;
+};
+
+struct Table;
+class TableOwner;
+
+// A unit of changes to tables. A statement outside BEGIN runs in one of its
+// own, writing straight to storage and committed as it finishes. BEGIN opens
+// one lasting until COMMIT or ROLLBACK, whose writes wait in memory (see
+// TableChanges) until COMMIT makes them durable at once.
+//
+// Tables belong to the transaction from its first change to them until it
+// ends.
+class Transaction
+{
+public:
+  TxnId id;
+  // Whether older versions of the registers it changes must be kept: only
+  // if some snapshot is held once its statement has the table locked, but
+  // always for transactions spanning statements, since snapshots come and go
+  // while they run
+  bool versioned;
+  bool buffered;
+  // Tables changed so far, by name
+  std::map<std::string, Table*> tables;
+
+  explicit Transaction(bool buffered = 0);
+  ~Transaction();
+
+  Transaction(Transaction const&) = delete;
+  Transaction& operator=(Transaction const&) = delete;
+
+  // Takes the table for the transaction, waiting for whoever changes it.
+  // Throws TRANSACTION_CONFLICT when waiting could deadlock, and
+  // LOCK_TIMEOUT when another transaction keeps the table too long
+  void own(Table* table, std::string const& table_name);
+  // Ends the transaction and gives its tables back. Its changes must have
+  // been applied or undone already
+  void end();
+
+private:
+  std::vector<std::unique_ptr<TableOwner>> owners;
+  bool ended = 0;
+};
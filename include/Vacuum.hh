@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+// Reclaims deleted registers in the background. DELETE only appends
+// tombstones; vacuum later removes the register files and their index
+// entries, along with index folders left empty.
+//
+// Tombstones of a table are moved aside before being reclaimed, so new
+// DELETEs keep appending to a fresh file. Work is done in batches of
+// batch_rows registers with a pause of delay_ms between them. Each batch
+// locks the table alone, so statements on it only wait for one batch.
+// Row versions no snapshot needs anymore are dropped on every pass too.
+class Vacuum
+{
+  std::thread worker;
+  std::mutex queue_mutex;
+  std::condition_variable queue_cv;
+  std::set<std::string> pending;
+  bool running = 0;
+  std::atomic<bool> stopping = 0;
+  size_t batch_rows = 0;
+  int delay_ms = 0;
+
+  Vacuum() {}
+  void work();
+
+public:
+  ~Vacuum();
+
+  static Vacuum& instance();
+  // Starts the worker and schedules tables with leftover tombstones
+  void start(size_t batch_rows, int delay_ms);
+  void stop();
+  void schedule(std::string const& table_name);
+
+  // Reclaims the tombstoned registers of a table. Returns how many
+  static size_t vacuum_table(std::string const& table_name, size_t batch_rows,
+                             int delay_ms);
+};
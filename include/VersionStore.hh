@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Transactions.hh"
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum Visibility
+{
+  kVisibleStored,    // The stored register is the one the snapshot sees
+  kVisibleOlder,     // It sees an older version of it
+  kVisibleNone       // The register didn't exist for it
+};
+
+// Older versions of the registers of a table, for snapshots that don't see
+// the transactions that changed them. Registers are always changed in place
+// and the version they had before is kept here, in memory, tagged with the
+// transaction that changed it. Since no snapshot outlives the process,
+// nothing needs to reach the disk.
+//
+// Versions every snapshot can see past are garbage collected by vacuum and
+// by the next writer of the table.
+class VersionStore
+{
+public:
+  static std::shared_ptr<VersionStore> get(std::string const& table_name);
+  // Drops the versions of a table that was dropped
+  static void forget(std::string const& table_name);
+
+  // Keeps a register as it was before txn changed it. before is nullptr for
+  // registers txn creates
+  void record(TxnId txn, std::string const& filename,
+              const std::vector<std::string>* before);
+  // Versions ever recorded, so readers can tell whether any was added since
+  uint64_t position() const { return recorded; }
+  // Whether the snapshot misses any change kept here
+  bool unseen(Snapshot const& snapshot) const;
+  // Registers changed by transactions the snapshot doesn't see
+  std::vector<std::string> changed(Snapshot const& snapshot) const;
+  // What the snapshot sees of a register. Older versions are copied to
+  // image
+  Visibility visible(Snapshot const& snapshot, std::string const& filename,
+                     std::vector<std::string>& image) const;
+  // Drops versions of transactions before the horizon
+  void collect(TxnId horizon);
+  // Drops the versions of a transaction that was rolled back, once its
+  // registers are as they were again
+  void discard(TxnId txn);
+  size_t size() const;
+
+private:
+  struct Version
+  {
+    TxnId txn;
+    bool existed;
+    std::vector<std::string> before;
+  };
+
+  static std::mutex registry_mutex;
+  static std::map<std::string, std::shared_ptr<VersionStore>>& registry();
+
+  mutable std::mutex mutex;
+  // Versions of each register, oldest first
+  std::unordered_map<std::string, std::deque<Version>> chains;
+  // Every version kept, in the order they were recorded. A transaction owns
+  // the table from its first change until it ends, so the versions of each
+  // one come together, after those of transactions that ended before
+  std::deque<std::pair<TxnId, std::string>> log;
+  std::atomic<uint64_t> recorded = 0;
+};
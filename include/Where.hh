@@ -4,6 +4,9 @@
 #include "Table.hh"
 #include "flaviadb_definitions.hh"
 #include <hsql/SQLParser.h>
+#include <memory>
+#include <string_view>
+#include <vector>
 
 class Where
 {
@@ -15,7 +18,8 @@ protected:
 public:
   virtual ~Where() {}
   static Where* get(hsql::Expr* const& where_clause, hsql::DataType data_type);
-  virtual bool compare(std::string data) = 0;
+  // Values are compared through views into the stored register
+  virtual bool compare(std::string_view data) = 0;
 };
 
 class WhereInt : public Where
@@ -24,7 +28,7 @@ class WhereInt : public Where
 
 public:
   WhereInt(hsql::Expr* const& where_clause);
-  bool compare(std::string data);
+  bool compare(std::string_view data);
 };
 
 class WhereChar : public Where
@@ -33,26 +37,73 @@ class WhereChar : public Where
 
 public:
   WhereChar(hsql::Expr* const& where_clause);
-  bool compare(std::string data);
+  bool compare(std::string_view data);
 };
 
+// DATE values are stored as day numbers, so the literal is turned into one
+// once and registers are compared as integers
 class WhereDate : public Where
 {
-  std::string date;
-  short int compareToDate(std::string date);
+  int32_t days = 0;
 
 public:
   WhereDate(hsql::Expr* const& where_clause);
-  bool compare(std::string data);
+  bool compare(std::string_view data);
 };
 
 class NullWhere : public Where
 {
   public:
   NullWhere();
-  bool compare(std::string data);
+  bool compare(std::string_view data);
 };
 
+// Days since 01-01-1970 of a date in DATE_FORMAT, and back. DATE values are
+// only written as dates when they are read in or output
+bool dateToDays(std::string_view value, int32_t& days);
+std::string daysToDate(int32_t days);
+// A stored day number as a date, or the value itself if it isn't one
+std::string formatDate(std::string_view days);
+
 bool valid_where(const hsql::Expr* where, int* where_column_pos,
                  hsql::DataType* column_data_type,
                  std::unique_ptr<Table> const& table);
+
+// One column comparison of a WHERE clause
+struct Predicate
+{
+  int column_pos;
+  const hsql::Expr* expr;
+  std::unique_ptr<Where> where;
+};
+
+// A WHERE clause made of comparisons joined by AND. A register matches when
+// all of them hold.
+class WhereClause
+{
+public:
+  std::vector<Predicate> predicates;
+
+  // Returns 0 when the clause is not valid, same as valid_where
+  bool parse(hsql::Expr* where, std::unique_ptr<Table> const& table);
+
+  template <typename Row>
+  bool matches(Row const& row) const
+  {
+    for (const auto& predicate : predicates)
+      if (!predicate.where->compare(row[predicate.column_pos]))
+        return 0;
+    return 1;
+  }
+
+  // First predicate on a column whose operator satisfies accept
+  template <typename Accept>
+  const Predicate* find(int column_pos, Accept accept) const
+  {
+    for (const auto& predicate : predicates)
+      if (predicate.column_pos == column_pos &&
+          accept(predicate.expr->opType))
+        return &predicate;
+    return nullptr;
+  }
+};
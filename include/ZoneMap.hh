@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <hsql/SQLParser.h>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class WhereClause;
+
+// Min/max synopsis of the INT and DATE columns of a table for every row
+// group, a run of group_rows consecutive register ids. It is kept in
+// zonemap.dat inside the table folder, after a header, as one fixed size
+// record per group. DATE values are stored as day numbers.
+//
+// Groups are only ever widened: registers updated or deleted may leave a
+// group wider than it needs to be, which only costs skipping less. Tables
+// created before zone maps existed have no file and are never pruned.
+class ZoneMap
+{
+public:
+  ZoneMap(std::string const& table_path,
+          std::vector<hsql::ColumnDefinition*> const* columns);
+
+  // Starts the zone map of a new table
+  static void create(std::string const& table_path, uint32_t group_rows);
+  static int registerId(std::string const& filename);
+
+  bool exists() const { return header.magic == MAGIC; }
+  uint32_t group_rows() const { return header.group_rows; }
+  int group(int reg_id) const { return (reg_id - 1) / header.group_rows; }
+
+  // Widens the group of a register to cover its values. Nothing is written
+  // until save, which merges the changes with the records on disk
+  template <typename Row>
+  void add(int reg_id, Row const& row)
+  {
+    if (!exists())
+      return;
+    Record& record = pending[group(reg_id)];
+    for (size_t i = 0; i < zone_columns.size(); i++)
+      widen(record, i, row[zone_columns[i]]);
+    record.rows++;
+  }
+  bool save();
+
+  // For every row group, whether it may hold registers matching a clause.
+  // Empty when no group can be ruled out
+  std::vector<bool> candidates(WhereClause const& clause) const;
+
+private:
+  static constexpr uint64_t MAGIC = 0x70616d656e6f7a66;    // "fzonemap"
+
+  struct Header
+  {
+    uint64_t magic;
+    uint32_t group_rows;
+    uint32_t reserved;
+  };
+
+  struct Range
+  {
+    int32_t min;
+    int32_t max;
+  };
+
+  // Registers added to the group, and the range of every zone column
+  struct Record
+  {
+    uint32_t rows = 0;
+    std::vector<Range> ranges;
+  };
+
+  std::string path;
+  Header header{};
+  // Positions and types of the INT and DATE columns
+  std::vector<int> zone_columns;
+  std::vector<hsql::DataType> zone_types;
+  std::map<int, Record> pending;
+
+  size_t recordSize() const;
+  void widen(Record& record, size_t column, std::string_view value) const;
+  static bool toValue(std::string_view value, int32_t& number);
+  std::vector<Record> load() const;
+};
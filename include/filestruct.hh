@@ -24,7 +24,29 @@ std::string getMetadataPath(std::string const& tableName);
 
 std::string getRegCountPath(std::string const& table_name);
 
-std::string getNewRegPath(std::string const& table_name);
-
 int getRegCount(std::string const& table_name);
+
+// Replaces reg_count.dat through a synced temporary file, so the count is
+// on disk, and never half written, when this returns
+bool setRegCount(std::string const& table_name, int count);
+
+// Writes a register slot in place, creating the file only if it is missing.
+// With sync it is on disk when this returns
+bool writeSlot(std::string const& path, std::string const& slot,
+               bool sync = 0);
+
+// Reads a whole register file into buffer, reusing its allocation
+bool readSlot(std::string const& path, std::string& buffer);
+
+// Replaces the contents of a file, creating it if it is missing
+bool writeFile(std::string const& path, std::string const& data,
+               bool sync = 0);
+
+// Appends data to a file with a single write, and syncs it unless a journal
+// already made it durable
+bool appendFile(std::string const& path, std::string const& data,
+                bool sync = 1);
+
+// Makes the files created, renamed or removed in a folder survive a crash
+bool syncDir(std::string const& path);
 }
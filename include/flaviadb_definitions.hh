@@ -2,4 +2,21 @@
 
 #define FLAVIADB_DIR "/home/mgonnav/.flaviadb/"
 #define FLAVIADB_TEST_DB "/home/mgonnav/.flaviadb/test/"
+#define FLAVIADB_CATALOG "/home/mgonnav/.flaviadb/catalog.dat"
+#define FLAVIADB_SOCKET "/home/mgonnav/.flaviadb/flaviadb.sock"
 #define DATE_FORMAT "%d-%m-%Y"
+#define REG_ID_RESERVATION 1024
+#define SCAN_BATCH_ROWS 1024
+#define RESULT_CACHE_ENV "FLAVIADB_RESULT_CACHE"
+#define TABLE_CACHE_ENV "FLAVIADB_TABLE_CACHE"
+#define TABLE_CACHE_BYTES_ENV "FLAVIADB_TABLE_CACHE_BYTES"
+#define TABLE_CACHE_STATS_ENV "FLAVIADB_TABLE_CACHE_STATS"
+#define OUTPUT_MODE_ENV "FLAVIADB_OUTPUT"
+#define WIDTH_SAMPLE_ENV "FLAVIADB_WIDTH_SAMPLE"
+#define OUTPUT_FORMAT_ENV "FLAVIADB_FORMAT"
+#define OUTPUT_FILE_ENV "FLAVIADB_OUTPUT_FILE"
+#define VACUUM_BATCH_ENV "FLAVIADB_VACUUM_BATCH"
+#define VACUUM_DELAY_ENV "FLAVIADB_VACUUM_DELAY_MS"
+#define ZONE_GROUP_ENV "FLAVIADB_ZONE_GROUP_ROWS"
+#define SERVER_WORKERS_ENV "FLAVIADB_SERVER_WORKERS"
+#define LOCK_TIMEOUT_ENV "FLAVIADB_LOCK_TIMEOUT_MS"
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace parallelUtils
+{
+// Number of threads worth using for count items, so that none of them gets
+// fewer than min_per_thread
+inline size_t thread_count(size_t count, size_t min_per_thread)
+{
+  size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+  return std::max<size_t>(1, std::min(hardware, count / min_per_thread));
+}
+
+// Sorts [first, last) by sorting one chunk per thread and then merging
+// neighbouring chunks, also in parallel, until a single run is left
+template <typename It, typename Compare = std::less<>>
+void sort(It first, It last, Compare comp = Compare(),
+          size_t min_per_thread = 1 << 16)
+{
+  size_t count = last - first;
+  size_t chunks = thread_count(count, min_per_thread);
+  if (chunks == 1)
+  {
+    std::sort(first, last, comp);
+    return;
+  }
+
+  std::vector<It> bounds;
+  for (size_t i = 0; i < chunks; i++)
+    bounds.push_back(first + count * i / chunks);
+  bounds.push_back(last);
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < chunks; i++)
+    workers.emplace_back(
+        [&, i] { std::sort(bounds[i], bounds[i + 1], comp); });
+  for (auto& worker : workers)
+    worker.join();
+
+  while (bounds.size() > 2)
+  {
+    std::vector<It> merged_bounds;
+    workers.clear();
+    for (size_t i = 0; i + 1 < bounds.size(); i += 2)
+    {
+      merged_bounds.push_back(bounds[i]);
+      if (i + 2 < bounds.size())
+        workers.emplace_back([&, i] {
+          std::inplace_merge(bounds[i], bounds[i + 1], bounds[i + 2], comp);
+        });
+    }
+    merged_bounds.push_back(last);
+    for (auto& worker : workers)
+      worker.join();
+    bounds = std::move(merged_bounds);
+  }
+}
+}
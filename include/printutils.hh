@@ -1,8 +1,13 @@
+#pragma once
+
+#include "ResultCache.hh"
 #include "Table.hh"
+#include "TableCache.hh"
 #include <cstring>
 #include <hsql/SQLParser.h>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <vector>
 
 namespace printUtils
@@ -12,15 +17,23 @@ void print_welcome_message();
 void print_row(const std::vector<std::string>* row,
                const std::vector<size_t>* fields_width, std::string separator);
 
-void print_select_result(std::vector<hsql::ColumnDefinition*>* columns,
-                         std::vector<std::vector<std::string>>* regs_data,
-                         std::vector<size_t>* fields_width);
+void print_select_result(
+    std::vector<hsql::ColumnDefinition*>* columns,
+    const std::vector<std::vector<std::string>>* regs_data,
+    const std::vector<size_t>* fields_width);
+
+void print_select_result(
+    std::vector<hsql::Expr*>* fields,
+    const std::vector<std::vector<std::string>>* regs_data,
+    const std::vector<size_t>* fields_width);
 
-void print_select_result(std::vector<hsql::Expr*>* fields,
-                         std::vector<std::vector<std::string>>* regs_data,
-                         std::vector<size_t>* fields_width);
+// Widest value a column can hold according to its definition
+size_t column_width(const hsql::ColumnDefinition* column);
 
-void print_tables_list(std::vector<std::string>& tables);
+void print_tables_list(std::vector<std::string> const& tables);
 
 void print_table_desc(std::unique_ptr<Table> const& table);
+
+void print_cache_stats(ResultCache const& cache);
+void print_table_cache_stats(TableCache const& cache);
 }    // namespace printUtils
@@ -0,0 +1,169 @@
+#include "BloomFilter.hh"
+#include "Where.hh"
+#include "filestruct.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ft = ftools;
+
+// FNV-1a, split in two halves for double hashing. It has to stay the same
+// across builds, since the filters are stored
+static void hashValue(std::string const& value, uint32_t& h1, uint32_t& h2)
+{
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : value)
+  {
+    hash ^= c;
+    hash *= 0x100000001b3;
+  }
+  h1 = hash;
+  h2 = (hash >> 32) | 1;
+}
+
+BloomFilter::BloomFilter(std::string const& table_path,
+                         std::vector<hsql::ColumnDefinition*> const* columns,
+                         std::vector<std::string> const& filter_columns)
+    : path(table_path + "bloom.dat")
+{
+  for (const auto& column : filter_columns)
+    for (size_t i = 0; i < columns->size(); i++)
+      if (column == columns->at(i)->name)
+      {
+        filter_pos.push_back(i);
+        filter_types.push_back(columns->at(i)->type.data_type);
+      }
+
+  int fd = open(this->path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  if (pread(fd, &this->header, sizeof(Header), 0) != sizeof(Header) ||
+      this->header.columns != filter_pos.size() ||
+      this->header.bits % 64 != 0 || this->header.group_rows == 0)
+    this->header = Header{};
+  close(fd);
+}
+
+void BloomFilter::create(std::string const& table_path, uint32_t group_rows,
+                         double false_positive_rate, size_t column_count)
+{
+  // Optimal size and number of hashes for group_rows values per filter
+  double bits = -(double)group_rows * std::log(false_positive_rate) /
+                (std::log(2) * std::log(2));
+  Header header{MAGIC, group_rows,
+                (uint32_t)std::max(64.0, std::ceil(bits / 64) * 64), 0,
+                (uint32_t)column_count};
+  header.hashes = std::max<uint32_t>(
+      1, std::lround((double)header.bits / group_rows * std::log(2)));
+  ft::writeFile(table_path + "bloom.dat",
+                std::string((const char*)&header, sizeof(Header)));
+}
+
+std::string BloomFilter::canonical(size_t column, std::string_view value) const
+{
+  int32_t days;
+  if (filter_types[column] == hsql::DataType::DATE && dateToDays(value, days))
+    return std::to_string(days);
+  return std::string(value);
+}
+
+void BloomFilter::set(std::vector<uint64_t>& words, size_t column,
+                      std::string const& value) const
+{
+  uint32_t h1, h2;
+  hashValue(value, h1, h2);
+  uint64_t* filter = words.data() + column * wordsPerFilter();
+  for (uint32_t i = 0; i < header.hashes; i++)
+  {
+    uint32_t bit = (h1 + i * h2) % header.bits;
+    filter[bit / 64] |= (uint64_t)1 << (bit % 64);
+  }
+}
+
+bool BloomFilter::test(uint64_t const* filter, std::string const& value) const
+{
+  uint32_t h1, h2;
+  hashValue(value, h1, h2);
+  for (uint32_t i = 0; i < header.hashes; i++)
+  {
+    uint32_t bit = (h1 + i * h2) % header.bits;
+    if (!(filter[bit / 64] & ((uint64_t)1 << (bit % 64))))
+      return 0;
+  }
+  return 1;
+}
+
+bool BloomFilter::save()
+{
+  if (!exists() || this->pending.empty())
+    return 1;
+
+  int fd = open(this->path.c_str(), O_RDWR);
+  if (fd < 0)
+    return 0;
+
+  size_t record_words = filter_pos.size() * wordsPerFilter();
+  size_t record_size = record_words * sizeof(uint64_t);
+  std::vector<uint64_t> stored(record_words);
+  bool written = 1;
+  for (auto& [group, words] : this->pending)
+  {
+    off_t offset = sizeof(Header) + (off_t)group * record_size;
+    if (pread(fd, stored.data(), record_size, offset) != (ssize_t)record_size)
+      std::fill(stored.begin(), stored.end(), 0);
+    for (size_t i = 0; i < record_words; i++)
+      stored[i] |= words[i];
+    written &= pwrite(fd, stored.data(), record_size, offset) ==
+               (ssize_t)record_size;
+  }
+
+  close(fd);
+  this->pending.clear();
+  return written;
+}
+
+std::vector<bool> BloomFilter::candidates(WhereClause const& clause) const
+{
+  std::vector<bool> groups;
+  std::string data;
+  if (!exists() || !ft::readSlot(this->path, data))
+    return groups;
+
+  size_t record_words = filter_pos.size() * wordsPerFilter();
+  size_t record_size = record_words * sizeof(uint64_t);
+  size_t group_count = (data.size() - sizeof(Header)) / record_size;
+  std::vector<uint64_t> records(group_count * record_words);
+  memcpy(records.data(), data.data() + sizeof(Header),
+         records.size() * sizeof(uint64_t));
+
+  groups.assign(group_count, 1);
+  bool pruned = 0;
+  for (const auto& predicate : clause.predicates)
+  {
+    auto column = std::find(filter_pos.begin(), filter_pos.end(),
+                            predicate.column_pos);
+    if (predicate.expr->opType != hsql::kOpEquals ||
+        column == filter_pos.end())
+      continue;
+    size_t i = column - filter_pos.begin();
+
+    const hsql::Expr* literal = predicate.expr->expr2;
+    std::string value = (literal->type == hsql::kExprLiteralInt)
+                            ? std::to_string(literal->ival)
+                            : canonical(i, literal->name);
+    for (size_t g = 0; g < group_count; g++)
+      if (groups[g] &&
+          !test(records.data() + g * record_words + i * wordsPerFilter(),
+                value))
+      {
+        groups[g] = 0;
+        pruned = 1;
+      }
+  }
+
+  if (!pruned)
+    groups.clear();
+  return groups;
+}
@@ -0,0 +1,241 @@
+#include "Catalog.hh"
+#include "Table.hh"
+#include "filestruct.hh"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+namespace ft = ftools;
+
+// FNV-1a over the schemas
+static uint64_t checksum(std::string_view data)
+{
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : data)
+  {
+    hash ^= c;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+Catalog::Catalog(std::string const& path) : path(path) { map(); }
+
+Catalog::~Catalog() { unmap(); }
+
+Catalog& Catalog::instance()
+{
+  static Catalog catalog(FLAVIADB_CATALOG);
+  return catalog;
+}
+
+void Catalog::map()
+{
+  this->was_valid = 0;
+  int fd = ::open(this->path.c_str(), O_RDWR);
+  if (fd < 0)
+    return;
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(Header))
+  {
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    if (mapping != MAP_FAILED)
+    {
+      this->data = (char*)mapping;
+      this->size = info.st_size;
+      this->inode = info.st_ino;
+    }
+  }
+  close(fd);
+  if (this->data == nullptr)
+    return;
+
+  Header header;
+  memcpy(&header, this->data, sizeof(Header));
+  size_t offset = sizeof(Header) + header.tables * sizeof(TableStats);
+  if (header.magic != MAGIC || header.version != VERSION ||
+      offset > this->size ||
+      checksum(std::string_view(this->data + offset, this->size - offset)) !=
+          header.checksum)
+  {
+    unmap();
+    return;
+  }
+
+  // Every schema is its table name and record, each preceded by its size
+  for (uint32_t slot = 0; slot < header.tables; slot++)
+  {
+    uint32_t sizes[2];
+    if (offset + sizeof(sizes) > this->size)
+      break;
+    memcpy(sizes, this->data + offset, sizeof(sizes));
+    offset += sizeof(sizes);
+    if (offset + sizes[0] + sizes[1] > this->size)
+      break;
+    this->entries.emplace(std::string(this->data + offset, sizes[0]),
+                          Entry{slot, offset + sizes[0], sizes[1]});
+    offset += sizes[0] + sizes[1];
+  }
+
+  if (this->entries.size() != header.tables)
+  {
+    unmap();
+    return;
+  }
+  this->was_valid = 1;
+}
+
+void Catalog::unmap()
+{
+  if (this->data != nullptr)
+    munmap(this->data, this->size);
+  this->data = nullptr;
+  this->size = 0;
+  this->inode = 0;
+  this->entries.clear();
+}
+
+void Catalog::refresh()
+{
+  struct stat info;
+  if (stat(this->path.c_str(), &info) == 0 && info.st_ino != this->inode)
+  {
+    unmap();
+    map();
+  }
+}
+
+TableStats* Catalog::slots() const
+{
+  return (TableStats*)(this->data + sizeof(Header));
+}
+
+std::string_view Catalog::record(Entry const& entry) const
+{
+  return std::string_view(this->data + entry.offset, entry.size);
+}
+
+void Catalog::open()
+{
+  if (this->was_valid || !ft::dirExists(FLAVIADB_TEST_DB))
+    return;
+
+  // Every table is read once and the file written once for all of them
+  std::map<std::string, std::string> records;
+  std::map<std::string, Change> changes;
+  for (const auto& entry : fs::directory_iterator(FLAVIADB_TEST_DB))
+  {
+    std::string name = entry.path().filename();
+    TableStats stats;
+    if (entry.is_directory() &&
+        Table::catalogEntry(name, records[name], stats))
+      changes[name] = Change{&records[name], stats};
+  }
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  refresh();
+  if (!changes.empty())
+    rewrite(changes);
+}
+
+bool Catalog::find(std::string const& table, std::string& record) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto entry = this->entries.find(table);
+  if (entry == this->entries.end())
+    return 0;
+  record = this->record(entry->second);
+  return 1;
+}
+
+void Catalog::put(std::string const& table, std::string const& record,
+                  TableStats const& stats)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  refresh();
+  rewrite({{table, Change{&record, stats}}});
+}
+
+void Catalog::remove(std::string const& table)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  refresh();
+  if (this->entries.count(table))
+    rewrite({{table, Change{nullptr, {}}}});
+}
+
+void Catalog::rewrite(std::map<std::string, Change> const& changes)
+{
+  Header header{MAGIC, VERSION, 0, 0};
+  std::string all_stats, schemas;
+  auto add = [&](std::string_view name, std::string_view record,
+                 TableStats const& stats)
+  {
+    uint32_t sizes[2] = {(uint32_t)name.size(), (uint32_t)record.size()};
+    all_stats.append((const char*)&stats, sizeof(TableStats));
+    schemas.append((const char*)sizes, sizeof(sizes));
+    schemas += name;
+    schemas += record;
+    header.tables++;
+  };
+
+  // Tables already there keep their statistics
+  for (const auto& [name, entry] : this->entries)
+  {
+    auto change = changes.find(name);
+    if (change == changes.end())
+      add(name, this->record(entry), slots()[entry.slot]);
+    else if (change->second.record != nullptr)
+      add(name, *change->second.record, slots()[entry.slot]);
+  }
+  for (const auto& [name, change] : changes)
+    if (change.record != nullptr && !this->entries.count(name))
+      add(name, *change.record, change.stats);
+
+  header.checksum = checksum(schemas);
+  std::string file((const char*)&header, sizeof(Header));
+  file += all_stats;
+  file += schemas;
+  if (!ft::writeFile(this->path + ".tmp", file) ||
+      rename((this->path + ".tmp").c_str(), this->path.c_str()) != 0)
+    return;
+
+  unmap();
+  map();
+}
+
+std::vector<std::string> Catalog::tables() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  std::vector<std::string> names;
+  for (const auto& [name, entry] : this->entries)
+    names.push_back(name);
+  return names;
+}
+
+TableStats Catalog::stats(std::string const& table) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto entry = this->entries.find(table);
+  if (entry == this->entries.end())
+    return {};
+  return slots()[entry->second.slot];
+}
+
+void Catalog::count(std::string const& table, int64_t rows, int64_t deleted)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto entry = this->entries.find(table);
+  if (entry == this->entries.end())
+    return;
+  TableStats& stats = slots()[entry->second.slot];
+  stats.rows = std::max<int64_t>(stats.rows + rows, 0);
+  stats.deleted = std::max<int64_t>(stats.deleted + deleted, 0);
+}
@@ -0,0 +1,73 @@
+#include "Client.hh"
+#include "DBException.hh"
+#include "Protocol.hh"
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+Client::Client(std::string const& socket_path)
+{
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path))
+    throw DBException{CANNOT_CONNECT, "", socket_path};
+  socket_path.copy(address.sun_path, socket_path.size());
+
+  this->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (this->fd < 0 ||
+      connect(this->fd, (sockaddr*)&address, sizeof(address)) < 0)
+  {
+    if (this->fd >= 0)
+      close(this->fd);
+    throw DBException{CANNOT_CONNECT, "", socket_path};
+  }
+}
+
+Client::Client(std::string const& host, uint16_t port)
+{
+  std::string name = host + ":" + std::to_string(port);
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &addresses) != 0)
+    throw DBException{CANNOT_CONNECT, "", name};
+
+  for (addrinfo* address = addresses; address; address = address->ai_next)
+  {
+    this->fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC,
+                      address->ai_protocol);
+    if (this->fd < 0)
+      continue;
+    if (connect(this->fd, address->ai_addr, address->ai_addrlen) == 0)
+      break;
+    close(this->fd);
+    this->fd = -1;
+  }
+  freeaddrinfo(addresses);
+  if (this->fd < 0)
+    throw DBException{CANNOT_CONNECT, "", name};
+
+  // Queries are whole frames, so send them right away
+  int nodelay = 1;
+  setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+}
+
+Client::~Client()
+{
+  if (this->fd >= 0)
+    close(this->fd);
+}
+
+std::string Client::query(std::string const& query)
+{
+  std::string reply;
+  if (!protocol::sendFrame(this->fd, query) ||
+      !protocol::receiveFrame(this->fd, reply))
+    throw DBException{CONNECTION_LOST};
+  return reply;
+}
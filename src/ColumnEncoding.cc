@@ -0,0 +1,481 @@
+#include "ColumnEncoding.hh"
+#include "Where.hh"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <vector>
+
+static std::string_view cellValue(std::string const& cells, size_t width,
+                                  uint32_t row)
+{
+  const char* cell = cells.data() + row * width;
+  return std::string_view(cell, strnlen(cell, width));
+}
+
+static void setCell(std::string& cells, size_t width, uint32_t row,
+                    std::string_view value)
+{
+  memcpy(cells.data() + row * width, value.data(),
+         std::min(value.size(), width));
+}
+
+template <typename T>
+static void put(std::string& out, T value)
+{
+  out.append((const char*)&value, sizeof(T));
+}
+
+// Reads a T at pos and moves past it. Fails past the end of the chunk
+template <typename T>
+static bool get(std::string_view chunk, size_t& pos, T& value)
+{
+  if (pos + sizeof(T) > chunk.size())
+    return 0;
+  memcpy(&value, chunk.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return 1;
+}
+
+static uint8_t bitsFor(uint64_t max)
+{
+  uint8_t bits = 0;
+  while (bits < 64 && (max >> bits) != 0)
+    bits++;
+  return bits;
+}
+
+static size_t packedSize(size_t count, uint8_t bits)
+{
+  // Padded so every value can be read as a whole word
+  return (count * bits + 7) / 8 + sizeof(uint64_t);
+}
+
+// Values must fit in bits, and bits be at most 56
+static void pack(std::vector<uint64_t> const& values, uint8_t bits,
+                 std::string& out)
+{
+  size_t start = out.size();
+  out.append(packedSize(values.size(), bits), '\0');
+  for (size_t i = 0; bits > 0 && i < values.size(); i++)
+  {
+    char* data = out.data() + start + i * bits / 8;
+    uint64_t word;
+    memcpy(&word, data, sizeof(uint64_t));
+    word |= values[i] << (i * bits % 8);
+    memcpy(data, &word, sizeof(uint64_t));
+  }
+}
+
+static uint64_t unpack(const char* packed, size_t i, uint8_t bits)
+{
+  if (bits == 0)
+    return 0;
+  uint64_t word;
+  memcpy(&word, packed + i * bits / 8, sizeof(uint64_t));
+  return (word >> (i * bits % 8)) & ((uint64_t(1) << bits) - 1);
+}
+
+static bool holds(hsql::OperatorType op, int comparison)
+{
+  switch (op)
+  {
+  case hsql::kOpEquals:
+    return comparison == 0;
+  case hsql::kOpNotEquals:
+    return comparison != 0;
+  case hsql::kOpLess:
+    return comparison < 0;
+  case hsql::kOpLessEq:
+    return comparison <= 0;
+  case hsql::kOpGreater:
+    return comparison > 0;
+  case hsql::kOpGreaterEq:
+    return comparison >= 0;
+  default:
+    return 1;
+  }
+}
+
+// The cells of an INT or DATE column, which holds day numbers, as numbers.
+// Empty cells, of registers that aren't there, repeat the previous value.
+// Fails when a value wouldn't read back exactly as stored
+static bool toNumbers(std::string const& cells, size_t width, uint32_t rows,
+                      std::vector<int64_t>& numbers)
+{
+  numbers.assign(rows, 0);
+  bool first = 1;
+  for (uint32_t row = 0; row < rows; row++)
+  {
+    std::string_view value = cellValue(cells, width, row);
+    if (value.empty())
+    {
+      if (!first)
+        numbers[row] = numbers[row - 1];
+      continue;
+    }
+
+    int32_t number;
+    if (std::from_chars(value.data(), value.data() + value.size(), number)
+                .ec != std::errc() ||
+        std::to_string(number) != value)
+      return 0;
+
+    // Leading empty cells take the first value
+    if (first)
+      std::fill(numbers.begin(), numbers.begin() + row, number);
+    numbers[row] = number;
+    first = 0;
+  }
+  return 1;
+}
+
+
+static void encodeDictionary(std::string const& cells, size_t width,
+                             uint32_t rows, std::string& out)
+{
+  // Entries are sorted, so codes keep the order of the values
+  std::map<std::string_view, uint64_t> codes;
+  for (uint32_t row = 0; row < rows; row++)
+    codes.emplace(cellValue(cells, width, row), 0);
+
+  put<uint32_t>(out, codes.size());
+  uint64_t code = 0;
+  for (auto& [value, value_code] : codes)
+  {
+    value_code = code++;
+    put<uint16_t>(out, value.size());
+    out += value;
+  }
+
+  uint8_t bits = bitsFor(codes.size() - 1);
+  std::vector<uint64_t> row_codes;
+  for (uint32_t row = 0; row < rows; row++)
+    row_codes.push_back(codes[cellValue(cells, width, row)]);
+  put<uint8_t>(out, bits);
+  pack(row_codes, bits, out);
+}
+
+static void encodeRunLength(std::string const& cells, size_t width,
+                            uint32_t rows, std::string& out)
+{
+  std::vector<std::pair<std::string_view, uint32_t>> runs;
+  for (uint32_t row = 0; row < rows; row++)
+  {
+    std::string_view value = cellValue(cells, width, row);
+    if (!runs.empty() && runs.back().first == value)
+      runs.back().second++;
+    else
+      runs.push_back({value, 1});
+  }
+
+  put<uint32_t>(out, runs.size());
+  for (const auto& [value, length] : runs)
+  {
+    put<uint32_t>(out, length);
+    put<uint16_t>(out, value.size());
+    out += value;
+  }
+}
+
+static void encodeFrameOfReference(std::vector<int64_t> const& numbers,
+                                   std::string& out)
+{
+  auto [min, max] = std::minmax_element(numbers.begin(), numbers.end());
+  int64_t base = *min;
+  uint8_t bits = bitsFor(*max - base);
+
+  std::vector<uint64_t> offsets;
+  for (const auto& number : numbers)
+    offsets.push_back(number - base);
+  put<int64_t>(out, base);
+  put<uint8_t>(out, bits);
+  pack(offsets, bits, out);
+}
+
+static void encodeDelta(std::vector<int64_t> const& numbers, std::string& out)
+{
+  std::vector<int64_t> deltas;
+  for (size_t i = 1; i < numbers.size(); i++)
+    deltas.push_back(numbers[i] - numbers[i - 1]);
+  int64_t min_delta =
+      deltas.empty() ? 0 : *std::min_element(deltas.begin(), deltas.end());
+  int64_t max_delta =
+      deltas.empty() ? 0 : *std::max_element(deltas.begin(), deltas.end());
+  uint8_t bits = bitsFor(max_delta - min_delta);
+
+  std::vector<uint64_t> offsets;
+  for (const auto& delta : deltas)
+    offsets.push_back(delta - min_delta);
+  put<int64_t>(out, numbers[0]);
+  put<int64_t>(out, min_delta);
+  put<uint8_t>(out, bits);
+  pack(offsets, bits, out);
+}
+
+struct Dictionary
+{
+  std::vector<std::string_view> entries;
+  uint8_t bits;
+  const char* codes;
+};
+
+static bool readDictionary(std::string_view chunk, uint32_t rows,
+                           Dictionary& dictionary)
+{
+  size_t pos = 0;
+  uint32_t count;
+  if (!get(chunk, pos, count) || count > rows)
+    return 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint16_t size;
+    if (!get(chunk, pos, size) || pos + size > chunk.size())
+      return 0;
+    dictionary.entries.push_back(chunk.substr(pos, size));
+    pos += size;
+  }
+
+  if (!get(chunk, pos, dictionary.bits) || dictionary.bits > 32 ||
+      pos + packedSize(rows, dictionary.bits) > chunk.size())
+    return 0;
+  dictionary.codes = chunk.data() + pos;
+  for (uint32_t row = 0; row < rows; row++)
+    if (unpack(dictionary.codes, row, dictionary.bits) >= count)
+      return 0;
+  return 1;
+}
+
+static bool readRuns(std::string_view chunk, uint32_t rows,
+                     std::vector<std::pair<std::string_view, uint32_t>>& runs)
+{
+  size_t pos = 0;
+  uint32_t count;
+  uint64_t total = 0;
+  if (!get(chunk, pos, count) || count > rows)
+    return 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t length;
+    uint16_t size;
+    if (!get(chunk, pos, length) || !get(chunk, pos, size) ||
+        pos + size > chunk.size())
+      return 0;
+    runs.push_back({chunk.substr(pos, size), length});
+    pos += size;
+    total += length;
+  }
+  return total == rows;
+}
+
+// Frame of reference chunks as their base and packed offsets
+static bool readFrame(std::string_view chunk, uint32_t rows, int64_t& base,
+                      uint8_t& bits, const char*& offsets)
+{
+  size_t pos = 0;
+  if (!get(chunk, pos, base) || !get(chunk, pos, bits) || bits > 56 ||
+      pos + packedSize(rows, bits) > chunk.size())
+    return 0;
+  offsets = chunk.data() + pos;
+  return 1;
+}
+
+static bool readDeltas(std::string_view chunk, uint32_t rows,
+                       std::vector<int64_t>& numbers)
+{
+  size_t pos = 0;
+  int64_t first, min_delta;
+  uint8_t bits;
+  if (!get(chunk, pos, first) || !get(chunk, pos, min_delta) ||
+      !get(chunk, pos, bits) || bits > 56 ||
+      pos + packedSize(rows, bits) > chunk.size())
+    return 0;
+
+  numbers.assign(rows, first);
+  for (uint32_t row = 1; row < rows; row++)
+    numbers[row] = numbers[row - 1] + min_delta +
+                   (int64_t)unpack(chunk.data() + pos, row - 1, bits);
+  return 1;
+}
+
+namespace columnEncoding
+{
+ColumnEncoding encode(std::string const& cells, size_t width,
+                      hsql::DataType type, std::string& chunk)
+{
+  uint32_t rows = (width > 0) ? cells.size() / width : 0;
+  chunk = cells;
+  ColumnEncoding encoding = kEncodingPlain;
+  if (rows == 0)
+    return encoding;
+
+  auto consider = [&](ColumnEncoding candidate, std::string&& encoded)
+  {
+    if (encoded.size() < chunk.size())
+    {
+      chunk = std::move(encoded);
+      encoding = candidate;
+    }
+  };
+
+  std::string encoded;
+  encodeRunLength(cells, width, rows, encoded);
+  consider(kEncodingRunLength, std::move(encoded));
+
+  std::vector<int64_t> numbers;
+  if (type == hsql::DataType::CHAR)
+  {
+    encoded.clear();
+    encodeDictionary(cells, width, rows, encoded);
+    consider(kEncodingDictionary, std::move(encoded));
+  }
+  else if (toNumbers(cells, width, rows, numbers))
+  {
+    encoded.clear();
+    encodeFrameOfReference(numbers, encoded);
+    consider(kEncodingFrameOfReference, std::move(encoded));
+    encoded.clear();
+    encodeDelta(numbers, encoded);
+    consider(kEncodingDelta, std::move(encoded));
+  }
+
+  return encoding;
+}
+
+bool decode(std::string_view chunk, ColumnEncoding encoding, size_t width,
+            uint32_t rows, std::string& cells)
+{
+  cells.assign(rows * width, '\0');
+  switch (encoding)
+  {
+  case kEncodingPlain:
+    if (chunk.size() != cells.size())
+      return 0;
+    cells.assign(chunk);
+    return 1;
+  case kEncodingDictionary:
+  {
+    Dictionary dictionary;
+    if (!readDictionary(chunk, rows, dictionary))
+      return 0;
+    for (uint32_t row = 0; row < rows; row++)
+      setCell(cells, width, row,
+              dictionary.entries[unpack(dictionary.codes, row,
+                                        dictionary.bits)]);
+    return 1;
+  }
+  case kEncodingRunLength:
+  {
+    std::vector<std::pair<std::string_view, uint32_t>> runs;
+    if (!readRuns(chunk, rows, runs))
+      return 0;
+    uint32_t row = 0;
+    for (const auto& [value, length] : runs)
+      for (uint32_t i = 0; i < length; i++)
+        setCell(cells, width, row++, value);
+    return 1;
+  }
+  case kEncodingFrameOfReference:
+  {
+    int64_t base;
+    uint8_t bits;
+    const char* offsets;
+    if (!readFrame(chunk, rows, base, bits, offsets))
+      return 0;
+    for (uint32_t row = 0; row < rows; row++)
+      setCell(cells, width, row,
+              std::to_string(base + unpack(offsets, row, bits)));
+    return 1;
+  }
+  case kEncodingDelta:
+  {
+    std::vector<int64_t> numbers;
+    if (!readDeltas(chunk, rows, numbers))
+      return 0;
+    for (uint32_t row = 0; row < rows; row++)
+      setCell(cells, width, row, std::to_string(numbers[row]));
+    return 1;
+  }
+  default:
+    return 0;
+  }
+}
+
+bool filter(std::string_view chunk, ColumnEncoding encoding,
+            hsql::DataType type, uint32_t rows, const hsql::Expr* expr,
+            Where& where, std::string& selected)
+{
+  switch (encoding)
+  {
+  case kEncodingDictionary:
+  {
+    // Every distinct value is compared once, then rows only look up codes
+    Dictionary dictionary;
+    if (!readDictionary(chunk, rows, dictionary))
+      return 0;
+    std::vector<bool> matches;
+    for (const auto& entry : dictionary.entries)
+      matches.push_back(where.compare(entry));
+    for (uint32_t row = 0; row < rows; row++)
+      if (selected[row] &&
+          !matches[unpack(dictionary.codes, row, dictionary.bits)])
+        selected[row] = 0;
+    return 1;
+  }
+  case kEncodingRunLength:
+  {
+    std::vector<std::pair<std::string_view, uint32_t>> runs;
+    if (!readRuns(chunk, rows, runs))
+      return 0;
+    uint32_t row = 0;
+    for (const auto& [value, length] : runs)
+    {
+      if (!where.compare(value))
+        std::fill(selected.begin() + row, selected.begin() + row + length,
+                  '\0');
+      row += length;
+    }
+    return 1;
+  }
+  case kEncodingFrameOfReference:
+  case kEncodingDelta:
+  {
+    // Numbers are compared as numbers, the same way Where does
+    int32_t literal = expr->expr2->ival;
+    if (type == hsql::DataType::DATE &&
+        (expr->expr2->name == nullptr ||
+         !dateToDays(expr->expr2->name, literal)))
+      return 0;
+
+    if (encoding == kEncodingFrameOfReference)
+    {
+      // Offsets are compared against the literal moved by the base
+      int64_t base;
+      uint8_t bits;
+      const char* offsets;
+      if (!readFrame(chunk, rows, base, bits, offsets))
+        return 0;
+      int64_t target = literal - base;
+      for (uint32_t row = 0; row < rows; row++)
+      {
+        int64_t offset = unpack(offsets, row, bits);
+        if (!holds(expr->opType, (offset > target) - (offset < target)))
+          selected[row] = 0;
+      }
+      return 1;
+    }
+
+    std::vector<int64_t> numbers;
+    if (!readDeltas(chunk, rows, numbers))
+      return 0;
+    for (uint32_t row = 0; row < rows; row++)
+      if (!holds(expr->opType,
+                 (numbers[row] > literal) - (numbers[row] < literal)))
+        selected[row] = 0;
+    return 1;
+  }
+  default:
+    return 0;
+  }
+}
+}    // namespace columnEncoding
@@ -0,0 +1,288 @@
+#include "ColumnStore.hh"
+#include "Where.hh"
+#include "filestruct.hh"
+#include "printutils.hh"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+namespace ft = ftools;
+namespace pu = printUtils;
+
+ColumnStore::ColumnStore(std::string const& regs_path,
+                         std::vector<hsql::ColumnDefinition*> const* columns,
+                         uint32_t group_rows)
+    : regs_path(regs_path), rows_per_group(std::max<uint32_t>(group_rows, 1))
+{
+  for (const auto& column : *columns)
+  {
+    widths.push_back(pu::column_width(column));
+    types.push_back(column->type.data_type);
+  }
+}
+
+std::string ColumnStore::groupPath(int group) const
+{
+  return this->regs_path + std::to_string(group) + ".pax";
+}
+
+std::vector<int> ColumnStore::groupIds() const
+{
+  std::vector<int> groups;
+  for (const auto& entry : fs::directory_iterator(this->regs_path))
+  {
+    std::string filename = entry.path().filename();
+    int group;
+    auto [end, error] = std::from_chars(
+        filename.data(), filename.data() + filename.size(), group);
+    if (error == std::errc() && std::string_view(end) == ".pax")
+      groups.push_back(group);
+  }
+  std::sort(groups.begin(), groups.end());
+  return groups;
+}
+
+int ColumnStore::openGroup(int group, std::string& present,
+                           std::vector<Chunk>& chunks) const
+{
+  int fd = open(groupPath(group).c_str(), O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  Header header;
+  chunks.resize(widths.size());
+  present.resize(rows_per_group);
+  if (pread(fd, &header, sizeof(Header), 0) == sizeof(Header) &&
+      header.magic == MAGIC && header.group_rows == rows_per_group &&
+      header.columns == widths.size() &&
+      pread(fd, present.data(), rows_per_group, sizeof(Header)) ==
+          rows_per_group &&
+      pread(fd, chunks.data(), chunks.size() * sizeof(Chunk),
+            sizeof(Header) + rows_per_group) ==
+          (ssize_t)(chunks.size() * sizeof(Chunk)))
+    return fd;
+
+  close(fd);
+  return -1;
+}
+
+bool ColumnStore::readChunk(int fd, Chunk const& chunk, std::string& raw) const
+{
+  raw.resize(chunk.size);
+  return pread(fd, raw.data(), chunk.size, chunk.offset) == chunk.size;
+}
+
+bool ColumnStore::load(int group, Group& data,
+                       std::vector<bool> const* needed) const
+{
+  std::vector<Chunk> chunks;
+  int fd = openGroup(group, data.present, chunks);
+  if (fd < 0)
+    return 0;
+
+  // Columns that aren't needed are never read
+  bool read = 1;
+  std::string raw;
+  data.values.assign(widths.size(), std::string());
+  for (size_t i = 0; read && i < widths.size(); i++)
+    if (needed == nullptr || (*needed)[i])
+      read = readChunk(fd, chunks[i], raw) &&
+             columnEncoding::decode(raw, (ColumnEncoding)chunks[i].encoding,
+                                    widths[i], rows_per_group, data.values[i]);
+
+  close(fd);
+  return read;
+}
+
+bool ColumnStore::store(int group, Group const& data, bool sync) const
+{
+  std::vector<Chunk> chunks;
+  std::vector<std::string> encoded(widths.size());
+  uint32_t offset =
+      sizeof(Header) + rows_per_group + widths.size() * sizeof(Chunk);
+  for (size_t i = 0; i < widths.size(); i++)
+  {
+    ColumnEncoding encoding = columnEncoding::encode(
+        data.values[i], widths[i], types[i], encoded[i]);
+    chunks.push_back({offset, (uint32_t)encoded[i].size(), encoding});
+    offset += encoded[i].size();
+  }
+
+  Header header{MAGIC, rows_per_group, (uint32_t)widths.size()};
+  std::string buffer((const char*)&header, sizeof(Header));
+  buffer += data.present;
+  buffer.append((const char*)chunks.data(), chunks.size() * sizeof(Chunk));
+  for (const auto& values : encoded)
+    buffer += values;
+
+  std::string path = groupPath(group);
+  return ft::writeFile(path + ".tmp", buffer, sync) &&
+         rename((path + ".tmp").c_str(), path.c_str()) == 0;
+}
+
+std::string_view ColumnStore::value(Group const& data, size_t column,
+                                    int pos) const
+{
+  const char* cell = data.values[column].data() + pos * widths[column];
+  return std::string_view(cell, strnlen(cell, widths[column]));
+}
+
+bool ColumnStore::read(int reg_id, std::string& slot) const
+{
+  // The cached group is only trusted while its file is the same one
+  struct stat info;
+  int group = this->group(reg_id);
+  if (stat(groupPath(group).c_str(), &info) != 0)
+    return 0;
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  if (group != cached_group || info.st_ino != cached_info.st_ino ||
+      info.st_size != cached_info.st_size ||
+      info.st_mtim.tv_nsec != cached_info.st_mtim.tv_nsec ||
+      info.st_mtim.tv_sec != cached_info.st_mtim.tv_sec)
+  {
+    cached_group = -1;
+    if (!load(group, cached, nullptr))
+      return 0;
+    cached_group = group;
+    cached_info = info;
+  }
+
+  int pos = position(reg_id);
+  if (!cached.present[pos])
+    return 0;
+
+  slot.clear();
+  for (size_t i = 0; i < widths.size(); i++)
+  {
+    slot += value(cached, i, pos);
+    slot += '\t';
+  }
+  return 1;
+}
+
+std::vector<int> ColumnStore::registerIds() const
+{
+  std::vector<int> reg_ids;
+  std::vector<bool> none(widths.size(), 0);
+  Group data;
+  for (int group : groupIds())
+    if (load(group, data, &none))
+      for (uint32_t pos = 0; pos < rows_per_group; pos++)
+        if (data.present[pos])
+          reg_ids.push_back(group * rows_per_group + pos + 1);
+  return reg_ids;
+}
+
+void ColumnStore::scan(
+    std::vector<bool> const& needed, WhereClause const* clause,
+    std::function<bool(int, int)> const& skip,
+    std::function<void(int, std::vector<std::string_view> const&)> const& emit)
+    const
+{
+  Group data;
+  std::vector<Chunk> chunks;
+  std::vector<std::string> raw(widths.size());
+  std::vector<std::string_view> fields(widths.size());
+  for (int group : groupIds())
+  {
+    int first_id = group * rows_per_group + 1;
+    if (skip(first_id, first_id + rows_per_group - 1))
+      continue;
+    int fd = openGroup(group, data.present, chunks);
+    if (fd < 0)
+      continue;
+
+    // Comparisons are checked on the encoded values first, and only the
+    // columns of a group with registers left are decoded
+    std::string selected = data.present;
+    std::vector<bool> raw_read(widths.size(), 0);
+    bool read = 1;
+    for (size_t i = 0; clause != nullptr && read &&
+                       i < clause->predicates.size();
+         i++)
+    {
+      const Predicate& predicate = clause->predicates[i];
+      size_t column = predicate.column_pos;
+      if (!raw_read[column])
+        read = readChunk(fd, chunks[column], raw[column]);
+      raw_read[column] = 1;
+      if (read)
+        columnEncoding::filter(raw[column],
+                               (ColumnEncoding)chunks[column].encoding,
+                               types[column], rows_per_group, predicate.expr,
+                               *predicate.where, selected);
+    }
+
+    bool any_selected =
+        std::any_of(selected.begin(), selected.end(), [](char c) { return c; });
+    data.values.assign(widths.size(), std::string());
+    for (size_t i = 0; read && any_selected && i < widths.size(); i++)
+      if (needed[i])
+        read = (raw_read[i] || readChunk(fd, chunks[i], raw[i])) &&
+               columnEncoding::decode(
+                   raw[i], (ColumnEncoding)chunks[i].encoding, widths[i],
+                   rows_per_group, data.values[i]);
+    close(fd);
+    if (!read || !any_selected)
+      continue;
+
+    for (uint32_t pos = 0; pos < rows_per_group; pos++)
+    {
+      if (!selected[pos])
+        continue;
+      for (size_t i = 0; i < widths.size(); i++)
+        fields[i] = needed[i] ? value(data, i, pos) : std::string_view();
+      emit(first_id + pos, fields);
+    }
+  }
+}
+
+bool ColumnStore::save(bool sync)
+{
+  bool written = 1;
+  Group data;
+  for (const auto& [group, changes] : this->pending)
+  {
+    // A group that can't be read is left alone rather than overwritten. Only
+    // one with no file yet starts out empty
+    if (!load(group, data, nullptr))
+    {
+      if (ft::fileExists(groupPath(group)))
+      {
+        written = 0;
+        continue;
+      }
+      data.present.assign(rows_per_group, '\0');
+      data.values.clear();
+      for (const auto& width : widths)
+        data.values.push_back(std::string(rows_per_group * width, '\0'));
+    }
+
+    for (const auto& change : changes)
+    {
+      data.present[change.pos] = change.present;
+      for (size_t i = 0; change.present && i < widths.size(); i++)
+      {
+        char* cell = data.values[i].data() + change.pos * widths[i];
+        memset(cell, 0, widths[i]);
+        if (i < change.values.size())
+          memcpy(cell, change.values[i].data(),
+                 std::min(change.values[i].size(), widths[i]));
+      }
+    }
+
+    written &= store(group, data, sync);
+  }
+
+  // The renames only last once the folder is synced
+  if (sync && !this->pending.empty())
+    written &= ft::syncDir(this->regs_path);
+  this->pending.clear();
+  return written;
+}
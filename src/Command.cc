@@ -0,0 +1,272 @@
+#include "Command.hh"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static std::vector<std::string> tokenizeCommand(std::string const& query)
+{
+  std::vector<std::string> tokens;
+  size_t i = 0;
+  while (i < query.size())
+  {
+    if (isspace(query[i]) || query[i] == ';')
+      i++;
+    else if (query[i] == '(' || query[i] == ')' || query[i] == ',')
+      tokens.push_back(std::string(1, query[i++]));
+    else if (query[i] == '\'')
+    {
+      // Quoted literals keep their quote so they can be told apart
+      size_t end = query.find('\'', i + 1);
+      if (end == std::string::npos)
+        end = query.size();
+      tokens.push_back(query.substr(i, end - i));
+      i = end + 1;
+    }
+    else
+    {
+      size_t end = i;
+      while (end < query.size() && !isspace(query[end]) &&
+             !strchr(";(),", query[end]))
+        end++;
+      tokens.push_back(query.substr(i, end - i));
+      i = end;
+    }
+  }
+
+  return tokens;
+}
+
+static bool isKeyword(std::string const& token, const char* keyword)
+{
+  if (token.size() != strlen(keyword))
+    return 0;
+  for (size_t i = 0; i < token.size(); i++)
+    if (toupper(token[i]) != keyword[i])
+      return 0;
+  return 1;
+}
+
+static bool isLiteral(std::string const& token)
+{
+  return !token.empty() && token[0] == '\'';
+}
+
+// Takes the PRIMARY KEY and UNIQUE constraints out of a CREATE TABLE, as
+// column constraints or as separate elements of its column list, and its
+// storage options, and keeps the rest of the statement for the SQL parser
+static void parseCreateTable(std::vector<std::string> const& tokens,
+                             Command& command)
+{
+  if (tokens.size() < 4 || tokens[3] != "(")
+    return;
+
+  // Split the column list into its elements
+  std::vector<std::vector<std::string>> elements(1);
+  int depth = 1;
+  size_t i = 4;
+  for (; i < tokens.size() && depth > 0; i++)
+  {
+    depth += (tokens[i] == "(") - (tokens[i] == ")");
+    if (depth == 0)
+      break;
+    if (depth == 1 && tokens[i] == ",")
+      elements.emplace_back();
+    else
+      elements.back().push_back(tokens[i]);
+  }
+  if (depth > 0)
+    return;
+
+  // Storage options come after the column list
+  bool has_options = i + 1 < tokens.size();
+  if (has_options)
+  {
+    std::string options;
+    if (i + 3 >= tokens.size() || !isKeyword(tokens[i + 1], "WITH") ||
+        tokens[i + 2] != "(" || tokens.back() != ")")
+      return;
+    for (size_t j = i + 3; j + 1 < tokens.size(); j++)
+      options += tokens[j];
+    if (isKeyword(options, "STORAGE=COLUMNAR"))
+      command.storage = kStorageColumnar;
+    else if (!isKeyword(options, "STORAGE=ROW"))
+      return;
+  }
+
+  std::string columns;
+  for (const auto& element : elements)
+  {
+    if (element.empty())
+      return;
+
+    bool primary_key =
+        element.size() > 2 && isKeyword(element[0], "PRIMARY") &&
+        isKeyword(element[1], "KEY") && element[2] == "(";
+    if (primary_key ||
+        (element.size() > 1 && isKeyword(element[0], "UNIQUE") &&
+         element[1] == "("))
+    {
+      Constraint constraint{
+          primary_key ? kConstraintPrimaryKey : kConstraintUnique, {}};
+      for (size_t j = primary_key ? 3 : 2; j < element.size(); j++)
+        if (element[j] != "," && element[j] != ")")
+          constraint.columns.push_back(element[j]);
+      command.constraints.push_back(constraint);
+      continue;
+    }
+
+    std::string column;
+    for (size_t j = 0; j < element.size(); j++)
+    {
+      if (j + 1 < element.size() && isKeyword(element[j], "PRIMARY") &&
+          isKeyword(element[j + 1], "KEY"))
+      {
+        command.constraints.push_back({kConstraintPrimaryKey, {element[0]}});
+        j++;
+      }
+      else if (isKeyword(element[j], "UNIQUE"))
+        command.constraints.push_back({kConstraintUnique, {element[0]}});
+      else
+        column += " " + element[j] + (isLiteral(element[j]) ? "'" : "");
+    }
+    columns += (columns.empty() ? "" : ",") + column;
+  }
+
+  if (command.constraints.empty() && !has_options)
+    return;
+
+  command.table_name = tokens[2];
+  command.query = "CREATE TABLE " + tokens[2] + " (" + columns + ");";
+  command.type = kCommandCreateTable;
+}
+
+Command Command::parse(std::string const& query)
+{
+  Command command;
+  auto tokens = tokenizeCommand(query);
+  if (tokens.empty())
+    return command;
+
+  if (isKeyword(tokens[0], "COPY"))
+  {
+    if (tokens.size() < 4 || !isKeyword(tokens[2], "FROM") ||
+        !isLiteral(tokens[3]))
+      return command;
+
+    command.table_name = tokens[1];
+    command.file_path = tokens[3].substr(1);
+    if (command.file_path.size() > 4 &&
+        command.file_path.substr(command.file_path.size() - 4) == ".tsv")
+      command.delimiter = '\t';
+
+    for (size_t i = 4; i < tokens.size(); i++)
+    {
+      if (isKeyword(tokens[i], "HEADER"))
+        command.header = 1;
+      else if (isKeyword(tokens[i], "DELIMITER") && i + 1 < tokens.size() &&
+               isLiteral(tokens[i + 1]) && tokens[i + 1].size() == 2)
+        command.delimiter = tokens[++i][1];
+      else if (isKeyword(tokens[i], "DELIMITER") && i + 1 < tokens.size() &&
+               tokens[i + 1] == "'\\t")
+      {
+        command.delimiter = '\t';
+        i++;
+      }
+      else
+        return command;
+    }
+
+    command.type = kCommandCopy;
+  }
+  else if (tokens.size() > 1 && isKeyword(tokens[0], "CREATE") &&
+           isKeyword(tokens[1], "INDEX"))
+  {
+    // The index name is optional and unused: indexes are named after their
+    // columns
+    size_t i = 2;
+    if (i < tokens.size() && !isKeyword(tokens[i], "ON"))
+      i++;
+    if (i + 1 >= tokens.size() || !isKeyword(tokens[i], "ON"))
+      return command;
+    command.table_name = tokens[i + 1];
+
+    bool has_using = 0;
+    for (i += 2; i < tokens.size(); i++)
+    {
+      if (isKeyword(tokens[i], "USING") && i + 1 < tokens.size())
+      {
+        has_using = 1;
+        if (isKeyword(tokens[i + 1], "HASH"))
+          command.index_type = kIndexHash;
+        else if (isKeyword(tokens[i + 1], "BTREE"))
+          command.index_type = kIndexTree;
+        else
+          return command;
+        i++;
+      }
+      else if (tokens[i] == "(" ||
+               (isKeyword(tokens[i], "INCLUDE") && i + 1 < tokens.size() &&
+                tokens[i + 1] == "("))
+      {
+        // A list after INCLUDE holds the included columns
+        auto& list = (tokens[i] == "(") ? command.columns : command.include;
+        i += (tokens[i] == "(") ? 1 : 2;
+        for (; i < tokens.size() && tokens[i] != ")"; i++)
+          if (tokens[i] != ",")
+            list.push_back(tokens[i]);
+        if (i == tokens.size())
+          return command;
+      }
+      else
+        return command;
+    }
+
+    // Plain CREATE INDEX statements are left to the SQL parser
+    if ((has_using || !command.include.empty()) && !command.columns.empty())
+      command.type = kCommandCreateIndex;
+  }
+  else if (tokens.size() > 4 && isKeyword(tokens[0], "CREATE") &&
+           isKeyword(tokens[1], "BLOOM") && isKeyword(tokens[2], "FILTER"))
+  {
+    if (!isKeyword(tokens[3], "ON") || tokens.size() < 7 || tokens[5] != "(")
+      return command;
+    command.table_name = tokens[4];
+
+    size_t i = 6;
+    for (; i < tokens.size() && tokens[i] != ")"; i++)
+      if (tokens[i] != ",")
+        command.columns.push_back(tokens[i]);
+    if (i == tokens.size() || command.columns.empty())
+      return command;
+
+    if (i + 2 < tokens.size() && isKeyword(tokens[i + 1], "FPR"))
+    {
+      char* end;
+      command.false_positive_rate = strtod(tokens[i + 2].c_str(), &end);
+      if (*end != '\0' || command.false_positive_rate <= 0 ||
+          command.false_positive_rate >= 1)
+        return command;
+      i += 2;
+    }
+    if (i + 1 != tokens.size())
+      return command;
+
+    command.type = kCommandCreateBloomFilter;
+  }
+  else if (tokens.size() > 1 && isKeyword(tokens[0], "CREATE") &&
+           isKeyword(tokens[1], "TABLE"))
+    parseCreateTable(tokens, command);
+  else if ((isKeyword(tokens[0], "BEGIN") &&
+            (tokens.size() == 1 ||
+             (tokens.size() == 2 && isKeyword(tokens[1], "TRANSACTION")))) ||
+           (tokens.size() == 2 && isKeyword(tokens[0], "START") &&
+            isKeyword(tokens[1], "TRANSACTION")))
+    command.type = kCommandBegin;
+  else if (tokens.size() == 1 && isKeyword(tokens[0], "COMMIT"))
+    command.type = kCommandCommit;
+  else if (tokens.size() == 1 && isKeyword(tokens[0], "ROLLBACK"))
+    command.type = kCommandRollback;
+
+  return command;
+}
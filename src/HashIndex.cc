@@ -0,0 +1,278 @@
+#include "HashIndex.hh"
+#include "filestruct.hh"
+#include "parallelutils.hh"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ft = ftools;
+
+HashIndex::HashIndex(std::string const& folder)
+{
+  std::string path = folder + "hash.dat";
+  bool created = !ft::fileExists(path);
+  this->fd = open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  this->overflow_fd = open((folder + "overflow.dat").c_str(), O_RDWR | O_CREAT,
+                           S_IRUSR | S_IWUSR);
+
+  if (created ||
+      pread(this->fd, &this->header, sizeof(Header), 0) != sizeof(Header) ||
+      this->header.magic != MAGIC)
+  {
+    this->header = Header{MAGIC, 0, 0, 0, 0, 0};
+    writeHeader();
+  }
+}
+
+HashIndex::~HashIndex()
+{
+  close(this->fd);
+  close(this->overflow_fd);
+}
+
+bool HashIndex::exists(std::string const& folder)
+{
+  return ft::fileExists(folder + "hash.dat");
+}
+
+uint32_t HashIndex::hash(int key)
+{
+  // Finalizer of MurmurHash3, so neighbouring keys spread over buckets
+  uint32_t h = key;
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+uint32_t HashIndex::bucketFor(int key, uint32_t level, uint32_t next_split)
+{
+  uint32_t h = hash(key);
+  uint32_t bucket = h % (INITIAL_BUCKETS << level);
+  if (bucket < next_split)
+    bucket = h % (INITIAL_BUCKETS << (level + 1));
+  return bucket;
+}
+
+uint32_t HashIndex::buckets() const
+{
+  return (INITIAL_BUCKETS << this->header.level) + this->header.next_split;
+}
+
+void HashIndex::readPage(PageRef ref, Page& page) const
+{
+  // Pages past the end of the file are empty
+  ssize_t read = ref.overflow ? pread(this->overflow_fd, &page, PAGE_SIZE,
+                                      (off_t)ref.number * PAGE_SIZE)
+                              : pread(this->fd, &page, PAGE_SIZE,
+                                      (off_t)(ref.number + 1) * PAGE_SIZE);
+  if (read != PAGE_SIZE)
+    memset(&page, 0, PAGE_SIZE);
+}
+
+void HashIndex::writePage(PageRef ref, Page const& page) const
+{
+  if (ref.overflow)
+    pwrite(this->overflow_fd, &page, PAGE_SIZE, (off_t)ref.number * PAGE_SIZE);
+  else
+    pwrite(this->fd, &page, PAGE_SIZE, (off_t)(ref.number + 1) * PAGE_SIZE);
+}
+
+void HashIndex::writeHeader() const
+{
+  pwrite(this->fd, &this->header, sizeof(Header), 0);
+}
+
+uint32_t HashIndex::allocateOverflow()
+{
+  if (this->header.free_overflow == 0)
+    return this->header.overflow_pages++;
+
+  uint32_t number = this->header.free_overflow - 1;
+  Page page;
+  readPage({number, 1}, page);
+  this->header.free_overflow = page.next;
+  return number;
+}
+
+std::vector<HashIndex::Entry> HashIndex::readChain(uint32_t bucket) const
+{
+  std::vector<Entry> entries;
+  Page page;
+  PageRef ref{bucket, 0};
+  while (1)
+  {
+    readPage(ref, page);
+    entries.insert(entries.end(), page.entries, page.entries + page.count);
+    if (page.next == 0)
+      return entries;
+    ref = {page.next - 1, 1};
+  }
+}
+
+void HashIndex::writeChain(uint32_t bucket, std::vector<Entry> const& entries)
+{
+  // Overflow pages already in the chain are reused, the rest are freed
+  std::vector<uint32_t> overflow;
+  Page page;
+  readPage({bucket, 0}, page);
+  while (page.next != 0)
+  {
+    overflow.push_back(page.next - 1);
+    readPage({page.next - 1, 1}, page);
+  }
+
+  size_t pages =
+      std::max<size_t>(1, (entries.size() + ENTRIES_PER_PAGE - 1) /
+                              ENTRIES_PER_PAGE);
+  while (overflow.size() < pages - 1)
+    overflow.push_back(allocateOverflow());
+  while (overflow.size() > pages - 1)
+  {
+    memset(&page, 0, PAGE_SIZE);
+    page.next = this->header.free_overflow;
+    writePage({overflow.back(), 1}, page);
+    this->header.free_overflow = overflow.back() + 1;
+    overflow.pop_back();
+  }
+
+  for (size_t i = 0; i < pages; i++)
+  {
+    size_t first = i * ENTRIES_PER_PAGE;
+    memset(&page, 0, PAGE_SIZE);
+    page.count = std::min(ENTRIES_PER_PAGE, entries.size() - first);
+    page.next = (i + 1 < pages) ? overflow[i] + 1 : 0;
+    std::copy(entries.begin() + first, entries.begin() + first + page.count,
+              page.entries);
+    writePage((i == 0) ? PageRef{bucket, 0} : PageRef{overflow[i - 1], 1},
+              page);
+  }
+}
+
+void HashIndex::split()
+{
+  uint32_t bucket = this->header.next_split;
+  uint32_t new_bucket = bucket + (INITIAL_BUCKETS << this->header.level);
+
+  std::vector<Entry> kept, moved;
+  for (const auto& entry : readChain(bucket))
+  {
+    if (hash(entry.key) % (INITIAL_BUCKETS << (this->header.level + 1)) ==
+        bucket)
+      kept.push_back(entry);
+    else
+      moved.push_back(entry);
+  }
+
+  writeChain(bucket, kept);
+  writeChain(new_bucket, moved);
+
+  if (++this->header.next_split == (INITIAL_BUCKETS << this->header.level))
+  {
+    this->header.level++;
+    this->header.next_split = 0;
+  }
+}
+
+void HashIndex::insert(int key, uint32_t reg_id)
+{
+  uint32_t bucket =
+      bucketFor(key, this->header.level, this->header.next_split);
+
+  // Append to the first page of the chain with room, or to a new overflow
+  // page at its end
+  Page page;
+  PageRef ref{bucket, 0};
+  readPage(ref, page);
+  while (page.count == ENTRIES_PER_PAGE && page.next != 0)
+  {
+    ref = {page.next - 1, 1};
+    readPage(ref, page);
+  }
+
+  if (page.count == ENTRIES_PER_PAGE)
+  {
+    uint32_t number = allocateOverflow();
+    page.next = number + 1;
+    writePage(ref, page);
+
+    ref = {number, 1};
+    memset(&page, 0, PAGE_SIZE);
+  }
+  page.entries[page.count++] = {key, reg_id};
+  writePage(ref, page);
+
+  this->header.entries++;
+  if (this->header.entries >
+      MAX_LOAD_FACTOR * buckets() * ENTRIES_PER_PAGE)
+    split();
+  writeHeader();
+}
+
+bool HashIndex::remove(int key, uint32_t reg_id)
+{
+  Page page;
+  PageRef ref{bucketFor(key, this->header.level, this->header.next_split), 0};
+  while (1)
+  {
+    readPage(ref, page);
+    for (uint32_t i = 0; i < page.count; i++)
+      if (page.entries[i].key == key && page.entries[i].reg_id == reg_id)
+      {
+        page.entries[i] = page.entries[--page.count];
+        writePage(ref, page);
+        this->header.entries--;
+        writeHeader();
+        return 1;
+      }
+
+    if (page.next == 0)
+      return 0;
+    ref = {page.next - 1, 1};
+  }
+}
+
+std::vector<uint32_t> HashIndex::lookup(int key)
+{
+  std::vector<uint32_t> reg_ids;
+  for (const auto& entry : readChain(
+           bucketFor(key, this->header.level, this->header.next_split)))
+    if (entry.key == key)
+      reg_ids.push_back(entry.reg_id);
+  return reg_ids;
+}
+
+void HashIndex::build(std::string const& folder,
+                      std::vector<Entry> const& entries)
+{
+  // Smallest level that keeps the load factor under the limit
+  uint32_t level = 0;
+  while (entries.size() >
+         MAX_LOAD_FACTOR * (INITIAL_BUCKETS << level) * ENTRIES_PER_PAGE)
+    level++;
+  uint32_t bucket_count = INITIAL_BUCKETS << level;
+
+  // (bucket, position) pairs sorted in parallel give each bucket's entries
+  std::vector<uint64_t> order(entries.size());
+  for (size_t i = 0; i < entries.size(); i++)
+    order[i] = (uint64_t)bucketFor(entries[i].key, level, 0) << 32 | i;
+  parallelUtils::sort(order.begin(), order.end());
+
+  HashIndex index(folder);
+  index.header.level = level;
+
+  std::vector<Entry> bucket_entries;
+  size_t i = 0;
+  for (uint32_t bucket = 0; bucket < bucket_count; bucket++)
+  {
+    bucket_entries.clear();
+    for (; i < order.size() && (order[i] >> 32) == bucket; i++)
+      bucket_entries.push_back(entries[(uint32_t)order[i]]);
+    index.writeChain(bucket, bucket_entries);
+  }
+
+  index.header.entries = entries.size();
+  index.writeHeader();
+}
@@ -0,0 +1,253 @@
+#include "Index.hh"
+#include "HashIndex.hh"
+#include "Where.hh"
+#include "filestruct.hh"
+#include "parallelutils.hh"
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <thread>
+
+namespace fs = std::filesystem;
+namespace ft = ftools;
+
+static int parseKey(std::string_view key)
+{
+  int value = 0;
+  std::from_chars(key.data(), key.data() + key.size(), value);
+  return value;
+}
+
+// Registers are named after their id, as in 12.sqlito
+static uint32_t registerId(std::string const& filename)
+{
+  uint32_t reg_id = 0;
+  std::from_chars(filename.data(), filename.data() + filename.size(), reg_id);
+  return reg_id;
+}
+
+static std::string registerFilename(uint32_t reg_id)
+{
+  return std::to_string(reg_id) + ".sqlito";
+}
+
+// Creates the folders of a key, one level per column
+static void createKeyFolders(std::string const& path, std::string const& key)
+{
+  for (size_t end = key.find('/'); end != std::string::npos;
+       end = key.find('/', end + 1))
+    mkdir((path + key.substr(0, end)).c_str(), S_IRWXU);
+}
+
+std::string Index::nameFor(std::vector<std::string> const& columns,
+                           std::vector<std::string> const& include)
+{
+  std::string name;
+  for (const auto& column : columns)
+    name += (name.empty() ? "" : ",") + column;
+  for (size_t i = 0; i < include.size(); i++)
+    name += (i == 0 ? "+" : ",") + include[i];
+  return name;
+}
+
+bool Index::covers(int column_pos) const
+{
+  return std::count(this->column_pos.begin(), this->column_pos.end(),
+                    column_pos) > 0 ||
+         std::count(include_pos.begin(), include_pos.end(), column_pos) > 0;
+}
+
+void Index::add(std::string const& key, std::string const& filename,
+                std::string const& payload) const
+{
+  if (this->type == kIndexHash)
+  {
+    HashIndex(this->path).insert(parseKey(key), registerId(filename));
+    return;
+  }
+
+  createKeyFolders(this->path, key);
+  ft::writeFile(this->path + key + filename, payload);
+}
+
+void Index::remove(std::string const& key, std::string const& filename) const
+{
+  if (this->type == kIndexHash)
+  {
+    HashIndex(this->path).remove(parseKey(key), registerId(filename));
+    return;
+  }
+
+  ::remove((this->path + key + filename).c_str());
+
+  // Folders left empty are removed, deepest first
+  std::error_code error_code;
+  std::string folder = key;
+  while (!folder.empty())
+  {
+    if (!fs::is_empty(fs::path(this->path + folder), error_code) ||
+        ::remove((this->path + folder).c_str()) != 0)
+      break;
+    folder.pop_back();
+    folder.erase(folder.rfind('/') + 1);
+  }
+}
+
+// Adds the registers below folder, which is depth levels above them
+static void collectRegisters(std::string const& folder, size_t depth,
+                             Where* range, std::vector<std::string>& filenames)
+{
+  for (const auto& entry : fs::directory_iterator(folder))
+  {
+    std::string name = entry.path().filename();
+    if (depth == 0)
+      filenames.push_back(name);
+    else if (range == nullptr || range->compare(name))
+      collectRegisters(folder + name + "/", depth - 1, nullptr, filenames);
+  }
+}
+
+std::vector<std::string> Index::lookup(std::vector<std::string> const& prefix,
+                                       Where* range) const
+{
+  std::vector<std::string> filenames;
+  if (this->type == kIndexHash)
+  {
+    HashIndex index(this->path);
+    for (const auto& reg_id : index.lookup(parseKey(prefix[0])))
+      filenames.push_back(registerFilename(reg_id));
+    return filenames;
+  }
+
+  std::string folder = this->path;
+  for (const auto& value : prefix)
+    folder += value + "/";
+  if (ft::dirExists(folder))
+    collectRegisters(folder, this->columns.size() - prefix.size(), range,
+                     filenames);
+  return filenames;
+}
+
+// Adds the entries below folder, which is depth levels above them. values
+// holds the key values of the folders walked so far
+static void collectEntries(std::string const& folder, size_t depth,
+                           Where* range, bool has_payload,
+                           std::vector<std::string>& values,
+                           std::vector<IndexEntry>& entries)
+{
+  std::string payload;
+  for (const auto& entry : fs::directory_iterator(folder))
+  {
+    std::string name = entry.path().filename();
+    if (depth > 0)
+    {
+      if (range != nullptr && !range->compare(name))
+        continue;
+      values.push_back(name);
+      collectEntries(folder + name + "/", depth - 1, nullptr, has_payload,
+                     values, entries);
+      values.pop_back();
+      continue;
+    }
+
+    entries.push_back({name, values});
+    if (!has_payload || !ft::readSlot(folder + name, payload))
+      continue;
+
+    size_t start = 0, end;
+    while ((end = payload.find('\t', start)) != std::string::npos)
+    {
+      entries.back().values.push_back(payload.substr(start, end - start));
+      start = end + 1;
+    }
+  }
+}
+
+std::vector<IndexEntry> Index::scan(std::vector<std::string> const& prefix,
+                                    Where* range) const
+{
+  std::vector<IndexEntry> entries;
+  if (this->type == kIndexHash)
+  {
+    for (auto& filename : lookup(prefix))
+      entries.push_back({std::move(filename), prefix});
+    return entries;
+  }
+
+  std::string folder = this->path;
+  for (const auto& value : prefix)
+    folder += value + "/";
+  std::vector<std::string> values = prefix;
+  if (ft::dirExists(folder))
+    collectEntries(folder, this->columns.size() - prefix.size(), range,
+                   !this->include.empty(), values, entries);
+  return entries;
+}
+
+void Index::bulk_add(std::vector<const std::vector<std::string>*> const& rows,
+                     std::vector<const std::string*> const& filenames) const
+{
+  if (this->type == kIndexHash)
+  {
+    std::vector<HashIndex::Entry> entries(rows.size());
+    for (size_t i = 0; i < rows.size(); i++)
+      entries[i] = {parseKey((*rows[i])[this->column_pos[0]]),
+                    registerId(*filenames[i])};
+
+    // An empty index is rebuilt at the right size, a populated one grows
+    {
+      HashIndex index(this->path);
+      if (index.size() > 0)
+      {
+        for (const auto& entry : entries)
+          index.insert(entry.key, entry.reg_id);
+        return;
+      }
+    }
+    HashIndex::build(this->path, entries);
+    return;
+  }
+
+  // Entries are sorted by key in parallel, so each key folder is created
+  // once and filled in one go
+  std::vector<std::string> keys(rows.size());
+  std::vector<uint32_t> order(rows.size());
+  for (size_t i = 0; i < rows.size(); i++)
+  {
+    keys[i] = key(*rows[i]);
+    order[i] = i;
+  }
+  parallelUtils::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return keys[a] < keys[b];
+  });
+
+  // Disjoint key ranges are written by separate threads
+  size_t ranges = parallelUtils::thread_count(order.size(), 1 << 14);
+  std::vector<size_t> bounds{0};
+  for (size_t r = 1; r < ranges; r++)
+  {
+    size_t bound = std::max(bounds.back(), order.size() * r / ranges);
+    while (bound > 0 && bound < order.size() &&
+           keys[order[bound]] == keys[order[bound - 1]])
+      bound++;
+    bounds.push_back(bound);
+  }
+  bounds.push_back(order.size());
+
+  auto write_range = [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++)
+    {
+      const std::string& key = keys[order[i]];
+      if (i == first || key != keys[order[i - 1]])
+        createKeyFolders(this->path, key);
+      ft::writeFile(this->path + key + *filenames[order[i]],
+                    payload(*rows[order[i]]));
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t r = 0; r + 1 < bounds.size(); r++)
+    workers.emplace_back(write_range, bounds[r], bounds[r + 1]);
+  for (auto& worker : workers)
+    worker.join();
+}
@@ -0,0 +1,120 @@
+#include "Journal.hh"
+#include "filestruct.hh"
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace ft = ftools;
+
+Journal::Journal(std::string const& table_path, std::string const& regs_path)
+    : path(table_path + "journal.dat"), table_path(table_path),
+      regs_path(regs_path)
+{
+}
+
+void Journal::log_update(std::string const& filename,
+                         std::string const& before, std::string const& after)
+{
+  buffer += "U " + filename + " " + std::to_string(before.size()) + " " +
+            std::to_string(after.size()) + "\n";
+  buffer += before;
+  buffer += after;
+}
+
+void Journal::log_delete(std::string const& filename)
+{
+  buffer += "D " + filename + "\n";
+}
+
+bool Journal::commit()
+{
+  buffer += "C\n";
+
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return 0;
+
+  // The folder is synced too, or the new journal could be missing after a
+  // crash
+  bool written =
+      write(fd, buffer.data(), buffer.size()) == (ssize_t)buffer.size() &&
+      fsync(fd) == 0 && ft::syncDir(table_path);
+  close(fd);
+  buffer.clear();
+  return written;
+}
+
+void Journal::clear()
+{
+  remove(path.c_str());
+}
+
+void Journal::recover(
+    std::string const& table_path,
+    std::function<bool(std::string const&, std::string const&)> const&
+        write_slot,
+    std::function<bool(std::vector<std::string> const&)> const& mark_deleted)
+{
+  std::string path = table_path + "journal.dat";
+  std::ifstream journal_file(path, std::ios::binary);
+  if (!journal_file.is_open())
+    return;
+
+  std::stringstream content;
+  content << journal_file.rdbuf();
+  std::string journal = content.str();
+
+  std::vector<std::pair<std::string, std::string>> after_images;
+  std::vector<std::string> deleted;
+  bool committed = 0;
+  size_t pos = 0;
+  while (pos < journal.size())
+  {
+    size_t end = journal.find('\n', pos);
+    if (end == std::string::npos)
+      break;
+
+    std::istringstream header(journal.substr(pos, end - pos));
+    pos = end + 1;
+
+    char type;
+    header >> type;
+    if (type == 'C')
+    {
+      committed = 1;
+      break;
+    }
+
+    std::string filename;
+    if (type == 'D')
+    {
+      if (!(header >> filename))
+        break;
+      deleted.push_back(filename);
+      continue;
+    }
+
+    size_t before_size, after_size;
+    if (!(header >> filename >> before_size >> after_size) ||
+        pos + before_size + after_size > journal.size())
+      break;
+
+    after_images.push_back(
+        {filename, journal.substr(pos + before_size, after_size)});
+    pos += before_size + after_size;
+  }
+
+  // An uncommitted journal means no register was touched yet
+  if (committed)
+  {
+    for (const auto& [filename, after] : after_images)
+      write_slot(filename, after);
+    if (!deleted.empty())
+      mark_deleted(deleted);
+  }
+
+  journal_file.close();
+  remove(path.c_str());
+}
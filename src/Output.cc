@@ -0,0 +1,32 @@
+#include "Output.hh"
+#include <iostream>
+
+namespace output
+{
+static thread_local Capture* current = nullptr;
+
+std::ostream& out()
+{
+  return current ? current->stream() : std::cout;
+}
+
+std::ostream& err()
+{
+  return current ? current->stream() : std::cerr;
+}
+
+std::ostream* captured()
+{
+  return current ? &current->stream() : nullptr;
+}
+
+Capture::Capture() : previous(current)
+{
+  current = this;
+}
+
+Capture::~Capture()
+{
+  current = this->previous;
+}
+}    // namespace output
@@ -1,16 +1,471 @@
 #include "Processor.hh"
+#include "Output.hh"
+#include "VersionStore.hh"
+#include <charconv>
+#include <optional>
+#include <thread>
+#include <unordered_set>
 
 namespace fs = std::filesystem;
 namespace ft = ftools;
 namespace pu = printUtils;
 
+namespace
+{
+// Checks a value read from a COPY file or given to UPDATE against its
+// column, the same way insert_record checks literals. INT values are
+// returned normalized and DATE values as day numbers.
+std::string checkValue(std::string const& value,
+                       hsql::ColumnDefinition* column,
+                       std::unique_ptr<Table> const& table)
+{
+  switch (column->type.data_type)
+  {
+  case hsql::DataType::INT:
+  {
+    char* end;
+    errno = 0;
+    long ival = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno == ERANGE || ival > INT32_MAX ||
+        ival < INT32_MIN)
+      throw DBException{INVALID_DATA_TYPE, table->name, column->name};
+    return std::to_string(ival);
+  }
+  case hsql::DataType::CHAR:
+    if (value.size() > (size_t)column->type.length)
+      throw DBException{CHAR_TOO_BIG, table->name, column->name};
+    return value;
+  case hsql::DataType::DATE:
+  {
+    int32_t days;
+    if (!dateToDays(value, days))
+      throw DBException{INVALID_DATE, table->name, value};
+    return std::to_string(days);
+  }
+  default:
+    throw DBException{INVALID_DATA_TYPE, table->name, column->name};
+  }
+}
+
+// Indexes enforcing the table's PRIMARY KEY and UNIQUE constraints
+std::vector<const Index*> uniqueIndexes(std::unique_ptr<Table> const& table)
+{
+  std::vector<const Index*> indexes;
+  for (const auto& constraint : table->constraints)
+    if (const Index* index = table->constraintIndex(constraint))
+      indexes.push_back(index);
+  return indexes;
+}
+
+// Checks that no new row repeats the key of a unique index, either among
+// themselves or against a stored register other than the replaced ones.
+// Each key is a single index probe
+void checkUnique(std::unique_ptr<Table> const& table,
+                 std::vector<const RegisterData*> const& new_rows,
+                 std::vector<const Index*> const& indexes,
+                 std::unordered_set<std::string> const& replaced = {})
+{
+  for (const auto& index : indexes)
+  {
+    std::unordered_set<std::string> keys;
+    std::vector<std::string> prefix(index->column_pos.size());
+    for (const auto& row : new_rows)
+    {
+      if (!keys.insert(index->key(*row)).second)
+        throw DBException{DUPLICATE_KEY, table->name, index->name};
+
+      for (size_t i = 0; i < prefix.size(); i++)
+        prefix[i] = (*row)[index->column_pos[i]];
+      for (const auto& filename : index->lookup(prefix))
+        if (!table->isDeleted(filename) && replaced.count(filename) == 0)
+          throw DBException{DUPLICATE_KEY, table->name, index->name};
+    }
+  }
+}
+
+// Index lookup serving a WHERE clause: equalities on the leading columns of
+// the index, then at most one more condition on the next column. A covering
+// index keeps every column the statement reads
+struct IndexPlan
+{
+  const Index* index = nullptr;
+  std::vector<std::string> prefix;
+  Where* range = nullptr;
+  bool covering = 0;
+};
+
+IndexPlan planIndex(WhereClause const& clause,
+                    std::unique_ptr<Table> const& table,
+                    std::vector<int> const& read_columns = {})
+{
+  // Equalities name key folders directly, spelled the way keys are stored:
+  // INT literals as they are and DATE literals as day numbers
+  auto is_equality = [](hsql::OperatorType op) {
+    return op == hsql::kOpEquals;
+  };
+  auto narrows = [](hsql::OperatorType op) {
+    return op != hsql::kOpNotEquals;
+  };
+
+  IndexPlan best;
+  size_t best_score = 0;
+  for (const auto& index : *table->indexes)
+  {
+    IndexPlan plan;
+    plan.index = index;
+    for (const auto& pos : index->column_pos)
+    {
+      const Predicate* equality = clause.find(pos, is_equality);
+      int32_t days;
+      if (equality == nullptr)
+        break;
+      if (equality->expr->expr2->type == hsql::kExprLiteralInt)
+        plan.prefix.push_back(std::to_string(equality->expr->expr2->ival));
+      else if (table->columns->at(pos)->type.data_type ==
+                   hsql::DataType::DATE &&
+               dateToDays(equality->expr->expr2->name, days))
+        plan.prefix.push_back(std::to_string(days));
+      else
+        break;
+    }
+
+    if (index->type == kIndexHash)
+    {
+      if (plan.prefix.size() != index->columns.size())
+        continue;
+    }
+    else if (plan.prefix.size() < index->columns.size())
+    {
+      const Predicate* range =
+          clause.find(index->column_pos[plan.prefix.size()], narrows);
+      if (range != nullptr)
+        plan.range = range->where.get();
+    }
+
+    plan.covering =
+        !read_columns.empty() &&
+        std::all_of(read_columns.begin(), read_columns.end(),
+                    [&](int column_pos) { return index->covers(column_pos); });
+
+    // Covering only breaks ties between equally selective indexes
+    size_t score = 4 * plan.prefix.size() + 2 * (plan.range != nullptr) +
+                   plan.covering;
+    if (score > best_score)
+    {
+      best = plan;
+      best_score = score;
+    }
+  }
+
+  return best;
+}
+
+// The zone map and Bloom filters of a table, which rule out row groups
+// together and are kept up to date together
+struct GroupFilter
+{
+  ZoneMap zone_map;
+  BloomFilter bloom;
+  std::vector<bool> zone_groups;
+  std::vector<bool> bloom_groups;
+
+  GroupFilter(Table const& table)
+      : zone_map(table.path, table.columns),
+        bloom(table.path, table.columns, table.bloom_columns)
+  {
+  }
+
+  // Returns 0 when every group may hold registers matching the clause
+  bool prune(WhereClause const& clause)
+  {
+    zone_groups = zone_map.candidates(clause);
+    bloom_groups = bloom.candidates(clause);
+    return !zone_groups.empty() || !bloom_groups.empty();
+  }
+
+  // Whether every register from first_id to last_id is ruled out
+  bool skips(int first_id, int last_id) const
+  {
+    auto ruled_out = [&](std::vector<bool> const& groups, auto const& synopsis)
+    {
+      if (groups.empty())
+        return 0;
+      for (size_t group = synopsis.group(first_id);
+           group <= (size_t)synopsis.group(last_id); group++)
+        if (group >= groups.size() || groups[group])
+          return 0;
+      return 1;
+    };
+    return ruled_out(zone_groups, zone_map) || ruled_out(bloom_groups, bloom);
+  }
+
+  bool skips(std::string const& filename) const
+  {
+    int reg_id = ZoneMap::registerId(filename);
+    return skips(reg_id, reg_id);
+  }
+
+  template <typename Row>
+  void add(int reg_id, Row const& row)
+  {
+    zone_map.add(reg_id, row);
+    bloom.add(reg_id, row);
+  }
+
+  bool save() { return zone_map.save() & bloom.save(); }
+};
+
+// Register files in the row groups that can't be ruled out. Returns 0 when
+// every group may hold matching registers
+bool groupFilenames(WhereClause const& clause,
+                    std::unique_ptr<Table> const& table,
+                    std::vector<std::string>& filenames)
+{
+  GroupFilter filter(*table);
+  if (!filter.prune(clause))
+    return 0;
+
+  for (auto& filename : table->registerFilenames())
+    if (!filter.skips(filename))
+      filenames.push_back(std::move(filename));
+  return 1;
+}
+
+// What a SELECT sees of a table: its registers as of the statement's
+// snapshot. The scan lets writers in every SCAN_BATCH_ROWS registers, and
+// registers changed by transactions the snapshot doesn't see are read from
+// the version it does. Changed registers the scan never reached, because
+// their stored values don't match anymore, are read at the end
+struct ReadView
+{
+  std::unique_ptr<Table> const& table;
+  TableLock& lock;
+  std::shared_ptr<const Snapshot> snapshot;
+  std::shared_ptr<VersionStore> versions;
+  uint64_t position;
+  bool unseen;
+  // Registers the scan already decided on, by id
+  std::vector<bool> reached;
+  RegisterData image;
+  std::vector<std::string_view> image_fields;
+  size_t rows = 0;
+
+  ReadView(std::unique_ptr<Table> const& table, TableLock& lock,
+           TxnId own = 0)
+      : table(table), lock(lock),
+        snapshot(Transactions::instance().snapshot(own)),
+        versions(VersionStore::get(table->name)),
+        position(versions->position()), unseen(versions->unseen(*snapshot)),
+        reached(std::max(table->reg_count, 0) + 1)
+  {
+    table->scans++;
+  }
+
+  ~ReadView() { table->scans--; }
+
+  // Whether any register may differ from what the snapshot sees
+  bool changed() const { return unseen || versions->position() != position; }
+
+  // Called before reading each register the scan reaches. Registers the
+  // snapshot sees an older version of are left in image_fields
+  Visibility check(int reg_id, const std::string* filename = nullptr)
+  {
+    if (++rows % SCAN_BATCH_ROWS == 0)
+      lock.yield();
+    if ((size_t)reg_id >= reached.size())
+      reached.resize(reg_id + 1);
+    reached[reg_id] = 1;
+    if (!changed())
+      return kVisibleStored;
+
+    Visibility visibility = versions->visible(
+        *snapshot,
+        filename != nullptr ? *filename : std::to_string(reg_id) + ".sqlito",
+        image);
+    if (visibility == kVisibleOlder)
+      image_fields.assign(image.begin(), image.end());
+    return visibility;
+  }
+
+  Visibility check(std::string const& filename)
+  {
+    return check(ZoneMap::registerId(filename), &filename);
+  }
+
+  template <typename Emit>
+  void finish(WhereClause const& clause, Emit const& emit)
+  {
+    if (!changed())
+      return;
+    for (const auto& filename : versions->changed(*snapshot))
+    {
+      size_t reg_id = ZoneMap::registerId(filename);
+      if (reg_id < reached.size() && reached[reg_id])
+        continue;
+      if (reg_id >= reached.size())
+        reached.resize(reg_id + 1);
+      reached[reg_id] = 1;
+
+      if (versions->visible(*snapshot, filename, image) != kVisibleOlder)
+        continue;
+      image_fields.assign(image.begin(), image.end());
+      if (clause.matches(image_fields))
+        emit(image_fields);
+    }
+  }
+};
+
+// A statement changing a table, in the transaction BEGIN opened or else in
+// one of its own. The table is owned before it is locked. While snapshots
+// are held, the registers it changes keep the version they had before.
+//
+// Inside BEGIN, registers and tombstones are kept in the table's pending
+// changes instead of being written, and everything done in memory or to an
+// index is logged to be undone
+struct TableWrite
+{
+  std::unique_ptr<Table> const& table;
+  std::unique_ptr<Transaction> statement;
+  Transaction& txn;
+  std::optional<TableLock> lock;
+  std::shared_ptr<VersionStore> versions;
+  TableChanges* changes = nullptr;
+
+  TableWrite(std::unique_ptr<Table> const& table, Transaction* txn)
+      : table(table),
+        statement(txn == nullptr ? std::make_unique<Transaction>() : nullptr),
+        txn(txn == nullptr ? *statement : *txn),
+        versions(VersionStore::get(table->name))
+  {
+    this->txn.own(table.get(), table->name);
+    lock.emplace(table->name, kLockExclusive);
+    if (!this->txn.versioned)
+      this->txn.versioned = Transactions::instance().reading();
+    versions->collect(Transactions::instance().horizon());
+    if (table->lingering && table->scans == 0)
+      table->purgeDeleted();
+
+    // The transaction reads and writes the table through its registers in
+    // memory, where its changes are
+    if (this->txn.buffered)
+    {
+      if (table->pending == nullptr)
+        table->pending = std::make_unique<TableChanges>();
+      changes = table->pending.get();
+      table->allRegisters();
+    }
+  }
+
+  // A statement's own transaction commits before the table is unlocked
+  ~TableWrite()
+  {
+    if (statement != nullptr)
+      statement->end();
+  }
+
+  void changing(std::string const& filename, const RegisterData* before)
+  {
+    if (txn.versioned)
+      versions->record(txn.id, filename, before);
+  }
+
+  void created(std::string const& filename, RegisterData const& reg_data)
+  {
+    changes->written[filename] = reg_data;
+    changes->inserted.insert(filename);
+    changes->undo.push_back({kUndoInsert, filename});
+  }
+
+  void updated(std::string const& filename, RegisterData const& old_data,
+               RegisterData const& reg_data)
+  {
+    changes->written[filename] = reg_data;
+    changes->undo.push_back({kUndoUpdate, filename, old_data});
+  }
+
+  void deleted(std::string const& filename, RegisterData const& reg_data)
+  {
+    changes->undo.push_back({kUndoDelete, filename, reg_data});
+    table->tombstones.insert(filename);
+    changes->written.erase(filename);
+    if (!changes->inserted.erase(filename))
+    {
+      changes->deleted.push_back(filename);
+      return;
+    }
+
+    // Registers never stored won't reach vacuum, so their entries go now
+    for (const auto& index : *table->indexes)
+      indexRemove(index, index->key(reg_data), filename,
+                  index->payload(reg_data));
+  }
+
+  void indexAdd(const Index* index, std::string const& key,
+                std::string const& filename, std::string const& payload)
+  {
+    index->add(key, filename, payload);
+    if (changes != nullptr)
+      changes->undo.push_back({kUndoIndexAdd, filename, {}, index, key});
+  }
+
+  void indexRemove(const Index* index, std::string const& key,
+                   std::string const& filename, std::string const& payload)
+  {
+    index->remove(key, filename);
+    if (changes != nullptr)
+      changes->undo.push_back(
+          {kUndoIndexRemove, filename, {}, index, key, payload});
+  }
+};
+
+// Loads only the given registers
+RegisterList loadRegisters(std::vector<std::string>& filenames,
+                           std::unique_ptr<Table> const& table)
+{
+  RegisterList regs;
+  std::string slot;
+  std::vector<std::string_view> reg_data;
+  for (auto& filename : filenames)
+  {
+    if (table->isDeleted(filename) ||
+        !table->readRegister(filename, slot, reg_data))
+      continue;
+    regs.push_back(
+        {std::move(filename), RegisterData(reg_data.begin(), reg_data.end())});
+  }
+  return regs;
+}
+}    // namespace
+
+RegisterList* Processor::candidate_registers(WhereClause const& clause,
+                                             std::unique_ptr<Table> const& table,
+                                             RegisterList& indexed_regs)
+{
+  if (table->registers != nullptr)
+    return table->registers.get();
+
+  IndexPlan plan = planIndex(clause, table);
+  std::vector<std::string> filenames;
+  if (plan.index != nullptr)
+    filenames = plan.index->lookup(plan.prefix, plan.range);
+  if (plan.index != nullptr || groupFilenames(clause, table, filenames))
+  {
+    indexed_regs = loadRegisters(filenames, table);
+    return &indexed_regs;
+  }
+
+  table->loadStoredRegisters();
+  return table->registers.get();
+}
+
 bool Processor::insert_record(const hsql::InsertStatement* stmt,
-                              std::unique_ptr<Table> const& table)
+                              std::unique_ptr<Table> const& table,
+                              Transaction* txn)
 {
+  TableWrite write(table, txn);
   if (table->registers == nullptr)
     table->loadStoredRegisters();
 
-  fs::path reg_file;
   std::string filename;
   RegisterData inserted_reg{};
 
@@ -25,11 +480,6 @@ bool Processor::insert_record(const hsql::InsertStatement* stmt,
     if (stmt->values->size() > table->columns->size())
       throw DBException{TOO_MANY_VALUES};
 
-    // Create filename
-    reg_file = ft::getNewRegPath(table->name);
-    filename = reg_file.filename();
-
-    std::ofstream new_reg(reg_file);
     std::vector<std::string> new_reg_data;
     for (size_t i = 0; i < stmt->values->size(); i++)
     {
@@ -40,110 +490,85 @@ bool Processor::insert_record(const hsql::InsertStatement* stmt,
         if (column->type.data_type == hsql::DataType::CHAR)
         {
           if (strlen(value->name) <= column->type.length)
-          {
             new_reg_data.push_back(value->name);
-            new_reg << value->name;
-          }
           else
-          {
-            new_reg.close();
-            remove(reg_file.c_str());
             throw DBException{CHAR_TOO_BIG, table->name, column->name};
-          }
         }
         else if (column->type.data_type == hsql::DataType::DATE)
         {
-          if (strlen(value->name) > 10)
-          {
-            new_reg.close();
-            remove(reg_file.c_str());
-            throw DBException{INVALID_DATE, table->name, value->name};
-          }
-
-          struct tm tm = {0};
-          if (strptime(value->name, DATE_FORMAT, &tm))
-          {
-            new_reg_data.push_back(value->name);
-            new_reg << value->name;
-          }
+          int32_t days;
+          if (dateToDays(value->name, days))
+            new_reg_data.push_back(std::to_string(days));
           else
-          {
-            new_reg.close();
-            remove(reg_file.c_str());
             throw DBException(INVALID_DATE, table->name, value->name);
-          }
         }
         else
-        {
-          new_reg.close();
-          remove(reg_file.c_str());
           throw DBException{INVALID_DATA_TYPE, table->name, column->name};
-        }
       }
       else if (value->type == hsql::kExprLiteralInt &&
                column->type.data_type == hsql::DataType::INT)
-      {
         new_reg_data.push_back(std::to_string(value->ival));
-        new_reg << value->ival;
-      }
       else
-      {
-        new_reg.close();
-        remove(reg_file.c_str());
         throw DBException{INVALID_DATA_TYPE, table->name, column->name};
-      }
-      new_reg << "\t";
     }
-    table->reg_count++;
-    table->registers->push_back({std::to_string(table->reg_count) + ".sqlito",
-                                 RegisterData(new_reg_data)});
-    inserted_reg = table->registers->back().second;
-    new_reg.close();
-  }
 
-  // Index new register
-  for (size_t i = 0; i < table->columns->size(); i++)
-  {
-    auto col = table->columns->at(i);
+    checkUnique(table, {&new_reg_data}, uniqueIndexes(table));
 
-    if (col->type.data_type == hsql::DataType::INT)
+    // Create filename
+    int reg_id = RegIdAllocator::get(table->name).allocate();
+    filename = std::to_string(reg_id) + ".sqlito";
+    write.changing(filename, nullptr);
+    if (write.changes != nullptr)
+      write.created(filename, new_reg_data);
+    else
     {
-      for (const auto& index : *table->indexes)
-      {
-        if (index->name == std::string(col->name))
-        {
-          std::string idx_folder = table->indexes_path + index->name + "/" +
-                                   inserted_reg.at(i) + "/";
-
-          mkdir(idx_folder.c_str(), S_IRWXU);
-
-          std::ofstream indexed_file(idx_folder + filename);
-          indexed_file.close();
-        }
-      }
+      if (!table->writeRegister(filename, new_reg_data))
+        throw DBException{UNWRITABLE_FILE, table->name,
+                          table->regs_path + filename};
+      GroupFilter filter(*table);
+      filter.add(reg_id, new_reg_data);
+      filter.save();
     }
+
+    table->reg_count = reg_id;
+    table->registers->push_back({filename, RegisterData(new_reg_data)});
+    inserted_reg = table->registers->back().second;
   }
 
-  std::cout << "Inserted 1 row.\n";
+  // Index new register
+  for (const auto& index : *table->indexes)
+    write.indexAdd(index, index->key(inserted_reg), filename,
+                   index->payload(inserted_reg));
+
+  if (write.changes == nullptr)
+  {
+    Catalog::instance().count(table->name, 1, 0);
+    ResultCache::instance().bump(table->name);
+  }
+  output::out() << "Inserted 1 row.\n";
   return 1;
 }
 
 bool Processor::show_records(const hsql::SelectStatement* stmt,
-                             std::unique_ptr<Table> const& table)
+                             std::unique_ptr<Table> const& table,
+                             Transaction* txn)
 {
-  if (table->registers == nullptr)
-    table->loadStoredRegisters();
+  // Other statements may read the table at the same time, and writers get
+  // in between batches of the scan
+  TableLock lock(table->name, kLockShared);
+  // A transaction reads the tables it changed from memory, where its
+  // uncommitted changes are. Neither storage nor the result cache has them
+  bool own = txn != nullptr && table->pending != nullptr &&
+             txn->tables.count(table->name);
 
   // Check WHERE clause correctness
-  int where_column_pos;
-  hsql::DataType column_data_type;
-  if (!valid_where(stmt->whereClause, &where_column_pos, &column_data_type,
-                   table))
+  WhereClause clause;
+  if (!clause.parse(stmt->whereClause, table))
     return 0;
-  auto where = Where::get(stmt->whereClause, column_data_type);
 
   std::set<std::string> tmp;
   std::vector<size_t> fields_width;
+  std::vector<hsql::DataType> fields_type;
   std::vector<int> requested_columns_order;
 
   if (stmt->selectList->size() == 1 &&
@@ -156,6 +581,7 @@ bool Processor::show_records(const hsql::SelectStatement* stmt,
       stmt->selectList->push_back(new hsql::Expr(hsql::kExprColumnRef));
       stmt->selectList->at(i)->name = table->columns->at(i)->name;
       fields_width.push_back(strlen(table->columns->at(i)->name) + 2);
+      fields_type.push_back(table->columns->at(i)->type.data_type);
       requested_columns_order.push_back(i);
     }
   }
@@ -185,6 +611,7 @@ bool Processor::show_records(const hsql::SelectStatement* stmt,
         {
           field_exists = 1;
           fields_width.push_back(strlen(col->name) + 2);
+          fields_type.push_back(col->type.data_type);
           requested_columns_order.push_back(&col - &table->columns->at(0));
           break;
         }
@@ -195,350 +622,845 @@ bool Processor::show_records(const hsql::SelectStatement* stmt,
     }
   }
 
-  if (stmt->whereClause != nullptr && table->indexes->size() > 0)
+  // Serve repeated SELECTs from the result cache without touching storage
+  auto& cache = ResultCache::instance();
+  std::string cache_key;
+  if (cache.enabled() && !own)
   {
-    for (const auto& index : *table->indexes)
+    cache_key = cache.key_for(stmt, table->name);
+    if (auto cached = cache.find(cache_key))
     {
-      if (index->name == std::string(stmt->whereClause->expr->name))
+      lock.unlock();
+      auto sink = ResultSink::make(stmt->selectList, fields_type,
+                                   cached->fields_width);
+      RowView row_view;
+      for (const auto& row : cached->regs_data)
       {
-        std::string indexed_data =
-            table->indexes_path + std::string(index->name) + "/" +
-            std::to_string(stmt->whereClause->expr2->ival);
-        if (ft::dirExists(indexed_data))
-        {
-          // COLLECT DATA FROM ALL REGS
-          std::vector<std::vector<std::string>> regs_data;
-          for (const auto& reg : fs::directory_iterator(indexed_data))
-          {
-            // Load data in file to reg_data
-            std::ifstream data_file(table->regs_path +
-                                    reg.path().filename().string());
-            std::vector<std::string> reg_data(stmt->selectList->size(), "");
-
-            // Load piece of data
-            std::string data;
-            for (size_t i = 0; i < table->columns->size(); i++)
-            {
-              getline(data_file, data, '\t');
-
-              // Find index of current field in the requested order
-              auto field_pos = std::find(requested_columns_order.begin(),
-                                         requested_columns_order.end(), i);
-
-              // If field was requested, add it to reg_data
-              if (field_pos != requested_columns_order.end())
-              {
-                auto current_req_field =
-                    std::distance(requested_columns_order.begin(), field_pos);
-                reg_data[current_req_field] = data;
-                // If data witdth is larger than current field_width,
-                // make it the new field_width
-                if (fields_width[current_req_field] < data.size() + 2)
-                  fields_width[current_req_field] = data.size() + 2;
-              }
-            }
-
-            regs_data.push_back(reg_data);
-          }
-
-          pu::print_select_result(stmt->selectList, &regs_data, &fields_width);
-          std::cout << "Returned " << regs_data.size()
-                    << " rows using indexed search.\n";
-          return 1;
-        }
+        row_view.assign(row.begin(), row.end());
+        sink->add_row(row_view);
       }
+      sink->finish();
+      output::out() << "Returned " << cached->regs_data.size() << " rows"
+                << (cached->indexed ? " using indexed search" : "")
+                << " from result cache.\n";
+      return 1;
     }
   }
 
-  // COLLECT DATA FROM ALL REGS
-  std::vector<std::vector<std::string>> regs_data;
-  for (const auto& [filename, reg_data] : *table->registers)
-  {
-    std::vector<std::string> requested_data(stmt->selectList->size(), "");
-    bool satisfies_where = 1;
-    for (size_t i = 0; i < table->columns->size(); i++)
+  // When streaming, widths must be known before the first row is printed
+  auto& settings = Settings::get();
+  if (settings.output_mode == OutputMode::STREAMING &&
+      settings.width_sample_rows == 0)
+    for (size_t i = 0; i < requested_columns_order.size(); i++)
     {
-      // Find index of current field in the requested order
-      auto field_pos = std::find(requested_columns_order.begin(),
-                                 requested_columns_order.end(), i);
-
-      std::string data = reg_data.at(i);
-      // When we reach desired column, set flag
-      if (i == where_column_pos && stmt->whereClause != nullptr)
-        if (!where->compare(data))
+      auto col = table->columns->at(requested_columns_order[i]);
+      fields_width[i] = std::max(fields_width[i], pu::column_width(col) + 2);
+    }
+
+  auto sink = ResultSink::make(stmt->selectList, fields_type, fields_width);
+
+  // Rows are views into the registers. They are only copied when retained
+  // for the result cache, and only while they could still fit in its budget.
+  // DATE values stay day numbers until here
+  std::vector<std::vector<std::string>> cached_rows;
+  size_t cached_bytes = 0;
+  bool has_dates = std::count(fields_type.begin(), fields_type.end(),
+                              hsql::DataType::DATE) > 0;
+  std::vector<std::string> dates(fields_type.size());
+  RowView output;
+  auto emit_row = [&](RowView const& stored) {
+    const RowView* row = &stored;
+    if (has_dates)
+    {
+      output = stored;
+      for (size_t i = 0; i < fields_type.size(); i++)
+        if (fields_type[i] == hsql::DataType::DATE)
         {
-          satisfies_where = 0;
-          break;
+          dates[i] = formatDate(stored[i]);
+          output[i] = dates[i];
         }
+      row = &output;
+    }
 
-      // If field was requested, add it to reg_data
-      if (field_pos != requested_columns_order.end())
+    sink->add_row(*row);
+    if (cache.enabled() && cached_bytes <= cache.budget())
+    {
+      for (const auto& data : *row)
+        cached_bytes += sizeof(std::string) + data.size();
+      cached_rows.emplace_back(row->begin(), row->end());
+    }
+  };
+
+  // Position of each table column in the result, or -1 if not requested
+  std::vector<int> result_pos(table->columns->size(), -1);
+  for (size_t i = 0; i < requested_columns_order.size(); i++)
+    result_pos[requested_columns_order[i]] = i;
+  RowView requested_data(stmt->selectList->size());
+  auto emit_register = [&](auto const& reg_data) {
+    for (size_t i = 0; i < reg_data.size(); i++)
+      if (result_pos[i] != -1)
+        requested_data[result_pos[i]] = reg_data[i];
+    emit_row(requested_data);
+  };
+
+  // Columns the statement reads, either to return or to filter them
+  std::vector<int> read_columns = requested_columns_order;
+  for (const auto& predicate : clause.predicates)
+    read_columns.push_back(predicate.column_pos);
+
+  // Registers are read as of the statement's snapshot, letting writers in
+  // between batches
+  ReadView view(table, lock, own ? txn->id : 0);
+  auto finish = [&](const char* how, bool indexed) {
+    view.finish(clause, emit_register);
+    sink->finish();
+    output::out() << "Returned " << sink->rows() << how;
+    if (cache.enabled() && !own && !view.changed())
+      cache.store(cache_key, table->name,
+                  CachedResult{std::move(cached_rows), sink->widths(),
+                               indexed});
+    return 1;
+  };
+
+  IndexPlan plan = own ? IndexPlan() : planIndex(clause, table, read_columns);
+  if (plan.index != nullptr && plan.covering)
+  {
+    // COLLECT DATA FROM THE INDEX ONLY. Its entries hold every column read,
+    // so no register file is opened
+    std::vector<int> value_pos = plan.index->column_pos;
+    value_pos.insert(value_pos.end(), plan.index->include_pos.begin(),
+                     plan.index->include_pos.end());
+    std::vector<std::string_view> reg_data(table->columns->size());
+    for (const auto& entry : plan.index->scan(plan.prefix, plan.range))
+    {
+      Visibility visibility = view.check(entry.filename);
+      if (visibility == kVisibleNone ||
+          (visibility == kVisibleStored && table->isDeleted(entry.filename)))
+        continue;
+      if (visibility == kVisibleOlder)
       {
-        auto current_req_field =
-            std::distance(requested_columns_order.begin(), field_pos);
-        requested_data[current_req_field] = data;
-        // If data witdth is larger than current field_width,
-        // make it the new field_width
-        if (fields_width[current_req_field] < data.size() + 2)
-          fields_width[current_req_field] = data.size() + 2;
+        if (clause.matches(view.image_fields))
+          emit_register(view.image_fields);
+        continue;
       }
+
+      for (size_t i = 0; i < entry.values.size() && i < value_pos.size(); i++)
+        reg_data[value_pos[i]] = entry.values[i];
+      if (clause.matches(reg_data))
+        emit_register(reg_data);
     }
 
-    if (satisfies_where)
-      regs_data.push_back(requested_data);
+    return finish(" rows using index-only search.\n", 1);
   }
 
-  pu::print_select_result(stmt->selectList, &regs_data, &fields_width);
-  std::cout << "Returned " << regs_data.size() << " rows.\n";
-  return 1;
-}
-
-bool Processor::update_records(const hsql::UpdateStatement* stmt,
-                               std::unique_ptr<Table> const& table)
-{
-  if (table->registers == nullptr)
-    table->loadStoredRegisters();
-
-  // Check WHERE clause correctness
-  int where_column_pos;
-  hsql::DataType column_data_type;
-  if (!valid_where(stmt->where, &where_column_pos, &column_data_type, table))
-    return 0;
-  auto where = Where::get(stmt->where, column_data_type);
-
-  // Check UPDATE SET column exists
-  bool column_exists = 0;
-  int update_column_pos;
-  hsql::ColumnDefinition* update_column;
-  for (const auto& col : *table->columns)
-    if (strcmp(col->name, stmt->updates->at(0)->column) == 0)
+  // Without an index, registers not loaded yet are only read from the row
+  // groups the zone map can't rule out
+  RegisterList* registers = table->loadedRegisters();
+  std::vector<std::string> filenames;
+  if (plan.index != nullptr)
+    filenames = plan.index->lookup(plan.prefix, plan.range);
+  if (plan.index != nullptr ||
+      (registers == nullptr && groupFilenames(clause, table, filenames)))
+  {
+    // COLLECT DATA FROM INDEXED REGS. Every register file is read into the
+    // same buffer and handed out as views. The index or zone map only
+    // narrows the search, so the whole clause is still checked
+    std::string slot;
+    std::vector<std::string_view> reg_data;
+    for (const auto& filename : filenames)
     {
-      column_exists = 1;
-      update_column = col;
-      update_column_pos = &col - &table->columns->at(0);
+      Visibility visibility = view.check(filename);
+      if (visibility == kVisibleNone)
+        continue;
+      if (visibility == kVisibleOlder)
+      {
+        if (clause.matches(view.image_fields))
+          emit_register(view.image_fields);
+        continue;
+      }
+
+      if (table->isDeleted(filename) ||
+          !table->readRegister(filename, slot, reg_data))
+        continue;
+      if (clause.matches(reg_data))
+        emit_register(reg_data);
     }
 
-  if (!column_exists)
-    throw DBException{COLUMN_NOT_IN_TABLE, table->name,
-                      stmt->updates->at(0)->column};
+    bool indexed = plan.index != nullptr;
+    return finish(indexed ? " rows using indexed search.\n" : " rows.\n",
+                  indexed);
+  }
 
-  // Check assign value is correct
-  if (((update_column->type.data_type == hsql::DataType::CHAR ||
-        update_column->type.data_type == hsql::DataType::DATE) &&
-       stmt->updates->at(0)->value->type != hsql::kExprLiteralString) ||
-      (update_column->type.data_type == hsql::DataType::INT &&
-       stmt->updates->at(0)->value->type != hsql::kExprLiteralInt))
-    throw DBException{INVALID_DATA_TYPE, table->name,
-                      stmt->updates->at(0)->column};
+  // Columnar tables not loaded yet only read the columns the statement uses,
+  // from the row groups that can't be ruled out
+  if (registers == nullptr && table->column_store != nullptr)
+  {
+    std::vector<bool> needed(table->columns->size());
+    for (size_t i = 0; i < needed.size(); i++)
+      needed[i] = result_pos[i] != -1;
+    for (const auto& predicate : clause.predicates)
+      needed[predicate.column_pos] = 1;
+
+    GroupFilter filter(*table);
+    bool pruned = filter.prune(clause);
+    table->column_store->scan(
+        needed, &clause,
+        [&](int first_id, int last_id)
+        { return pruned && filter.skips(first_id, last_id); },
+        [&](int reg_id, std::vector<std::string_view> const& reg_data)
+        {
+          Visibility visibility = view.check(reg_id);
+          if (visibility == kVisibleOlder)
+          {
+            if (clause.matches(view.image_fields))
+              emit_register(view.image_fields);
+            return;
+          }
+          if (visibility == kVisibleNone ||
+              (!table->tombstones.empty() &&
+               table->isDeleted(std::to_string(reg_id) + ".sqlito")) ||
+              !clause.matches(reg_data))
+            return;
 
-  Index* updated_index = nullptr;
-  for (const auto& index : *table->indexes)
-    if (index->name == std::string(update_column->name))
-      updated_index = index;
+          emit_register(reg_data);
+        });
 
-  std::vector<std::string> regs_to_update_filename;
-  std::vector<std::vector<std::string>> regs_data;
+    return finish(" rows.\n", 0);
+  }
 
-  for (auto& [filename, reg_data] : *table->registers)
+  // Registers already in memory are skipped by row group too. Nodes deleted
+  // while the scan runs stay in the list until it is done
+  GroupFilter filter(*table);
+  bool pruned = 0;
+  if (registers == nullptr)
+    registers = table->allRegisters();
+  else
+    pruned = !own && filter.prune(clause);
+
+  // COLLECT DATA FROM ALL REGS
+  for (const auto& [filename, reg_data] : *registers)
   {
-    if (where->compare(reg_data.at(where_column_pos)))
+    if (pruned && filter.skips(filename))
+      continue;
+    Visibility visibility = view.check(filename);
+    if (visibility == kVisibleOlder)
     {
-      regs_to_update_filename.push_back(filename);
-      std::string old_value = reg_data[update_column_pos];
-      if (stmt->updates->at(0)->value->type == hsql::kExprLiteralString)
-        reg_data[update_column_pos] = stmt->updates->at(0)->value->name;
-      else
-        reg_data[update_column_pos] =
-            std::to_string(stmt->updates->at(0)->value->ival);
+      if (clause.matches(view.image_fields))
+        emit_register(view.image_fields);
+      continue;
+    }
+    if (visibility == kVisibleNone || table->isDeleted(filename) ||
+        !clause.matches(reg_data))
+      continue;
+
+    emit_register(reg_data);
+  }
 
-      regs_data.push_back(reg_data);
+  return finish(" rows.\n", 0);
+}
 
-      if (updated_index != nullptr)
+bool Processor::update_records(const hsql::UpdateStatement* stmt,
+                               std::unique_ptr<Table> const& table,
+                               Transaction* txn)
+{
+  TableWrite write(table, txn);
+  // Check WHERE clause correctness
+  WhereClause clause;
+  if (!clause.parse(stmt->where, table))
+    return 0;
+
+  // Check every SET column exists and its value is valid before touching
+  // any register. A column assigned twice keeps its last value
+  struct Assignment
+  {
+    int column_pos;
+    std::string value;
+  };
+  std::vector<Assignment> assignments;
+  for (const auto* update : *stmt->updates)
+  {
+    hsql::ColumnDefinition* update_column = nullptr;
+    int update_column_pos;
+    for (const auto& col : *table->columns)
+      if (strcmp(col->name, update->column) == 0)
       {
-        // Remove old index
-        std::string idx_folder =
-            table->indexes_path + updated_index->name + "/" + old_value + "/";
-        std::string idx_path = idx_folder + filename;
-        remove(idx_path.c_str());
-        if (fs::is_empty(fs::path(idx_folder)))
-          remove(idx_folder.c_str());
-
-        // Add new index
-        std::string new_idx_folder = table->indexes_path + updated_index->name +
-                                     "/" + reg_data[update_column_pos] + "/";
-        mkdir(new_idx_folder.c_str(), S_IRWXU);
-
-        std::ofstream new_idx(new_idx_folder + filename);
-        new_idx.close();
+        update_column = col;
+        update_column_pos = &col - &table->columns->at(0);
       }
-    }
+
+    if (update_column == nullptr)
+      throw DBException{COLUMN_NOT_IN_TABLE, table->name, update->column};
+
+    if (((update_column->type.data_type == hsql::DataType::CHAR ||
+          update_column->type.data_type == hsql::DataType::DATE) &&
+         update->value->type != hsql::kExprLiteralString) ||
+        (update_column->type.data_type == hsql::DataType::INT &&
+         update->value->type != hsql::kExprLiteralInt))
+      throw DBException{INVALID_DATA_TYPE, table->name, update->column};
+
+    const hsql::Expr* value = update->value;
+    assignments.push_back(
+        {update_column_pos,
+         checkValue((value->type == hsql::kExprLiteralString)
+                        ? std::string(value->name)
+                        : std::to_string(value->ival),
+                    update_column, table)});
   }
 
-  for (const auto& filename : regs_to_update_filename)
-    remove((table->regs_path + filename).c_str());
+  // Indexes keeping any of the updated columns
+  std::vector<Index*> updated_indexes;
+  for (const auto& index : *table->indexes)
+    if (std::any_of(assignments.begin(), assignments.end(),
+                    [&](Assignment const& assignment) {
+                      return index->covers(assignment.column_pos);
+                    }))
+      updated_indexes.push_back(index);
+
+  // Registers are changed in memory and journaled first. Their slots are
+  // only overwritten once the journal is safely on disk
+  Journal journal(table->path, table->regs_path);
+  std::vector<std::pair<const std::string*, const RegisterData*>> updated_regs;
+
+  RegisterList indexed_regs;
+  std::vector<std::pair<const std::string*, RegisterData*>> matched_regs;
+  for (auto& [filename, reg_data] :
+       *candidate_registers(clause, table, indexed_regs))
+    if (!table->isDeleted(filename) && clause.matches(reg_data))
+      matched_regs.push_back({&filename, &reg_data});
+
+  // Changed keys of unique indexes are checked before any register changes
+  std::vector<const Index*> unique_indexes;
+  for (const auto& index : uniqueIndexes(table))
+    if (std::count(updated_indexes.begin(), updated_indexes.end(), index) > 0)
+      unique_indexes.push_back(index);
+  if (!unique_indexes.empty())
+  {
+    std::vector<RegisterData> new_data;
+    std::unordered_set<std::string> replaced;
+    for (const auto& [filename, reg_data] : matched_regs)
+    {
+      new_data.push_back(*reg_data);
+      for (const auto& assignment : assignments)
+        new_data.back()[assignment.column_pos] = assignment.value;
+      replaced.insert(*filename);
+    }
+
+    std::vector<const RegisterData*> new_rows;
+    for (const auto& row : new_data)
+      new_rows.push_back(&row);
+    checkUnique(table, new_rows, unique_indexes, replaced);
+  }
 
-  // Reinsert regs with updated values
-  for (const auto& reg : regs_data)
+  for (auto& [filename_ptr, reg_data_ptr] : matched_regs)
   {
-    // Create filename
-    std::string reg_file =
-        table->regs_path + regs_to_update_filename[&reg - &regs_data[0]];
+    const std::string& filename = *filename_ptr;
+    RegisterData& reg_data = *reg_data_ptr;
+    RegisterData old_data = reg_data;
+    write.changing(filename, &old_data);
+    for (const auto& assignment : assignments)
+      reg_data[assignment.column_pos] = assignment.value;
+    if (write.changes != nullptr)
+      write.updated(filename, old_data, reg_data);
+    else
+      journal.log_update(filename, table->formatRegister(old_data),
+                         table->formatRegister(reg_data));
+    updated_regs.push_back({&filename, &reg_data});
 
-    std::ofstream updated_reg(reg_file);
-    for (const auto& data : reg)
-      updated_reg << data << "\t";
-    updated_reg.close();
+    // Only touch the index entries whose key or included values changed
+    for (const auto& index : updated_indexes)
+    {
+      std::string old_key = index->key(old_data);
+      std::string new_key = index->key(reg_data);
+      std::string new_payload = index->payload(reg_data);
+      if (old_key != new_key)
+        write.indexRemove(index, old_key, filename, index->payload(old_data));
+      else if (index->payload(old_data) == new_payload)
+        continue;
+
+      write.indexAdd(index, new_key, filename, new_payload);
+    }
+  }
+
+  if (!updated_regs.empty() && write.changes == nullptr)
+  {
+    // Row groups take the new values before any of them reaches a register
+    GroupFilter filter(*table);
+    for (const auto& [filename, reg_data] : updated_regs)
+      filter.add(ZoneMap::registerId(*filename), *reg_data);
+    filter.save();
+
+    // The journal stays to be replayed unless every slot made it to disk
+    if (!journal.commit())
+      throw DBException{UNWRITABLE_FILE, table->name,
+                        table->path + "journal.dat"};
+    if (!table->writeRegisters(updated_regs, 1))
+      throw DBException{UNWRITABLE_FILE, table->name, table->regs_path};
+    journal.clear();
   }
 
-  std::cout << "Updated " << regs_to_update_filename.size() << " rows.\n";
+  if (write.changes == nullptr)
+    ResultCache::instance().bump(table->name);
+  output::out() << "Updated " << updated_regs.size() << " rows.\n";
   return 1;
 }
-// TODO: ONLY ALLOW 1 COLUMN TO BE AFFECTED AT THE TIME BY UPDATE
 
 bool Processor::delete_records(const hsql::DeleteStatement* stmt,
-                               std::unique_ptr<Table> const& table)
+                               std::unique_ptr<Table> const& table,
+                               Transaction* txn)
 {
-  if (table->registers == nullptr)
-    table->loadStoredRegisters();
-
+  TableWrite write(table, txn);
   // Check WHERE clause correctness
-  int where_column_pos;
-  hsql::DataType column_data_type;
-  if (!valid_where(stmt->expr, &where_column_pos, &column_data_type, table))
+  WhereClause clause;
+  if (!clause.parse(stmt->expr, table))
     return 0;
-  auto where = Where::get(stmt->expr, column_data_type);
 
+  // Matching registers are only tombstoned, in a single append. Their
+  // files and index entries are reclaimed by vacuum
+  RegisterList indexed_regs;
+  RegisterList* regs = candidate_registers(clause, table, indexed_regs);
   std::vector<std::string> regs_to_delete_filename;
-
-  for (auto it = table->registers->begin(); it != table->registers->end();)
-  {
-    auto filename = it->first;
-    auto reg_data = it->second;
-    if (where->compare(reg_data[where_column_pos]))
+  std::vector<RegisterList::iterator> regs_to_delete;
+  for (auto it = regs->begin(); it != regs->end(); ++it)
+    if (!table->isDeleted(it->first) && clause.matches(it->second))
     {
-      regs_to_delete_filename.push_back(filename);
-      for (const auto& index : *table->indexes)
-      {
-        for (size_t i = 0; i < table->columns->size(); i++)
-        {
-          const auto col = table->columns->at(i);
-          if (index->name == std::string(col->name))
-          {
-            std::string indexed_reg_folder =
-                table->indexes_path + index->name + "/" + reg_data[i] + "/";
-
-            std::string indexed_reg_path = indexed_reg_folder + filename;
-
-            remove(indexed_reg_path.c_str());
-            if (fs::is_empty(fs::path(indexed_reg_folder)))
-              remove(indexed_reg_folder.c_str());
-          }
-        }
-      }
-      it = table->registers->erase(it);
+      regs_to_delete_filename.push_back(it->first);
+      regs_to_delete.push_back(it);
+      write.changing(it->first, &it->second);
     }
-    else
-      ++it;
-  }
 
-  for (const auto& filename : regs_to_delete_filename)
-    remove((table->regs_path + filename).c_str());
-
-  std::cout << "Deleted " << regs_to_delete_filename.size() << " rows.\n";
+  if (write.changes != nullptr)
+    for (const auto& it : regs_to_delete)
+      write.deleted(it->first, it->second);
+  else if (!table->markDeleted(regs_to_delete_filename))
+    throw DBException{UNWRITABLE_FILE, table->name, table->tombstones_path};
+
+  // Scans walking the registers in memory skip tombstoned ones, and the
+  // nodes are dropped once none is running
+  if (regs != table->registers.get() || table->scans == 0)
+    for (const auto& it : regs_to_delete)
+      regs->erase(it);
+  else if (!regs_to_delete.empty())
+    table->lingering = 1;
+
+  if (write.changes == nullptr)
+  {
+    Vacuum::instance().schedule(table->name);
+    ResultCache::instance().bump(table->name);
+  }
+  output::out() << "Deleted " << regs_to_delete_filename.size()
+                << " rows.\n";
   return 1;
 }
 
 bool Processor::drop_table(std::unique_ptr<Table> const& table)
 {
+  Transaction statement;
+  statement.own(table.get(), table->name);
+  TableLock lock(table->name, kLockExclusive);
   std::error_code errorCode;
   if (!fs::remove_all(table->path, errorCode))
   {
-    std::cout << errorCode.message() << "\n";
+    output::out() << errorCode.message() << "\n";
     return 0;
   }
 
-  std::cout << "Dropped table " << table->name << ".\n";
+  RegIdAllocator::forget(table->name);
+  VersionStore::forget(table->name);
+  Catalog::instance().remove(table->name);
+  ResultCache::instance().bump(table->name);
+  output::out() << "Dropped table " << table->name << ".\n";
   return 1;
 }
 
-bool Processor::create_index(std::string column,
-                             std::unique_ptr<Table> const& table)
+bool Processor::create_index(std::vector<std::string> const& columns,
+                             std::unique_ptr<Table> const& table,
+                             IndexType type,
+                             std::vector<std::string> const& include)
 {
+  Transaction statement;
+  statement.own(table.get(), table->name);
+  TableLock lock(table->name, kLockExclusive);
   if (table->registers == nullptr)
     table->loadStoredRegisters();
 
-  // Check that the column actually exists in the table
-  int column_pos;
-  bool field_exists = 0;
-  for (auto& col : *table->columns)
+  // Check that every column actually exists in the table, only once
+  std::vector<std::string> all_columns = columns;
+  all_columns.insert(all_columns.end(), include.begin(), include.end());
+  std::vector<int> column_pos;
+  for (const auto& column : all_columns)
   {
-    if (strcmp(column.c_str(), col->name) == 0)    // If strings are equal
+    bool field_exists = 0;
+    for (auto& col : *table->columns)
     {
-      field_exists = 1;
-      column_pos = &col - &table->columns->at(0);
-      break;
+      if (strcmp(column.c_str(), col->name) == 0)    // If strings are equal
+      {
+        field_exists = 1;
+        column_pos.push_back(&col - &table->columns->at(0));
+        break;
+      }
     }
-  }
 
-  if (!field_exists)
-    throw DBException{COLUMN_NOT_IN_TABLE, table->name, column};
+    if (!field_exists)
+      throw DBException{COLUMN_NOT_IN_TABLE, table->name, column};
+    if (std::count(all_columns.begin(), all_columns.end(), column) > 1)
+      throw DBException(REPEATED_FIELDS);
+  }
+  std::vector<int> include_pos(column_pos.begin() + columns.size(),
+                               column_pos.end());
+  column_pos.resize(columns.size());
 
+  std::string name = Index::nameFor(columns, include);
   for (const auto index : *table->indexes)
   {
-    if (index->name == column)
-      throw DBException{INDEX_ALREADY_EXISTS, table->name, column};
+    if (index->name == name)
+      throw DBException{INDEX_ALREADY_EXISTS, table->name, name};
   }
 
-  if (table->columns->at(column_pos)->type.data_type != hsql::DataType::INT)
-    throw DBException{INDEX_NOT_INT};
+  // Key values become folder names, which CHAR values can't safely be.
+  // Included values are stored inside the files, so they can be of any type
+  for (const auto& pos : column_pos)
+  {
+    hsql::DataType data_type = table->columns->at(pos)->type.data_type;
+    if (type == kIndexHash && data_type != hsql::DataType::INT)
+      throw DBException{INDEX_NOT_INT};
+    if (data_type != hsql::DataType::INT && data_type != hsql::DataType::DATE)
+      throw DBException{INDEX_INVALID_TYPE};
+  }
+  if (type == kIndexHash && columns.size() > 1)
+    throw DBException{HASH_INDEX_MULTI_COLUMN};
+  if (type == kIndexHash && !include.empty())
+    throw DBException{HASH_INDEX_INCLUDE};
+
+  auto index = new Index(name, table->indexes_path + name + "/", columns,
+                         column_pos, type, include, include_pos);
+  table->indexes->push_back(index);
+
+  // A single sequential pass over the registers collects every entry
+  std::vector<const std::vector<std::string>*> rows;
+  std::vector<const std::string*> filenames;
+  rows.reserve(table->registers->size());
+  filenames.reserve(table->registers->size());
+  for (const auto& [filename, reg_data] : *table->registers)
+  {
+    if (table->isDeleted(filename))
+      continue;
+    rows.push_back(&reg_data);
+    filenames.push_back(&filename);
+  }
+
+  ft::createFolder(index->path);
+  index->bulk_add(rows, filenames);
+  table->writeCatalog();
 
-  table->indexes->push_back(new Index(column));
+  output::out() << "Index " << name << " was created successfully on table "
+                << table->name << ".\n";
 
-  // TODO: add support for other datatypes
-  // Create tree
-  std::map<int, std::vector<std::string>> index_tree;
+  return 0;
+}
 
-  // LOAD ALL REGS
-  for (const auto& reg : fs::directory_iterator(table->regs_path))
+bool Processor::create_bloom_filter(std::vector<std::string> const& columns,
+                                    std::unique_ptr<Table> const& table,
+                                    double false_positive_rate)
+{
+  Transaction statement;
+  statement.own(table.get(), table->name);
+  TableLock lock(table->name, kLockExclusive);
+  if (table->registers == nullptr)
+    table->loadStoredRegisters();
+
+  // New columns join the ones already filtered
+  std::vector<std::string> bloom_columns = table->bloom_columns;
+  for (const auto& column : columns)
   {
-    // Load data in file to reg_data
-    std::ifstream data_file(reg.path());
+    auto col = std::find_if(
+        table->columns->begin(), table->columns->end(),
+        [&](hsql::ColumnDefinition* col) { return column == col->name; });
+    if (col == table->columns->end())
+      throw DBException{COLUMN_NOT_IN_TABLE, table->name, column};
+    if (std::count(columns.begin(), columns.end(), column) > 1)
+      throw DBException(REPEATED_FIELDS);
+    if (std::find(bloom_columns.begin(), bloom_columns.end(), column) ==
+        bloom_columns.end())
+      bloom_columns.push_back(column);
+  }
 
-    // Load each piece of data into reg_data
-    std::string data;
-    for (int i = 0; i < column_pos + 1; i++)
-      getline(data_file, data, '\t');
+  table->bloom_columns = bloom_columns;
+  table->bloom_fpr = false_positive_rate;
+  table->writeMetadata();
 
-    // If the key is already in the map, then add current reg's path to the
-    // vector
-    // Else, insert the key in the map and add current reg's path to the
-    // vector
-    int val = stoi(data);
-    auto elem = index_tree.find(val);
-    if (elem != index_tree.end())
-      elem->second.push_back(reg.path().filename().string());
-    else
-      index_tree.insert(std::pair<int, std::vector<std::string>>(
-          val, std::vector<std::string>(1, reg.path().filename().string())));
+  // Every filter is rebuilt from the registers, sized for the new rate
+  BloomFilter::create(table->path, Settings::get().zone_group_rows,
+                      false_positive_rate, bloom_columns.size());
+  BloomFilter bloom(table->path, table->columns, bloom_columns);
+  for (const auto& [filename, reg_data] : *table->registers)
+    if (!table->isDeleted(filename))
+      bloom.add(ZoneMap::registerId(filename), reg_data);
+  if (!bloom.save())
+    throw DBException{UNWRITABLE_FILE, table->name,
+                      table->path + "bloom.dat"};
+
+  output::out() << "Bloom filter on " << Index::nameFor(bloom_columns)
+                << " was created successfully on table " << table->name
+                << ".\n";
+  return 1;
+}
+
+// Splits a line of a COPY file. Fields may be wrapped in double quotes, in
+// which case delimiters inside them are kept and "" stands for a quote.
+static RegisterData splitCopyLine(std::string const& line, char delimiter)
+{
+  RegisterData fields(1);
+  bool quoted = 0;
+  for (size_t i = 0; i < line.size(); i++)
+  {
+    char c = line[i];
+    if (quoted)
+    {
+      if (c == '"' && i + 1 < line.size() && line[i + 1] == '"')
+        fields.back() += line[++i];
+      else if (c == '"')
+        quoted = 0;
+      else
+        fields.back() += c;
+    }
+    else if (c == '"' && fields.back().empty())
+      quoted = 1;
+    else if (c == delimiter)
+      fields.emplace_back();
+    else if (c != '\r')
+      fields.back() += c;
   }
 
-  std::string idx_path = table->indexes_path + column + "/";
-  ft::createFolder(idx_path.c_str());
+  return fields;
+}
 
-  for (const auto& idx : index_tree)
+bool Processor::copy_records(const Command* stmt,
+                             std::unique_ptr<Table> const& table,
+                             Transaction* txn)
+{
+  TableWrite write(table, txn);
+  if (table->registers == nullptr)
+    table->loadStoredRegisters();
+
+  std::ifstream data_file(stmt->file_path);
+  if (!data_file.is_open())
+    throw DBException{UNREADABLE_FILE, table->name, stmt->file_path};
+
+  // Parse and validate the whole file before anything is written, so a bad
+  // line leaves the table untouched
+  std::vector<RegisterData> new_regs;
+  std::string line;
+  size_t line_number = 0;
+  if (stmt->header)
+  {
+    getline(data_file, line);
+    line_number++;
+  }
+
+  while (getline(data_file, line))
   {
-    std::string idx_val_path = idx_path + std::to_string(idx.first) + "/";
-    ft::createFolder(idx_val_path.c_str());
+    line_number++;
+    if (line.empty() || line == "\r")
+      continue;
 
-    for (const auto& filename : idx.second)
+    RegisterData reg_data = splitCopyLine(line, stmt->delimiter);
+    try
     {
-      std::ofstream file(idx_val_path + filename);
-      file.close();
+      if (reg_data.size() < table->columns->size())
+        throw DBException{MISSING_VALUES};
+      if (reg_data.size() > table->columns->size())
+        throw DBException{TOO_MANY_VALUES};
+
+      for (size_t i = 0; i < reg_data.size(); i++)
+        reg_data[i] = checkValue(reg_data[i], table->columns->at(i), table);
+    }
+    catch (const DBException& e)
+    {
+      output::err() << "ERROR: Couldn't copy line " << line_number << " of "
+                    << stmt->file_path << ".\n";
+      throw;
     }
+
+    new_regs.push_back(std::move(reg_data));
   }
 
-  std::cout << "Index " << column << " was created successfully on table "
-            << table->name << ".\n";
+  if (new_regs.empty())
+  {
+    output::out() << "Copied 0 rows.\n";
+    return 1;
+  }
 
-  return 0;
+  std::vector<const RegisterData*> new_rows;
+  for (const auto& reg_data : new_regs)
+    new_rows.push_back(&reg_data);
+  checkUnique(table, new_rows, uniqueIndexes(table));
+
+  // Allocate every register id in one step
+  int first_id = RegIdAllocator::get(table->name).allocate(new_regs.size());
+
+  std::vector<const std::vector<std::string>*> rows;
+  std::vector<const std::string*> filenames;
+  std::vector<std::pair<const std::string*, const RegisterData*>> written;
+  GroupFilter filter(*table);
+  for (size_t n = 0; n < new_regs.size(); n++)
+  {
+    filter.add(first_id + n, new_regs[n]);
+    table->registers->push_back(
+        {std::to_string(first_id + n) + ".sqlito", std::move(new_regs[n])});
+    write.changing(table->registers->back().first, nullptr);
+    rows.push_back(&table->registers->back().second);
+    filenames.push_back(&table->registers->back().first);
+    written.push_back({filenames.back(), rows.back()});
+    if (write.changes != nullptr)
+      write.created(*filenames.back(), *rows.back());
+  }
+  table->reg_count = first_id + new_regs.size() - 1;
+  if (write.changes == nullptr)
+  {
+    if (!table->writeRegisters(written))
+    {
+      // Neither indexes nor readers get to see them
+      table->registers->resize(table->registers->size() - written.size());
+      throw DBException{UNWRITABLE_FILE, table->name, table->regs_path};
+    }
+    filter.save();
+  }
+
+  // Indexes are brought up to date once, after every register is written
+  for (const auto& index : *table->indexes)
+  {
+    index->bulk_add(rows, filenames);
+    if (write.changes != nullptr)
+      for (size_t n = 0; n < rows.size(); n++)
+        write.changes->undo.push_back({kUndoIndexAdd, *filenames[n], {},
+                                       index, index->key(*rows[n])});
+  }
+
+  if (write.changes == nullptr)
+  {
+    Catalog::instance().count(table->name, new_regs.size(), 0);
+    ResultCache::instance().bump(table->name);
+  }
+  output::out() << "Copied " << new_regs.size() << " rows.\n";
+  return 1;
+}
+
+// Reverts what a transaction did to a table in memory and to its indexes,
+// newest change first. Nothing it wrote reached the registers
+static void undoChanges(Table& table, TableChanges const& changes)
+{
+  RegisterList& registers = *table.registers;
+  std::unordered_map<std::string, RegisterList::iterator> nodes;
+  for (auto it = registers.begin(); it != registers.end(); ++it)
+    nodes[it->first] = it;
+
+  for (auto undo = changes.undo.rbegin(); undo != changes.undo.rend(); ++undo)
+  {
+    auto node = nodes.find(undo->filename);
+    switch (undo->type)
+    {
+    case kUndoInsert:
+      if (node == nodes.end())
+        break;
+      // Scans walking the registers drop it once they are done
+      if (table.scans > 0)
+      {
+        table.tombstones.insert(undo->filename);
+        table.lingering = 1;
+        break;
+      }
+      registers.erase(node->second);
+      nodes.erase(node);
+      break;
+    case kUndoUpdate:
+      if (node != nodes.end())
+        node->second->second = undo->data;
+      break;
+    case kUndoDelete:
+      table.tombstones.erase(undo->filename);
+      if (node == nodes.end())
+      {
+        registers.push_back({undo->filename, undo->data});
+        nodes[undo->filename] = std::prev(registers.end());
+      }
+      break;
+    case kUndoIndexAdd:
+      undo->index->remove(undo->key, undo->filename);
+      break;
+    case kUndoIndexRemove:
+      undo->index->add(undo->key, undo->filename, undo->payload);
+      break;
+    }
+  }
+}
+
+bool Processor::commit(Transaction& txn)
+{
+  std::vector<std::pair<std::string, LockMode>> names;
+  for (const auto& [name, table] : txn.tables)
+    names.push_back({name, kLockExclusive});
+  TableLock lock(names);
+
+  for (const auto& [name, table] : txn.tables)
+  {
+    TableChanges* changes = table->pending.get();
+    if (changes == nullptr)
+      continue;
+
+    // Everything the transaction wrote to the table is journaled and synced
+    // at once, so the COMMIT holds whatever happens next. The journal is
+    // only removed once the registers and tombstones are synced too; if
+    // they can't be, it stays to be replayed when the table is next opened
+    Journal journal(table->path, table->regs_path);
+    std::vector<std::pair<const std::string*, const RegisterData*>> written;
+    GroupFilter filter(*table);
+    for (const auto& [filename, reg_data] : changes->written)
+    {
+      journal.log_update(filename, "", table->formatRegister(reg_data));
+      written.push_back({&filename, &reg_data});
+      filter.add(ZoneMap::registerId(filename), reg_data);
+    }
+    for (const auto& filename : changes->deleted)
+      journal.log_delete(filename);
+
+    filter.save();
+    if (!journal.commit())
+      throw DBException{UNWRITABLE_FILE, name, table->path + "journal.dat"};
+    if (table->writeRegisters(written, 1) &&
+        table->writeTombstones(changes->deleted) && ft::syncDir(table->path))
+      journal.clear();
+
+    int64_t deleted = changes->deleted.size();
+    Catalog::instance().count(name, changes->inserted.size() - deleted,
+                              deleted);
+    if (deleted > 0)
+      Vacuum::instance().schedule(name);
+    ResultCache::instance().bump(name);
+    table->pending.reset();
+  }
+
+  txn.end();
+  output::out() << "Committed transaction.\n";
+  return 1;
+}
+
+bool Processor::rollback(Transaction& txn)
+{
+  std::vector<std::pair<std::string, LockMode>> names;
+  for (const auto& [name, table] : txn.tables)
+    names.push_back({name, kLockExclusive});
+  TableLock lock(names);
+
+  for (const auto& [name, table] : txn.tables)
+  {
+    if (table->pending == nullptr)
+      continue;
+    undoChanges(*table, *table->pending);
+    table->pending.reset();
+    VersionStore::get(name)->discard(txn.id);
+  }
+
+  txn.end();
+  output::out() << "Rolled back transaction.\n";
+  return 1;
 }
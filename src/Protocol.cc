@@ -0,0 +1,92 @@
+#include "Protocol.hh"
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace protocol
+{
+static uint32_t frameSize(const char* header)
+{
+  auto bytes = (const unsigned char*)header;
+  return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 |
+         uint32_t(bytes[2]) << 8 | uint32_t(bytes[3]);
+}
+
+std::string frame(std::string_view payload)
+{
+  uint32_t size = payload.size();
+  std::string framed = {char(size >> 24), char(size >> 16), char(size >> 8),
+                        char(size)};
+  framed.append(payload);
+  return framed;
+}
+
+void FrameReader::feed(const char* data, size_t size)
+{
+  // Drop the frames already taken before the buffer grows
+  if (this->start > 0 && this->start >= this->buffer.size() / 2)
+  {
+    this->buffer.erase(0, this->start);
+    this->start = 0;
+  }
+  this->buffer.append(data, size);
+}
+
+FrameStatus FrameReader::next(std::string& payload)
+{
+  if (this->buffer.size() - this->start < 4)
+    return kFrameIncomplete;
+
+  uint32_t size = frameSize(this->buffer.data() + this->start);
+  if (size > kMaxRequest)
+    return kFrameTooLarge;
+  if (this->buffer.size() - this->start - 4 < size)
+    return kFrameIncomplete;
+
+  payload.assign(this->buffer, this->start + 4, size);
+  this->start += 4 + size;
+  return kFrameReady;
+}
+
+bool sendFrame(int fd, std::string_view payload)
+{
+  std::string framed = frame(payload);
+  size_t sent = 0;
+  while (sent < framed.size())
+  {
+    ssize_t count =
+        send(fd, framed.data() + sent, framed.size() - sent, MSG_NOSIGNAL);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count <= 0)
+      return 0;
+    sent += count;
+  }
+  return 1;
+}
+
+// Reads exactly size bytes, so nothing of the next frame is consumed
+static bool receiveAll(int fd, char* data, size_t size)
+{
+  size_t received = 0;
+  while (received < size)
+  {
+    ssize_t count = recv(fd, data + received, size - received, 0);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count <= 0)
+      return 0;
+    received += count;
+  }
+  return 1;
+}
+
+bool receiveFrame(int fd, std::string& payload)
+{
+  char header[4];
+  if (!receiveAll(fd, header, 4))
+    return 0;
+  payload.resize(frameSize(header));
+  return receiveAll(fd, payload.data(), payload.size());
+}
+}    // namespace protocol
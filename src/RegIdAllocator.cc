@@ -0,0 +1,86 @@
+#include "RegIdAllocator.hh"
+#include "DBException.hh"
+#include "filestruct.hh"
+#include <algorithm>
+
+namespace ft = ftools;
+
+std::mutex RegIdAllocator::registry_mutex;
+
+RegIdAllocator::RegIdAllocator(std::string const& table_name)
+    : table_name(table_name)
+{
+  this->last_id = std::max(ft::getRegCount(table_name), 0);
+  this->reserved_until = this->last_id;
+}
+
+RegIdAllocator::~RegIdAllocator()
+{
+  checkpoint();
+}
+
+std::map<std::string, std::unique_ptr<RegIdAllocator>>&
+RegIdAllocator::registry()
+{
+  static std::map<std::string, std::unique_ptr<RegIdAllocator>> allocators;
+  return allocators;
+}
+
+RegIdAllocator& RegIdAllocator::get(std::string const& table_name)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto& allocator = registry()[table_name];
+  if (allocator == nullptr)
+    allocator.reset(new RegIdAllocator(table_name));
+  return *allocator;
+}
+
+void RegIdAllocator::forget(std::string const& table_name)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto it = registry().find(table_name);
+  if (it == registry().end())
+    return;
+
+  // The table's files may already be gone, so there is nothing to write back
+  it->second->reserved_until = it->second->last_id;
+  registry().erase(it);
+}
+
+int RegIdAllocator::allocate(int count)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  int first_id = last_id + 1;
+  last_id += count;
+
+  // Ids are only handed out once their reservation is on disk
+  if (last_id > reserved_until)
+  {
+    if (!ft::setRegCount(table_name, last_id + REG_ID_RESERVATION))
+    {
+      last_id -= count;
+      throw DBException{UNWRITABLE_FILE, table_name,
+                        ft::getRegCountPath(table_name)};
+    }
+    reserved_until = last_id + REG_ID_RESERVATION;
+  }
+
+  return first_id;
+}
+
+int RegIdAllocator::last()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return last_id;
+}
+
+void RegIdAllocator::checkpoint()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (reserved_until == last_id)
+    return;
+
+  // Keeps the reservation if the file can't be written
+  if (ft::setRegCount(table_name, last_id))
+    reserved_until = last_id;
+}
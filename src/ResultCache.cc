@@ -0,0 +1,170 @@
+#include "ResultCache.hh"
+
+ResultCache& ResultCache::instance()
+{
+  static ResultCache cache;
+  return cache;
+}
+
+void ResultCache::enable(size_t byte_budget)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  this->byte_budget = byte_budget;
+  while (bytes_used > this->byte_budget && !lru.empty())
+  {
+    evict(std::prev(lru.end()));
+    evictions++;
+  }
+}
+
+void ResultCache::disable()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  byte_budget = 0;
+  while (!lru.empty())
+    evict(lru.begin());
+}
+
+static std::string operatorToString(hsql::OperatorType op_type)
+{
+  switch (op_type)
+  {
+  case hsql::kOpEquals:
+    return "=";
+  case hsql::kOpNotEquals:
+    return "!=";
+  case hsql::kOpLess:
+    return "<";
+  case hsql::kOpLessEq:
+    return "<=";
+  case hsql::kOpGreater:
+    return ">";
+  case hsql::kOpGreaterEq:
+    return ">=";
+  case hsql::kOpAnd:
+    return " AND ";
+  default:
+    return "?";
+  }
+}
+
+// Normalized form of a WHERE clause, as col op literal joined by AND
+static std::string whereToString(const hsql::Expr* where)
+{
+  if (where->opType == hsql::kOpAnd)
+    return whereToString(where->expr) + operatorToString(where->opType) +
+           whereToString(where->expr2);
+
+  std::string condition =
+      std::string(where->expr->name) + operatorToString(where->opType);
+  if (where->expr2->type == hsql::kExprLiteralInt)
+    return condition + std::to_string(where->expr2->ival);
+  return condition + "'" + std::string(where->expr2->name) + "'";
+}
+
+std::string ResultCache::key_for(const hsql::SelectStatement* stmt,
+                                 std::string const& table_name)
+{
+  // Normalized form: SELECT a,b FROM t@version WHERE col op literal AND ...
+  std::string key = "SELECT ";
+  for (const auto& field : *stmt->selectList)
+  {
+    key += (field->type == hsql::kExprStar) ? "*" : field->name;
+    key += ",";
+  }
+  key += " FROM " + table_name + "@" + std::to_string(version(table_name));
+
+  if (stmt->whereClause != nullptr)
+    key += " WHERE " + whereToString(stmt->whereClause);
+
+  return key;
+}
+
+std::shared_ptr<const CachedResult> ResultCache::find(std::string const& key)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries_by_key.find(key);
+  if (it == entries_by_key.end())
+  {
+    misses++;
+    return nullptr;
+  }
+
+  hits++;
+  lru.splice(lru.begin(), lru, it->second);
+  return it->second->result;
+}
+
+void ResultCache::store(std::string const& key, std::string const& table_name,
+                        CachedResult result)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!enabled())
+    return;
+
+  result.bytes = key.size() + sizeof(Entry);
+  for (const auto& row : result.regs_data)
+  {
+    result.bytes += sizeof(row);
+    for (const auto& data : row)
+      result.bytes += sizeof(data) + data.size();
+  }
+
+  // Results bigger than the whole budget are never cached
+  if (result.bytes > byte_budget)
+    return;
+
+  auto it = entries_by_key.find(key);
+  if (it != entries_by_key.end())
+    evict(it->second);
+
+  while (bytes_used + result.bytes > byte_budget)
+  {
+    evict(std::prev(lru.end()));
+    evictions++;
+  }
+
+  bytes_used += result.bytes;
+  lru.push_front(Entry{key, table_name,
+                      std::make_shared<const CachedResult>(std::move(result))});
+  entries_by_key[key] = lru.begin();
+}
+
+void ResultCache::bump(std::string const& table_name)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  table_versions[table_name]++;
+
+  for (auto it = lru.begin(); it != lru.end();)
+  {
+    auto current = it++;
+    if (current->table_name == table_name)
+      evict(current);
+  }
+}
+
+unsigned long ResultCache::version(std::string const& table_name) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = table_versions.find(table_name);
+  return (it == table_versions.end()) ? 0 : it->second;
+}
+
+size_t ResultCache::used() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return bytes_used;
+}
+
+size_t ResultCache::entries() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return lru.size();
+}
+
+void ResultCache::evict(std::list<Entry>::iterator it)
+{
+  bytes_used -= it->result->bytes;
+  entries_by_key.erase(it->key);
+  lru.erase(it);
+}
@@ -0,0 +1,281 @@
+#include "ResultSink.hh"
+#include "Output.hh"
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+OutputBuffer::OutputBuffer(int fd, bool owns_fd, size_t capacity)
+    : capacity(capacity), fd(fd), owns_fd(owns_fd),
+      captured(fd == STDOUT_FILENO ? output::captured() : nullptr)
+{
+}
+
+OutputBuffer::~OutputBuffer()
+{
+  flush();
+  if (owns_fd)
+    close(fd);
+}
+
+void OutputBuffer::flush()
+{
+  if (captured != nullptr)
+  {
+    captured->write(buffer.data(), buffer.size());
+    buffer.clear();
+    return;
+  }
+
+  size_t written = 0;
+  while (written < buffer.size())
+  {
+    ssize_t count = write(fd, buffer.data() + written, buffer.size() - written);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("ERROR: Couldn't write result");
+      break;
+    }
+    written += count;
+  }
+  buffer.clear();
+}
+
+ResultSink::ResultSink(int fd, bool owns_fd, std::vector<hsql::Expr*>* fields,
+                       std::vector<hsql::DataType> field_types,
+                       std::vector<size_t> fields_width)
+    : out(fd, owns_fd), field_types(field_types), fields_width(fields_width)
+{
+  for (const auto& field : *fields)
+    field_names.push_back(field->name);
+}
+
+std::unique_ptr<ResultSink>
+ResultSink::make(std::vector<hsql::Expr*>* fields,
+                 std::vector<hsql::DataType> field_types,
+                 std::vector<size_t> fields_width)
+{
+  auto& settings = Settings::get();
+
+  int fd = STDOUT_FILENO;
+  bool owns_fd = 0;
+  if (!settings.output_path.empty())
+  {
+    fd = open(settings.output_path.c_str(), O_WRONLY | O_CREAT | O_APPEND,
+              S_IRUSR | S_IWUSR);
+    if (fd < 0)
+    {
+      perror(settings.output_path.c_str());
+      fd = STDOUT_FILENO;
+    }
+    else
+      owns_fd = 1;
+  }
+
+  // Anything already queued in std::cout must come out before the result
+  output::out().flush();
+
+  switch (settings.output_format)
+  {
+  case OutputFormat::CSV:
+    return std::make_unique<DelimitedSink>(fd, owns_fd, fields, field_types,
+                                           ',');
+  case OutputFormat::TSV:
+    return std::make_unique<DelimitedSink>(fd, owns_fd, fields, field_types,
+                                           '\t');
+  case OutputFormat::JSON:
+    return std::make_unique<JsonLinesSink>(fd, owns_fd, fields, field_types);
+  default:
+    return std::make_unique<BoxSink>(
+        fd, owns_fd, fields, field_types, fields_width,
+        settings.output_mode == OutputMode::STREAMING,
+        settings.width_sample_rows);
+  }
+}
+
+BoxSink::BoxSink(int fd, bool owns_fd, std::vector<hsql::Expr*>* fields,
+                 std::vector<hsql::DataType> field_types,
+                 std::vector<size_t> fields_width, bool streaming,
+                 size_t sample_rows)
+    : ResultSink(fd, owns_fd, fields, field_types, fields_width),
+      streaming(streaming), sample_rows(sample_rows)
+{
+  if (this->streaming && this->sample_rows == 0)
+    flush_pending();
+}
+
+template <typename Row>
+void BoxSink::write_row(const Row& row, char separator)
+{
+  out.append('|');
+  for (size_t i = 0; i < row.size(); i++)
+  {
+    // Center the value inside its cell, same as printUtils::print_row
+    size_t width = fields_width[i];
+    size_t size = row[i].size();
+    size_t left = (size < width) ? (width - size) / 2 : 0;
+    out.append(left, ' ');
+    out.append(row[i]);
+    if (left + size < width)
+      out.append(width - left - size, ' ');
+    out.append((i == row.size() - 1) ? '|' : separator);
+  }
+  out.append('\n');
+}
+
+void BoxSink::add_row(const RowView& row)
+{
+  row_count++;
+  if (header_written)
+  {
+    write_row(row);
+    return;
+  }
+
+  for (size_t i = 0; i < row.size(); i++)
+    if (fields_width[i] < row[i].size() + 2)
+      fields_width[i] = row[i].size() + 2;
+  pending.emplace_back(row.begin(), row.end());
+  if (streaming && pending.size() >= sample_rows)
+    flush_pending();
+}
+
+void BoxSink::flush_pending()
+{
+  if (!header_written)
+  {
+    out.append('\n');
+    write_row(field_names);
+
+    std::vector<std::string> dashes;
+    for (const auto& width : fields_width)
+      dashes.push_back(std::string(width, '-'));
+    write_row(dashes, '+');
+    header_written = 1;
+  }
+
+  for (const auto& row : pending)
+    write_row(row);
+  pending.clear();
+}
+
+void BoxSink::finish()
+{
+  flush_pending();
+  out.flush();
+}
+
+DelimitedSink::DelimitedSink(int fd, bool owns_fd,
+                             std::vector<hsql::Expr*>* fields,
+                             std::vector<hsql::DataType> field_types,
+                             char delimiter)
+    : ResultSink(fd, owns_fd, fields, field_types,
+                 std::vector<size_t>(fields->size(), 0)),
+      delimiter(delimiter)
+{
+  for (size_t i = 0; i < field_names.size(); i++)
+  {
+    if (i > 0)
+      out.append(this->delimiter);
+    write_field(field_names[i]);
+  }
+  out.append('\n');
+}
+
+void DelimitedSink::write_field(std::string_view data)
+{
+  if (delimiter == '\t')
+  {
+    for (char c : data)
+    {
+      if (c == '\t')
+        out.append("\\t");
+      else if (c == '\n')
+        out.append("\\n");
+      else if (c == '\\')
+        out.append("\\\\");
+      else
+        out.append(c);
+    }
+    return;
+  }
+
+  if (data.find_first_of(",\"\r\n") == std::string_view::npos)
+  {
+    out.append(data);
+    return;
+  }
+
+  out.append('"');
+  for (char c : data)
+  {
+    if (c == '"')
+      out.append('"');
+    out.append(c);
+  }
+  out.append('"');
+}
+
+void DelimitedSink::add_row(const RowView& row)
+{
+  row_count++;
+  for (size_t i = 0; i < row.size(); i++)
+  {
+    if (i > 0)
+      out.append(delimiter);
+    write_field(row[i]);
+  }
+  out.append('\n');
+}
+
+JsonLinesSink::JsonLinesSink(int fd, bool owns_fd,
+                             std::vector<hsql::Expr*>* fields,
+                             std::vector<hsql::DataType> field_types)
+    : ResultSink(fd, owns_fd, fields, field_types,
+                 std::vector<size_t>(fields->size(), 0))
+{
+}
+
+void JsonLinesSink::write_string(std::string_view data)
+{
+  static const char* hex = "0123456789abcdef";
+
+  out.append('"');
+  for (unsigned char c : data)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out.append('\\');
+      out.append((char)c);
+    }
+    else if (c < 0x20)
+    {
+      out.append("\\u00");
+      out.append(hex[c >> 4]);
+      out.append(hex[c & 0xf]);
+    }
+    else
+      out.append((char)c);
+  }
+  out.append('"');
+}
+
+void JsonLinesSink::add_row(const RowView& row)
+{
+  row_count++;
+  out.append('{');
+  for (size_t i = 0; i < row.size(); i++)
+  {
+    if (i > 0)
+      out.append(',');
+    write_string(field_names[i]);
+    out.append(':');
+    if (field_types[i] == hsql::DataType::INT && !row[i].empty())
+      out.append(row[i]);
+    else
+      write_string(row[i]);
+  }
+  out.append("}\n");
+}
@@ -0,0 +1,376 @@
+#include "Server.hh"
+#include "DBException.hh"
+#include "Output.hh"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+Server::Server(std::string const& socket_path, size_t worker_count)
+{
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path))
+    throw DBException{CANNOT_LISTEN, "", socket_path};
+  socket_path.copy(address.sun_path, socket_path.size());
+
+  this->listen_fd =
+      socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (this->listen_fd < 0)
+    throw DBException{CANNOT_LISTEN, "", socket_path};
+
+  // A socket left behind by a server that died would make bind fail. One
+  // that still takes connections belongs to a running server
+  struct stat info;
+  if (lstat(socket_path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+  {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool live = connect(probe, (sockaddr*)&address, sizeof(address)) == 0;
+    close(probe);
+    if (!live)
+      unlink(socket_path.c_str());
+  }
+
+  if (bind(this->listen_fd, (sockaddr*)&address, sizeof(address)) < 0)
+  {
+    closeSockets();
+    throw DBException{CANNOT_LISTEN, "", socket_path};
+  }
+  // Only removed on the way out once it is this server's
+  this->socket_path = socket_path;
+  if (!setUp(worker_count))
+  {
+    closeSockets();
+    throw DBException{CANNOT_LISTEN, "", socket_path};
+  }
+}
+
+Server::Server(uint16_t port, size_t worker_count)
+{
+  std::string name = "127.0.0.1:" + std::to_string(port);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  this->listen_fd =
+      socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int reuse = 1;
+  socklen_t length = sizeof(address);
+  if (this->listen_fd < 0 ||
+      setsockopt(this->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                 sizeof(reuse)) < 0 ||
+      bind(this->listen_fd, (sockaddr*)&address, sizeof(address)) < 0 ||
+      getsockname(this->listen_fd, (sockaddr*)&address, &length) < 0 ||
+      !setUp(worker_count))
+  {
+    closeSockets();
+    throw DBException{CANNOT_LISTEN, "", name};
+  }
+  this->tcp_port = ntohs(address.sin_port);
+}
+
+bool Server::setUp(size_t worker_count)
+{
+  this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  this->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (listen(this->listen_fd, SOMAXCONN) < 0 || this->epoll_fd < 0 ||
+      this->wake_fd < 0)
+    return 0;
+  watch(this->listen_fd, EPOLLIN, EPOLL_CTL_ADD);
+  watch(this->wake_fd, EPOLLIN, EPOLL_CTL_ADD);
+
+  if (worker_count == 0)
+    worker_count = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < worker_count; i++)
+    this->workers.emplace_back(&Server::work, this);
+  return 1;
+}
+
+Server::~Server()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->workers_stopping = 1;
+  }
+  this->jobs_cv.notify_all();
+  for (auto& worker : this->workers)
+    worker.join();
+  this->workers.clear();
+
+  for (const auto& [fd, connection] : this->connections)
+    close(fd);
+  this->connections.clear();
+  closeSockets();
+}
+
+void Server::closeSockets()
+{
+  for (int* fd : {&this->listen_fd, &this->epoll_fd, &this->wake_fd})
+    if (*fd >= 0)
+    {
+      close(*fd);
+      *fd = -1;
+    }
+  if (!this->socket_path.empty())
+  {
+    unlink(this->socket_path.c_str());
+    this->socket_path.clear();
+  }
+}
+
+void Server::watch(int fd, uint32_t events, int op)
+{
+  epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+  epoll_ctl(this->epoll_fd, op, fd, &event);
+}
+
+void Server::wake()
+{
+  uint64_t one = 1;
+  ssize_t count = ::write(this->wake_fd, &one, sizeof(one));
+  (void)count;    // Only fails when a wake up is already pending
+}
+
+void Server::stop()
+{
+  this->stopping = 1;
+  wake();
+}
+
+void Server::run()
+{
+  epoll_event events[64];
+  while (!this->stopping)
+  {
+    int count = epoll_wait(this->epoll_fd, events, 64, -1);
+    if (count < 0 && errno != EINTR)
+      break;
+
+    for (int i = 0; i < count; i++)
+    {
+      int fd = events[i].data.fd;
+      if (fd == this->listen_fd)
+        acceptClients();
+      else if (fd == this->wake_fd)
+      {
+        uint64_t wakes;
+        ssize_t read = ::read(this->wake_fd, &wakes, sizeof(wakes));
+        (void)read;
+        sendReplies();
+      }
+      else
+      {
+        auto it = this->connections.find(fd);
+        if (it == this->connections.end())
+          continue;
+        // Keep the connection alive past a hang up while it is used here
+        auto connection = it->second;
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+          readRequests(connection);
+        if (!connection->hung_up && (events[i].events & EPOLLOUT))
+          writeReplies(connection);
+      }
+    }
+  }
+
+  // Queries still running finish, but their replies are never sent
+  auto open = this->connections;
+  for (const auto& [fd, connection] : open)
+    hangUp(connection);
+}
+
+void Server::acceptClients()
+{
+  while (1)
+  {
+    int fd = accept4(this->listen_fd, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return;
+    }
+
+    // Replies are whole frames, so send them as soon as they are queued
+    if (this->socket_path.empty())
+    {
+      int nodelay = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    this->connections[fd] = std::make_shared<Connection>(fd);
+    watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+  }
+}
+
+void Server::readRequests(std::shared_ptr<Connection> const& connection)
+{
+  char data[1 << 16];
+  bool closed = 0;
+  while (1)
+  {
+    ssize_t count = recv(connection->fd, data, sizeof(data), 0);
+    if (count > 0)
+    {
+      connection->reader.feed(data, count);
+      continue;
+    }
+    if (count < 0 && errno == EINTR)
+      continue;
+    closed = count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+    break;
+  }
+
+  std::string query;
+  protocol::FrameStatus status;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    while ((status = connection->reader.next(query)) == protocol::kFrameReady)
+      connection->requests.push_back(std::move(query));
+    if (!connection->requests.empty())
+      schedule(connection);
+  }
+
+  if (closed || status == protocol::kFrameTooLarge)
+    hangUp(connection);
+}
+
+void Server::writeReplies(std::shared_ptr<Connection> const& connection)
+{
+  size_t sent = 0;
+  std::string& outbox = connection->outbox;
+  while (sent < outbox.size())
+  {
+    ssize_t count = send(connection->fd, outbox.data() + sent,
+                         outbox.size() - sent, MSG_NOSIGNAL);
+    if (count > 0)
+      sent += count;
+    else if (count < 0 && errno == EINTR)
+      continue;
+    else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    else
+    {
+      hangUp(connection);
+      return;
+    }
+  }
+  outbox.erase(0, sent);
+
+  // Only ask to hear about room in the socket while replies are waiting
+  bool waiting = !outbox.empty();
+  if (waiting != connection->writable_wait)
+  {
+    connection->writable_wait = waiting;
+    uint32_t events = EPOLLIN | EPOLLRDHUP;
+    if (waiting)
+      events |= EPOLLOUT;
+    watch(connection->fd, events, EPOLL_CTL_MOD);
+  }
+}
+
+void Server::sendReplies()
+{
+  std::vector<std::shared_ptr<Connection>> ready;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    ready.swap(this->replied);
+    for (const auto& connection : ready)
+    {
+      connection->outbox.append(connection->replies);
+      connection->replies.clear();
+      connection->replied = 0;
+    }
+  }
+
+  for (const auto& connection : ready)
+    if (!connection->hung_up)
+      writeReplies(connection);
+}
+
+void Server::hangUp(std::shared_ptr<Connection> const& connection)
+{
+  epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, connection->fd, nullptr);
+  close(connection->fd);
+  this->connections.erase(connection->fd);
+
+  // A worker still has to roll back what the session left open
+  std::lock_guard<std::mutex> lock(this->mutex);
+  connection->hung_up = 1;
+  connection->requests.clear();
+  schedule(connection);
+}
+
+void Server::schedule(std::shared_ptr<Connection> const& connection)
+{
+  if (connection->running)
+    return;
+  connection->running = 1;
+  this->jobs.push_back(connection);
+  this->jobs_cv.notify_one();
+}
+
+void Server::work()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (1)
+  {
+    if (this->jobs.empty())
+    {
+      if (this->workers_stopping)
+        return;
+      this->jobs_cv.wait(lock);
+      continue;
+    }
+
+    auto connection = std::move(this->jobs.front());
+    this->jobs.pop_front();
+    if (connection->hung_up)
+    {
+      lock.unlock();
+      connection->session.close();
+      lock.lock();
+      continue;
+    }
+
+    std::string query = std::move(connection->requests.front());
+    connection->requests.pop_front();
+    lock.unlock();
+
+    std::string reply;
+    {
+      output::Capture capture;
+      connection->session.run(query);
+      reply = capture.str();
+    }
+    if (reply.size() > UINT32_MAX)
+      reply = "ERROR: Result is too large to send.\n";
+    reply = protocol::frame(reply);
+
+    lock.lock();
+    connection->replies.append(reply);
+    if (!connection->replied)
+    {
+      connection->replied = 1;
+      this->replied.push_back(connection);
+      wake();
+    }
+
+    // Back of the line, so busy connections don't keep others waiting
+    if (!connection->requests.empty() || connection->hung_up)
+      this->jobs.push_back(connection);
+    else
+      connection->running = 0;
+  }
+}
@@ -0,0 +1,223 @@
+#include "Session.hh"
+#include "Catalog.hh"
+#include "DBException.hh"
+#include "Output.hh"
+#include "Processor.hh"
+#include "filestruct.hh"
+#include "printutils.hh"
+#include <iostream>
+
+namespace ft = ftools;
+namespace pu = printUtils;
+
+void Session::close()
+{
+  if (this->transaction != nullptr)
+    endTransaction(0);
+}
+
+void Session::run(std::string const& query)
+{
+  // A statement failing doesn't stop the ones after it
+  auto attempt = [this](auto const& statement) {
+    try
+    {
+      statement();
+    }
+    catch (const DBException& e)
+    {
+      output::out() << e.what() << "\n";
+      // The transaction gave up waiting for a table another one has
+      if ((e.code() == TRANSACTION_CONFLICT || e.code() == LOCK_TIMEOUT) &&
+          this->transaction != nullptr)
+        endTransaction(0);
+    }
+  };
+
+  hsql::SQLParserResult result;
+  Command command = Command::parse(query);
+  // CREATE TABLE only hands its constraints to Command
+  if (command.type == kCommandCreateTable)
+    hsql::SQLParser::parse(command.query, &result);
+  else if (command.type != kCommandNone)
+    attempt([&] { runCommand(command); });
+  else
+    hsql::SQLParser::parse(query, &result);
+
+  if (result.isValid())
+    for (size_t i = 0; i < result.size(); i++)
+      attempt([&] { runStatement(result.getStatement(i), command); });
+  else if (command.type == kCommandNone ||
+           command.type == kCommandCreateTable)
+  {
+    output::err() << "Given string is not a valid SQL query.\n";
+    output::err() << result.errorMsg() << "\n";
+  }
+}
+
+TableHandle Session::table(std::string const& name)
+{
+  if (this->transaction == nullptr)
+    return TableCache::instance().get(name);
+
+  // The transaction may have changes waiting in the table, so the cache
+  // must not close it until the transaction ends
+  auto& handle = this->transaction_tables[name];
+  if (handle == nullptr)
+    handle = TableCache::instance().get(name);
+  return handle;
+}
+
+void Session::endTransaction(bool commit)
+{
+  if (this->transaction == nullptr)
+    throw DBException{NO_TRANSACTION};
+
+  // A COMMIT that fails leaves nothing half done in memory
+  try
+  {
+    if (commit)
+      Processor::commit(*this->transaction);
+    else
+      Processor::rollback(*this->transaction);
+  }
+  catch (const DBException&)
+  {
+    Processor::rollback(*this->transaction);
+    this->transaction.reset();
+    this->transaction_tables.clear();
+    throw;
+  }
+
+  this->transaction.reset();
+  this->transaction_tables.clear();
+}
+
+void Session::checkNoTransaction() const
+{
+  if (this->transaction != nullptr)
+    throw DBException{DDL_IN_TRANSACTION};
+}
+
+void Session::runCommand(Command const& command)
+{
+  switch (command.type)
+  {
+  case kCommandCopy:
+    Processor::copy_records(&command, *table(command.table_name),
+                            this->transaction.get());
+    break;
+  case kCommandCreateIndex:
+    checkNoTransaction();
+    Processor::create_index(command.columns, *table(command.table_name),
+                            command.index_type, command.include);
+    break;
+  case kCommandCreateBloomFilter:
+    checkNoTransaction();
+    Processor::create_bloom_filter(command.columns, *table(command.table_name),
+                                   command.false_positive_rate);
+    break;
+  case kCommandBegin:
+    if (this->transaction != nullptr)
+      throw DBException{TRANSACTION_ALREADY_OPEN};
+    this->transaction = std::make_unique<Transaction>(1);
+    output::out() << "Began transaction.\n";
+    break;
+  case kCommandCommit:
+    endTransaction(1);
+    break;
+  case kCommandRollback:
+    endTransaction(0);
+    break;
+  default:
+    break;
+  }
+}
+
+void Session::runStatement(const hsql::SQLStatement* statement,
+                           Command const& command)
+{
+  switch (statement->type())
+  {
+  case hsql::kStmtSelect:
+  {
+    auto select_stmt = (hsql::SelectStatement*)statement;
+    if (select_stmt->fromTable == nullptr)
+    {
+      output::err() << "ERROR: No source table was specified.\n";
+      break;
+    }
+
+    Processor::show_records(select_stmt, *table(select_stmt->fromTable->name),
+                            this->transaction.get());
+    break;
+  }
+  case hsql::kStmtInsert:
+  {
+    auto insert_stmt = (hsql::InsertStatement*)statement;
+    Processor::insert_record(insert_stmt, *table(insert_stmt->tableName),
+                             this->transaction.get());
+    break;
+  }
+  case hsql::kStmtUpdate:
+  {
+    auto update_stmt = (hsql::UpdateStatement*)statement;
+    Processor::update_records(update_stmt, *table(update_stmt->table->name),
+                              this->transaction.get());
+    break;
+  }
+  case hsql::kStmtDelete:
+  {
+    auto delete_stmt = (hsql::DeleteStatement*)statement;
+    Processor::delete_records(delete_stmt, *table(delete_stmt->tableName),
+                              this->transaction.get());
+    break;
+  }
+  case hsql::kStmtCreate:
+  {
+    auto create_stmt = (hsql::CreateStatement*)statement;
+    checkNoTransaction();
+    if (create_stmt->type == hsql::kCreateTable)
+    {
+      if (ft::dirExists(ft::getTablePath(create_stmt->tableName)))
+        output::err() << "Table named " << create_stmt->tableName
+                      << " already exists!\n";
+      else
+      {
+        TableCache::instance().put(std::make_unique<Table>(
+            create_stmt->tableName, create_stmt->columns,
+            command.constraints, command.storage));
+        // The table keeps the column definitions
+        create_stmt->columns = nullptr;
+      }
+    }
+    else if (create_stmt->type == hsql::kCreateIndex)
+    {
+      std::vector<std::string> columns;
+      for (const auto& column : *create_stmt->columns)
+        columns.push_back(column->name);
+      Processor::create_index(columns, *table(create_stmt->tableName));
+    }
+    break;
+  }
+  case hsql::kStmtDrop:
+  {
+    auto drop_stmt = (hsql::DropStatement*)statement;
+    checkNoTransaction();
+    if (Processor::drop_table(*table(drop_stmt->name)))
+      TableCache::instance().erase(drop_stmt->name);
+    break;
+  }
+  case hsql::kStmtShow:    // DESCRIBE
+  {
+    auto show_stmt = (hsql::ShowStatement*)statement;
+    if (show_stmt->type == hsql::ShowType::kShowTables)
+      pu::print_tables_list(Catalog::instance().tables());
+    else
+      pu::print_table_desc(*table(show_stmt->name));
+    break;
+  }
+  default:
+    output::err() << "Query implementation missing!\n";
+  }
+}
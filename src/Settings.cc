@@ -0,0 +1,63 @@
+#include "Settings.hh"
+#include <algorithm>
+#include <cstdlib>
+
+Settings& Settings::get()
+{
+  static Settings settings;
+  return settings;
+}
+
+void Settings::load_from_env()
+{
+  if (const char* output_format = getenv(OUTPUT_FORMAT_ENV))
+  {
+    std::string format = output_format;
+    if (format == "csv")
+      this->output_format = OutputFormat::CSV;
+    else if (format == "tsv")
+      this->output_format = OutputFormat::TSV;
+    else if (format == "json")
+      this->output_format = OutputFormat::JSON;
+    else
+      this->output_format = OutputFormat::BOX;
+  }
+
+  if (const char* output_path = getenv(OUTPUT_FILE_ENV))
+    this->output_path = output_path;
+
+  if (const char* output_mode = getenv(OUTPUT_MODE_ENV))
+    this->output_mode = (std::string(output_mode) == "stream")
+                            ? OutputMode::STREAMING
+                            : OutputMode::BUFFERED;
+
+  if (const char* sample_rows = getenv(WIDTH_SAMPLE_ENV))
+    this->width_sample_rows = strtoul(sample_rows, nullptr, 10);
+
+  if (const char* cache_budget = getenv(RESULT_CACHE_ENV))
+    this->result_cache_bytes = strtoul(cache_budget, nullptr, 10);
+
+  if (const char* max_tables = getenv(TABLE_CACHE_ENV))
+    this->table_cache_tables = strtoul(max_tables, nullptr, 10);
+
+  if (const char* max_bytes = getenv(TABLE_CACHE_BYTES_ENV))
+    this->table_cache_bytes = strtoul(max_bytes, nullptr, 10);
+
+  if (const char* stats = getenv(TABLE_CACHE_STATS_ENV))
+    this->table_cache_stats = atoi(stats) != 0;
+
+  if (const char* batch_rows = getenv(VACUUM_BATCH_ENV))
+    this->vacuum_batch_rows = strtoul(batch_rows, nullptr, 10);
+
+  if (const char* delay_ms = getenv(VACUUM_DELAY_ENV))
+    this->vacuum_delay_ms = atoi(delay_ms);
+
+  if (const char* group_rows = getenv(ZONE_GROUP_ENV))
+    this->zone_group_rows = std::max(1ul, strtoul(group_rows, nullptr, 10));
+
+  if (const char* workers = getenv(SERVER_WORKERS_ENV))
+    this->server_workers = strtoul(workers, nullptr, 10);
+
+  if (const char* timeout_ms = getenv(LOCK_TIMEOUT_ENV))
+    this->lock_timeout_ms = atoi(timeout_ms);
+}
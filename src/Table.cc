@@ -1,5 +1,11 @@
+#include "Catalog.hh"
+#include "HashIndex.hh"
+#include "Output.hh"
+#include "Settings.hh"
+#include "ZoneMap.hh"
 #include "Where.hh"
 #include "printutils.hh"
+#include <sstream>
 
 namespace ft = ftools;
 namespace fs = std::filesystem;
@@ -10,12 +16,324 @@ Table::Table(std::string name)
   this->name = name;
   loadPaths(name);
   checkTableExists();
-  load_metadata();
-
-  this->reg_count = ft::getRegCount(name);
 
+  // The catalog record is used while it matches metadata.dat. Otherwise the
+  // table is loaded the slow way and its record written again
+  std::string record;
   this->indexes = new std::vector<Index*>;
-  loadIndexes();
+  bool cataloged = Catalog::instance().find(name, record);
+  bool loaded = cataloged && loadCatalogRecord(record);
+  if (!loaded)
+  {
+    load_metadata();
+    loadIndexes();
+  }
+
+  this->slot_size = calculateSlotSize();
+  Journal::recover(
+      this->path,
+      [this](std::string const& filename, std::string const& slot)
+      { return writeSlot(filename, slot); },
+      [this](std::vector<std::string> const& filenames)
+      { return writeTombstones(filenames); });
+  loadTombstones();
+
+  this->reg_count = RegIdAllocator::get(name).last();
+
+  // Tables new to the catalog have their registers counted once
+  if (!cataloged)
+    writeCatalog(countRegisters());
+  else if (!loaded)
+    writeCatalog();
+
+  if (this->reg_size != calculateRegSize())
+    migrateDates();
+}
+
+// Catalog records are the fields of the table one after the other, with
+// strings and lists preceded by their size
+template <typename T>
+static void putField(std::string& record, T const& value)
+{
+  record.append((const char*)&value, sizeof(T));
+}
+
+static void putField(std::string& record, std::string const& value)
+{
+  putField(record, (uint32_t)value.size());
+  record += value;
+}
+
+namespace
+{
+struct RecordReader
+{
+  std::string_view data;
+  bool read = 1;
+
+  template <typename T>
+  T get()
+  {
+    T value{};
+    if (data.size() < sizeof(T))
+      read = 0;
+    else
+    {
+      memcpy(&value, data.data(), sizeof(T));
+      data.remove_prefix(sizeof(T));
+    }
+    return value;
+  }
+
+  std::string getString()
+  {
+    uint32_t size = get<uint32_t>();
+    if (data.size() < size)
+      read = 0;
+    if (!read)
+      return "";
+    std::string value(data.substr(0, size));
+    data.remove_prefix(size);
+    return value;
+  }
+};
+}    // namespace
+
+// metadata.dat as the record saw it
+static void metadataStamp(std::string const& path, int64_t& mtime,
+                          int64_t& size)
+{
+  struct stat info;
+  mtime = size = -1;
+  if (stat(path.c_str(), &info) == 0)
+  {
+    mtime = info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+    size = info.st_size;
+  }
+}
+
+std::string Table::catalogRecord() const
+{
+  std::string record;
+  int64_t mtime, size;
+  metadataStamp(this->metadata_path, mtime, size);
+  putField(record, mtime);
+  putField(record, size);
+  putField(record, (int32_t)this->reg_size);
+
+  putField(record, (uint32_t)this->columns->size());
+  for (const auto& column : *this->columns)
+  {
+    putField(record, std::string(column->name));
+    putField(record, (int32_t)column->type.data_type);
+    putField(record, (int64_t)column->type.length);
+    putField(record, (uint8_t)column->nullable);
+  }
+
+  putField(record, (uint32_t)this->constraints.size());
+  for (const auto& constraint : this->constraints)
+  {
+    putField(record, (uint8_t)constraint.type);
+    putField(record, Index::nameFor(constraint.columns));
+  }
+
+  putField(record, (uint32_t)((this->column_store != nullptr)
+                                  ? this->column_store->group_rows()
+                                  : 0));
+  putField(record, Index::nameFor(this->bloom_columns));
+  putField(record, this->bloom_fpr);
+
+  putField(record, (uint32_t)this->indexes->size());
+  for (const auto& index : *this->indexes)
+  {
+    putField(record, index->name);
+    putField(record, (uint8_t)index->type);
+  }
+  return record;
+}
+
+// Frees column definitions read from disk. Their names belong to the table's
+// column_names, so the definitions must not free them
+static void deleteColumns(std::vector<hsql::ColumnDefinition*>* columns)
+{
+  for (auto& column : *columns)
+  {
+    column->name = nullptr;
+    delete column;
+  }
+  delete columns;
+}
+
+bool Table::loadCatalogRecord(std::string_view record)
+{
+  RecordReader reader{record};
+  int64_t mtime, size;
+  metadataStamp(this->metadata_path, mtime, size);
+  if (reader.get<int64_t>() != mtime || reader.get<int64_t>() != size ||
+      mtime < 0)
+    return 0;
+  this->reg_size = reader.get<int32_t>();
+
+  uint32_t column_count = reader.get<uint32_t>();
+  auto columns = std::make_unique<std::vector<hsql::ColumnDefinition*>>();
+  for (uint32_t i = 0; reader.read && i < column_count; i++)
+  {
+    std::string name = reader.getString();
+    auto data_type = (hsql::DataType)reader.get<int32_t>();
+    int64_t length = reader.get<int64_t>();
+    bool nullable = reader.get<uint8_t>();
+    this->column_names.push_back(std::move(name));
+    columns->push_back(new hsql::ColumnDefinition(
+        this->column_names.back().data(), hsql::ColumnType(data_type, length),
+        nullable));
+  }
+  if (!reader.read)
+  {
+    deleteColumns(columns.release());
+    this->column_names.clear();
+    return 0;
+  }
+  this->columns = columns.release();
+
+  uint32_t constraint_count = reader.get<uint32_t>();
+  for (uint32_t i = 0; reader.read && i < constraint_count; i++)
+  {
+    Constraint constraint{(ConstraintType)reader.get<uint8_t>(), {}};
+    std::vector<int> column_pos;
+    resolveColumns(reader.getString(), constraint.columns, column_pos);
+    this->constraints.push_back(constraint);
+  }
+
+  uint32_t group_rows = reader.get<uint32_t>();
+  if (group_rows > 0)
+    this->column_store = std::make_unique<ColumnStore>(
+        this->regs_path, this->columns, group_rows);
+  std::vector<int> bloom_pos;
+  resolveColumns(reader.getString(), this->bloom_columns, bloom_pos);
+  this->bloom_fpr = reader.get<double>();
+
+  uint32_t index_count = reader.get<uint32_t>();
+  for (uint32_t i = 0; reader.read && i < index_count; i++)
+  {
+    std::string idx_name = reader.getString();
+    auto idx_type = (IndexType)reader.get<uint8_t>();
+    size_t plus = idx_name.find('+');
+    std::vector<std::string> idx_columns, idx_include;
+    std::vector<int> idx_column_pos, idx_include_pos;
+    resolveColumns(idx_name.substr(0, plus), idx_columns, idx_column_pos);
+    if (plus != std::string::npos)
+      resolveColumns(idx_name.substr(plus + 1), idx_include, idx_include_pos);
+    this->indexes->push_back(new Index(idx_name,
+                                       this->indexes_path + idx_name + "/",
+                                       idx_columns, idx_column_pos, idx_type,
+                                       idx_include, idx_include_pos));
+  }
+  if (reader.read)
+    return 1;
+
+  // A record cut short is dropped, and the table read from its files
+  for (const auto& index : *this->indexes)
+    delete index;
+  this->indexes->clear();
+  this->constraints.clear();
+  this->bloom_columns.clear();
+  this->column_store.reset();
+  deleteColumns(this->columns);
+  this->columns = nullptr;
+  this->column_names.clear();
+  return 0;
+}
+
+void Table::writeCatalog(TableStats const& stats) const
+{
+  Catalog::instance().put(this->name, catalogRecord(), stats);
+}
+
+TableStats Table::countRegisters() const
+{
+  TableStats stats;
+  stats.deleted = this->tombstones.size();
+  stats.rows = std::max<int64_t>(
+      registerFilenames().size() - this->tombstones.size(), 0);
+  return stats;
+}
+
+bool Table::catalogEntry(std::string const& name, std::string& record,
+                         TableStats& stats)
+{
+  // No journal is replayed and no ids are allocated, as opening it would
+  Table table;
+  table.name = name;
+  table.loadPaths(name);
+  table.indexes = new std::vector<Index*>;
+  try
+  {
+    table.checkTableExists();
+    table.load_metadata();
+    table.loadIndexes();
+  }
+  catch (const DBException& e)
+  {
+    return 0;
+  }
+  table.loadTombstones();
+
+  record = table.catalogRecord();
+  stats = table.countRegisters();
+  return 1;
+}
+
+void Table::migrateDates()
+{
+  // Tables written before DATE values were day numbers kept them as text,
+  // which the register size still tells. Their registers are rewritten and
+  // the tree indexes that keep dates are built again. The metadata goes
+  // last, so a migration cut short is simply run again
+  std::vector<int> date_pos;
+  for (size_t i = 0; i < this->columns->size(); i++)
+    if (this->columns->at(i)->type.data_type == hsql::DataType::DATE)
+      date_pos.push_back(i);
+
+  std::string slot;
+  std::vector<std::string_view> fields;
+  std::list<std::pair<std::string, RegisterData>> regs;
+  std::vector<std::pair<const std::string*, const RegisterData*>> written;
+  for (const auto& filename : registerFilenames())
+  {
+    if (!readRegister(filename, slot, fields))
+      continue;
+    RegisterData reg_data(fields.begin(), fields.end());
+    int32_t days;
+    for (const auto& pos : date_pos)
+      if (dateToDays(reg_data[pos], days))
+        reg_data[pos] = std::to_string(days);
+    regs.push_back({filename, std::move(reg_data)});
+    written.push_back({&regs.back().first, &regs.back().second});
+  }
+  writeRegisters(written);
+
+  std::vector<const std::vector<std::string>*> rows;
+  std::vector<const std::string*> filenames;
+  for (const auto& [filename, reg_data] : regs)
+    if (!isDeleted(filename))
+    {
+      rows.push_back(&reg_data);
+      filenames.push_back(&filename);
+    }
+  for (const auto& index : *this->indexes)
+  {
+    bool keeps_dates = 0;
+    for (const auto& pos : date_pos)
+      keeps_dates |= index->covers(pos);
+    if (index->type != kIndexTree || !keeps_dates)
+      continue;
+    fs::remove_all(index->path);
+    ft::createFolder(index->path);
+    index->bulk_add(rows, filenames);
+  }
+
+  this->reg_size = calculateRegSize();
+  writeMetadata();
 }
 
 void Table::loadPaths(std::string const& name)
@@ -24,6 +342,8 @@ void Table::loadPaths(std::string const& name)
   this->regs_path = ft::getRegistersPath(name);
   this->indexes_path = ft::getIndexesPath(name);
   this->metadata_path = ft::getMetadataPath(name);
+  this->tombstones_path = this->path + "tombstones.dat";
+  this->vacuum_path = this->path + "tombstones.vacuum";
 }
 
 void Table::checkTableExists()
@@ -38,10 +358,76 @@ bool Table::load_metadata()
   loadMetadataHeader();
   for (auto& column : *this->columns)
     loadColumnData(column);
+  loadConstraints();
 
   return 1;
 }
 
+void Table::loadConstraints()
+{
+  // Constraints follow the columns, one per line, and so do the storage of
+  // the table and the Bloom filtered columns with their false positive rate
+  std::string type, names;
+  while (getline(this->metadata_file, type, '\t') &&
+         getline(this->metadata_file, names, '\n'))
+  {
+    if (type == "STORAGE")
+    {
+      size_t tab = names.find('\t');
+      if (names.substr(0, tab) == "columnar")
+        this->column_store = std::make_unique<ColumnStore>(
+            this->regs_path, this->columns,
+            (tab != std::string::npos) ? stoul(names.substr(tab + 1))
+                                       : Settings::get().zone_group_rows);
+      continue;
+    }
+    if (type == "BLOOM")
+    {
+      size_t tab = names.find('\t');
+      std::vector<int> column_pos;
+      resolveColumns(names.substr(0, tab), this->bloom_columns, column_pos);
+      if (tab != std::string::npos)
+        this->bloom_fpr = stod(names.substr(tab + 1));
+      continue;
+    }
+
+    Constraint constraint{
+        (type == "PRIMARY KEY") ? kConstraintPrimaryKey : kConstraintUnique,
+        {}};
+    std::vector<int> column_pos;
+    resolveColumns(names, constraint.columns, column_pos);
+    this->constraints.push_back(constraint);
+  }
+}
+
+void Table::checkConstraints() const
+{
+  bool has_primary_key = 0;
+  for (const auto& constraint : this->constraints)
+  {
+    if (constraint.type == kConstraintPrimaryKey)
+    {
+      if (has_primary_key)
+        throw DBException{MULTIPLE_PRIMARY_KEYS, this->name};
+      has_primary_key = 1;
+    }
+
+    for (const auto& column : constraint.columns)
+    {
+      auto col = std::find_if(
+          this->columns->begin(), this->columns->end(),
+          [&](hsql::ColumnDefinition* col) { return column == col->name; });
+      if (col == this->columns->end())
+        throw DBException{COLUMN_NOT_IN_TABLE, this->name, column};
+      // Constraints are enforced through tree indexes, which take DATE keys
+      // as the day numbers they are stored as
+      if ((*col)->type.data_type != hsql::DataType::INT &&
+          (*col)->type.data_type != hsql::DataType::DATE)
+        throw DBException{INDEX_INVALID_TYPE};
+    }
+  }
+}
+
 void Table::openMetadataFile()
 {
   this->metadata_file.open(this->metadata_path);
@@ -84,8 +470,8 @@ void Table::loadColumnData(hsql::ColumnDefinition*& column)
   std::string data;
 
   getline(this->metadata_file, data, '\t');
-  char* col_name = new char[data.size()];
-  strcpy(col_name, data.c_str());
+  this->column_names.push_back(data);
+  char* col_name = this->column_names.back().data();
 
   hsql::ColumnType col_type = getColumnType();
 
@@ -95,12 +481,41 @@ void Table::loadColumnData(hsql::ColumnDefinition*& column)
   column = new hsql::ColumnDefinition(col_name, col_type, col_nullable);
 }
 
+void Table::resolveColumns(std::string const& names,
+                           std::vector<std::string>& columns,
+                           std::vector<int>& column_pos) const
+{
+  std::stringstream stream(names);
+  std::string column;
+  while (getline(stream, column, ','))
+    for (size_t i = 0; i < this->columns->size(); i++)
+      if (column == this->columns->at(i)->name)
+      {
+        columns.push_back(column);
+        column_pos.push_back(i);
+      }
+}
+
 void Table::loadIndexes()
 {
   for (const auto& reg : fs::directory_iterator(this->indexes_path))
   {
     std::string idx_name = reg.path().filename();
-    indexes->push_back(new Index(idx_name));
+    std::string idx_path = this->indexes_path + idx_name + "/";
+
+    // Indexes are named after their columns joined by commas, followed by
+    // the included ones after a '+'
+    size_t plus = idx_name.find('+');
+    std::vector<std::string> idx_columns, idx_include;
+    std::vector<int> idx_column_pos, idx_include_pos;
+    resolveColumns(idx_name.substr(0, plus), idx_columns, idx_column_pos);
+    if (plus != std::string::npos)
+      resolveColumns(idx_name.substr(plus + 1), idx_include, idx_include_pos);
+
+    indexes->push_back(new Index(
+        idx_name, idx_path, idx_columns, idx_column_pos,
+        HashIndex::exists(idx_path) ? kIndexHash : kIndexTree, idx_include,
+        idx_include_pos));
   }
 }
 
@@ -109,37 +524,87 @@ void Table::loadStoredRegisters()
   this->registers =
       std::make_unique<std::list<std::pair<std::string, RegisterData>>>();
 
-  for (const auto& reg : fs::directory_iterator(this->regs_path))
+  if (this->column_store != nullptr)
   {
-    // Load data in file to reg_data
-    std::ifstream data_file(reg.path());
-    std::vector<std::string> reg_data;
+    std::vector<bool> all(this->columns->size(), 1);
+    this->column_store->scan(
+        all, nullptr, [](int, int) { return 0; },
+        [this](int reg_id, std::vector<std::string_view> const& fields)
+        {
+          std::string filename = std::to_string(reg_id) + ".sqlito";
+          if (!isDeleted(filename))
+            this->registers->push_back(
+                {filename, RegisterData(fields.begin(), fields.end())});
+        });
+    return;
+  }
 
-    // Load each piece of data into reg_data
-    std::string data;
-    for (size_t i = 0; i < this->columns->size(); i++)
-    {
-      getline(data_file, data, '\t');
-      reg_data.push_back(data);
-    }
+  // A single buffer and field list are reused for every register file
+  std::string slot;
+  std::vector<std::string_view> fields;
+  for (const auto& reg : fs::directory_iterator(this->regs_path))
+  {
+    if (isDeleted(reg.path().filename()) || !ft::readSlot(reg.path(), slot))
+      continue;
+    parseRegister(slot, fields);
 
-    this->registers->push_back({reg.path().filename(), RegisterData(reg_data)});
+    this->registers->push_back(
+        {reg.path().filename(), RegisterData(fields.begin(), fields.end())});
   }
 }
 
-Table::Table(std::string name, std::vector<hsql::ColumnDefinition*>* cols)
+Table::Table(std::string name, std::vector<hsql::ColumnDefinition*>* cols,
+             std::vector<Constraint> constraints, TableStorage storage)
 {
   this->name = name;
   loadPaths(name);
   this->indexes = new std::vector<Index*>;
+  this->columns = cols;
+  this->constraints = constraints;
+  checkConstraints();
 
+  RegIdAllocator::forget(this->name);
+  Catalog::instance().remove(this->name);
   createTableFolders();
 
-  this->columns = cols;
   this->reg_size = calculateRegSize();
+  this->slot_size = calculateSlotSize();
+  this->reg_count = 0;
   this->registers =
       std::make_unique<std::list<std::pair<std::string, RegisterData>>>();
+  if (storage == kStorageColumnar)
+    this->column_store = std::make_unique<ColumnStore>(
+        this->regs_path, this->columns, Settings::get().zone_group_rows);
 
+  // Every constraint gets the index that enforces it. Constraints on the
+  // same columns share it
+  for (const auto& constraint : this->constraints)
+  {
+    std::string idx_name = Index::nameFor(constraint.columns);
+    if (constraintIndex(constraint) != nullptr)
+      continue;
+
+    std::vector<std::string> idx_columns;
+    std::vector<int> idx_column_pos;
+    resolveColumns(idx_name, idx_columns, idx_column_pos);
+    ft::createFolder(this->indexes_path + idx_name);
+    this->indexes->push_back(new Index(idx_name,
+                                       this->indexes_path + idx_name + "/",
+                                       idx_columns, idx_column_pos));
+  }
+  writeMetadata();
+
+  ZoneMap::create(this->path, Settings::get().zone_group_rows);
+
+  std::ofstream wCount(ft::getRegCountPath(this->name));
+  wCount << 0;    // 0 regs when table is created
+  wCount.close();
+
+  output::out() << "Table " << this->name << " was created successfully.\n";
+}
+
+void Table::writeMetadata() const
+{
   // Create medata.dat file for table
   // and fill it with table's name & cols info
   std::ofstream wMetadata(this->metadata_path);
@@ -148,13 +613,18 @@ Table::Table(std::string name, std::vector<hsql::ColumnDefinition*>* cols)
   for (const hsql::ColumnDefinition* col : *this->columns)
     wMetadata << col->name << "\t" << (int)col->type.data_type << "\t"
               << col->type.length << "\t" << col->nullable << "\n";
+  for (const auto& constraint : this->constraints)
+    wMetadata << (constraint.type == kConstraintPrimaryKey ? "PRIMARY KEY"
+                                                           : "UNIQUE")
+              << "\t" << Index::nameFor(constraint.columns) << "\n";
+  if (this->column_store != nullptr)
+    wMetadata << "STORAGE\tcolumnar\t" << this->column_store->group_rows()
+              << "\n";
+  if (!this->bloom_columns.empty())
+    wMetadata << "BLOOM\t" << Index::nameFor(this->bloom_columns) << "\t"
+              << this->bloom_fpr << "\n";
   wMetadata.close();
-
-  std::ofstream wCount(ft::getRegCountPath(this->name));
-  wCount << 0;    // 0 regs when table is created
-  wCount.close();
-
-  std::cout << "Table " << this->name << " was created successfully.\n";
+  writeCatalog();
 }
 
 void Table::createTableFolders()
@@ -175,12 +645,218 @@ int Table::calculateRegSize()
     else if (data_type == hsql::DataType::CHAR)
       reg_size += col->type.length;
     else if (data_type == hsql::DataType::DATE)
-      reg_size += 8;
+      reg_size += 4;    // Day number
   }
 
   return reg_size;
 }
 
+int Table::calculateSlotSize()
+{
+  int slot_size = 0;
+  for (const auto& col : *this->columns)
+    slot_size += pu::column_width(col) + 1;    // Value + '\t'
+
+  return slot_size;
+}
+
+size_t Table::memoryUsage() const
+{
+  if (this->registers == nullptr)
+    return 0;
+  // A list node and its filename, and a string per value
+  size_t per_register = sizeof(RegisterList::value_type) + 4 * sizeof(void*) +
+                        this->columns->size() * sizeof(std::string) +
+                        this->slot_size;
+  return this->registers->size() * per_register;
+}
+
+RegisterList* Table::loadedRegisters() const
+{
+  std::lock_guard<std::mutex> lock(this->registers_mutex);
+  return this->registers.get();
+}
+
+RegisterList* Table::allRegisters()
+{
+  std::lock_guard<std::mutex> lock(this->registers_mutex);
+  if (this->registers == nullptr)
+    loadStoredRegisters();
+  return this->registers.get();
+}
+
+void Table::purgeDeleted()
+{
+  if (this->registers != nullptr)
+    this->registers->remove_if([this](auto const& reg)
+                               { return isDeleted(reg.first); });
+  this->lingering = 0;
+}
+
+std::string Table::formatRegister(RegisterData const& reg_data) const
+{
+  std::string slot;
+  slot.reserve(this->slot_size);
+  for (const auto& data : reg_data)
+  {
+    slot += data;
+    slot += '\t';
+  }
+
+  if (slot.size() < (size_t)this->slot_size)
+    slot.append(this->slot_size - slot.size(), ' ');
+  return slot;
+}
+
+void Table::parseRegister(std::string_view slot,
+                          std::vector<std::string_view>& fields) const
+{
+  fields.clear();
+  size_t start = 0;
+  for (size_t i = 0; i < this->columns->size(); i++)
+  {
+    size_t end = slot.find('\t', start);
+    if (end == std::string_view::npos)
+      end = slot.size();
+    fields.push_back(slot.substr(std::min(start, end), end - start));
+    start = end + 1;
+  }
+}
+
+void Table::loadTombstones()
+{
+  for (const auto& tombstones_file : {this->vacuum_path, this->tombstones_path})
+  {
+    std::ifstream file(tombstones_file);
+    std::string filename;
+    while (getline(file, filename))
+      this->tombstones.insert(filename);
+  }
+}
+
+const Index* Table::constraintIndex(Constraint const& constraint) const
+{
+  std::string idx_name = Index::nameFor(constraint.columns);
+  for (const auto& index : *this->indexes)
+    if (index->name == idx_name)
+      return index;
+  return nullptr;
+}
+
+bool Table::isDeleted(std::string const& filename) const
+{
+  return !this->tombstones.empty() && this->tombstones.count(filename);
+}
+
+bool Table::markDeleted(std::vector<std::string> const& filenames)
+{
+  int64_t deleted = 0;
+  for (const auto& filename : filenames)
+    deleted += this->tombstones.insert(filename).second;
+
+  if (!writeTombstones(filenames))
+    return 0;
+  Catalog::instance().count(this->name, -deleted, deleted);
+  return 1;
+}
+
+bool Table::writeTombstones(std::vector<std::string> const& filenames,
+                            bool sync) const
+{
+  std::string data;
+  for (const auto& filename : filenames)
+  {
+    data += filename;
+    data += '\n';
+  }
+  return data.empty() || ft::appendFile(this->tombstones_path, data, sync);
+}
+
+bool Table::readRegister(std::string const& filename, std::string& slot,
+                         std::vector<std::string_view>& fields) const
+{
+  bool read = (this->column_store != nullptr)
+                  ? this->column_store->read(ZoneMap::registerId(filename),
+                                             slot)
+                  : ft::readSlot(this->regs_path + filename, slot);
+  if (read)
+    parseRegister(slot, fields);
+  return read;
+}
+
+bool Table::writeRegister(std::string const& filename,
+                          RegisterData const& reg_data) const
+{
+  return writeRegisters({{&filename, &reg_data}});
+}
+
+bool Table::writeRegisters(
+    std::vector<std::pair<const std::string*, const RegisterData*>> const&
+        regs,
+    bool sync) const
+{
+  // Columnar groups are rewritten once for all their registers
+  if (this->column_store != nullptr)
+  {
+    for (const auto& [filename, reg_data] : regs)
+      this->column_store->add(ZoneMap::registerId(*filename), *reg_data);
+    return this->column_store->save(sync);
+  }
+
+  bool written = 1;
+  for (const auto& [filename, reg_data] : regs)
+    written &= ft::writeSlot(this->regs_path + *filename,
+                             formatRegister(*reg_data), sync);
+  if (sync && !regs.empty())
+    written &= ft::syncDir(this->regs_path);
+  return written;
+}
+
+bool Table::writeSlot(std::string const& filename,
+                      std::string const& slot) const
+{
+  // Replayed images must be on disk before the journal goes away
+  if (this->column_store == nullptr)
+    return ft::writeSlot(this->regs_path + filename, slot, 1) &&
+           ft::syncDir(this->regs_path);
+
+  std::vector<std::string_view> fields;
+  parseRegister(slot, fields);
+  this->column_store->add(ZoneMap::registerId(filename), fields);
+  return this->column_store->save(1);
+}
+
+size_t Table::removeRegisters(std::vector<std::string> const& filenames) const
+{
+  size_t removed = 0;
+  if (this->column_store != nullptr)
+  {
+    for (const auto& filename : filenames)
+      this->column_store->erase(ZoneMap::registerId(filename));
+    return this->column_store->save() ? filenames.size() : 0;
+  }
+
+  for (const auto& filename : filenames)
+    if (remove((this->regs_path + filename).c_str()) == 0)
+      removed++;
+  return removed;
+}
+
+std::vector<std::string> Table::registerFilenames() const
+{
+  std::vector<std::string> filenames;
+  if (this->column_store != nullptr)
+  {
+    for (int reg_id : this->column_store->registerIds())
+      filenames.push_back(std::to_string(reg_id) + ".sqlito");
+    return filenames;
+  }
+
+  for (const auto& entry : fs::directory_iterator(this->regs_path))
+    filenames.push_back(entry.path().filename());
+  return filenames;
+}
+
 Table::~Table()
 {
   delete this->columns;
@@ -0,0 +1,138 @@
+#include "TableCache.hh"
+
+TableCache& TableCache::instance()
+{
+  static TableCache cache;
+  return cache;
+}
+
+void TableCache::configure(size_t max_tables, size_t max_bytes)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->table_limit = max_tables;
+  this->byte_limit = max_bytes;
+  evict();
+}
+
+TableHandle TableCache::get(std::string const& name)
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (1)
+  {
+    auto handle = this->handles.find(name);
+    if (handle != this->handles.end())
+    {
+      this->hits++;
+      this->lru.splice(this->lru.begin(), this->lru, handle->second);
+      return this->lru.front();
+    }
+    if (this->opening.count(name) == 0)
+      break;
+    this->opened.wait(lock);
+  }
+  this->misses++;
+
+  // Tables are opened outside the lock, but only by one session at a time
+  this->opening.insert(name);
+  lock.unlock();
+  std::unique_ptr<Table> table;
+  try
+  {
+    table = std::make_unique<Table>(name);
+  }
+  catch (...)
+  {
+    lock.lock();
+    this->opening.erase(name);
+    this->opened.notify_all();
+    throw;
+  }
+  lock.lock();
+  this->opening.erase(name);
+  this->opened.notify_all();
+
+  // A table created meanwhile was cached by put
+  auto handle = this->handles.find(name);
+  if (handle != this->handles.end())
+    return *handle->second;
+  this->lru.push_front(std::make_shared<std::unique_ptr<Table>>(
+      std::move(table)));
+  this->handles[name] = this->lru.begin();
+  evict();
+  return this->lru.front();
+}
+
+TableHandle TableCache::put(std::unique_ptr<Table> table)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  std::string name = table->name;
+  auto handle = this->handles.find(name);
+  if (handle != this->handles.end())
+  {
+    this->lru.erase(handle->second);
+    this->handles.erase(handle);
+  }
+
+  this->lru.push_front(std::make_shared<std::unique_ptr<Table>>(
+      std::move(table)));
+  this->handles[name] = this->lru.begin();
+  evict();
+  return this->lru.front();
+}
+
+void TableCache::erase(std::string const& name)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto handle = this->handles.find(name);
+  if (handle == this->handles.end())
+    return;
+  this->lru.erase(handle->second);
+  this->handles.erase(handle);
+}
+
+void TableCache::clear()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->handles.clear();
+  this->lru.clear();
+}
+
+size_t TableCache::tables() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->lru.size();
+}
+
+size_t TableCache::used() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return idleBytes();
+}
+
+size_t TableCache::idleBytes() const
+{
+  size_t bytes = 0;
+  for (const auto& handle : this->lru)
+    if (handle.use_count() == 1)
+      bytes += (*handle)->memoryUsage();
+  return bytes;
+}
+
+bool TableCache::overLimits() const
+{
+  return (this->table_limit > 0 && this->lru.size() > this->table_limit) ||
+         (this->byte_limit > 0 && idleBytes() > this->byte_limit);
+}
+
+void TableCache::evict()
+{
+  auto it = this->lru.end();
+  while (this->lru.size() > 1 && --it != this->lru.begin() && overLimits())
+  {
+    if (it->use_count() > 1)
+      continue;
+    this->handles.erase((**it)->name);
+    it = this->lru.erase(it);
+    this->evictions++;
+  }
+}
@@ -0,0 +1,145 @@
+#include "TableLock.hh"
+#include "Settings.hh"
+#include <chrono>
+
+std::mutex TableLock::registry_mutex;
+
+void TableLock::Latch::lock(LockMode mode)
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  if (mode == kLockShared)
+  {
+    this->released.wait(
+        lock, [this] { return !this->writer && this->writers_waiting == 0; });
+    this->readers++;
+    return;
+  }
+
+  this->writers_waiting++;
+  this->released.wait(lock,
+                      [this] { return !this->writer && this->readers == 0; });
+  this->writers_waiting--;
+  this->writer = 1;
+}
+
+void TableLock::Latch::unlock(LockMode mode)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (mode == kLockExclusive)
+      this->writer = 0;
+    else if (--this->readers > 0)
+      return;
+  }
+  this->released.notify_all();
+}
+
+TableLock::Latch& TableLock::of(std::string const& table_name)
+{
+  // Locks are never dropped, since a statement may still be waiting on the
+  // lock of a table that is being dropped
+  static std::map<std::string, std::unique_ptr<Latch>> latches;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto& latch = latches[table_name];
+  if (latch == nullptr)
+    latch = std::make_unique<Latch>();
+  return *latch;
+}
+
+TableLock::TableLock(std::string const& table_name, LockMode mode)
+    : TableLock(std::vector<std::pair<std::string, LockMode>>{
+          {table_name, mode}})
+{
+}
+
+TableLock::TableLock(
+    std::vector<std::pair<std::string, LockMode>> const& tables)
+{
+  std::map<std::string, LockMode> ordered;
+  for (const auto& [table_name, mode] : tables)
+  {
+    auto it = ordered.emplace(table_name, mode).first;
+    if (mode == kLockExclusive)
+      it->second = kLockExclusive;
+  }
+
+  for (const auto& [table_name, mode] : ordered)
+  {
+    Latch& latch = of(table_name);
+    latch.lock(mode);
+    this->held.push_back({&latch, mode});
+  }
+}
+
+TableLock::~TableLock()
+{
+  unlock();
+}
+
+void TableLock::unlock()
+{
+  while (!this->held.empty())
+  {
+    auto [latch, mode] = this->held.back();
+    latch->unlock(mode);
+    this->held.pop_back();
+  }
+}
+
+void TableLock::yield()
+{
+  auto tables = this->held;
+  unlock();
+  for (const auto& [latch, mode] : tables)
+  {
+    latch->lock(mode);
+    this->held.push_back({latch, mode});
+  }
+}
+
+std::mutex TableOwner::mutex;
+std::condition_variable TableOwner::released;
+std::map<std::string, TableOwner::Owner> TableOwner::owners;
+
+TableOwner::TableOwner(std::string const& table_name, TxnId txn,
+                       bool single_statement)
+    : table_name(table_name)
+{
+  int timeout_ms = Settings::get().lock_timeout_ms;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeout_ms);
+  std::unique_lock<std::mutex> lock(mutex);
+  while (1)
+  {
+    auto owner = owners.find(table_name);
+    if (owner == owners.end())
+    {
+      owners[table_name] = {txn, single_statement};
+      return;
+    }
+    // Wait-die holds whatever the timeout
+    if (!single_statement && !owner->second.single_statement &&
+        txn > owner->second.txn)
+      throw DBException{TRANSACTION_CONFLICT, table_name};
+    if (owner->second.single_statement || timeout_ms <= 0)
+    {
+      released.wait(lock);
+      continue;
+    }
+
+    // Only its client can end the owner, and the thread that would run its
+    // COMMIT may be the one waiting here
+    if (released.wait_until(lock, deadline) == std::cv_status::timeout &&
+        owners.count(table_name))
+      throw DBException{LOCK_TIMEOUT, table_name};
+  }
+}
+
+TableOwner::~TableOwner()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    owners.erase(this->table_name);
+  }
+  released.notify_all();
+}
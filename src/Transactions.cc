@@ -0,0 +1,97 @@
+#include "Transactions.hh"
+#include "TableLock.hh"
+#include <algorithm>
+
+bool Snapshot::sees(TxnId txn) const
+{
+  if (txn == this->own || txn < this->xmin)
+    return 1;
+  if (txn >= this->xmax)
+    return 0;
+  return !std::binary_search(this->active.begin(), this->active.end(), txn);
+}
+
+Transactions& Transactions::instance()
+{
+  static Transactions transactions;
+  return transactions;
+}
+
+TxnId Transactions::begin()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  TxnId txn = this->next++;
+  this->active.insert(txn);
+  return txn;
+}
+
+void Transactions::commit(TxnId txn)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->active.erase(txn);
+}
+
+std::shared_ptr<const Snapshot> Transactions::snapshot(TxnId own)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto snapshot = new Snapshot{
+      this->active.empty() ? this->next : *this->active.begin(), this->next,
+      std::vector<TxnId>(this->active.begin(), this->active.end()), own};
+  auto xmin = this->snapshot_xmins.insert(snapshot->xmin);
+
+  return std::shared_ptr<const Snapshot>(
+      snapshot,
+      [this, xmin](const Snapshot* snapshot)
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->snapshot_xmins.erase(xmin);
+        delete snapshot;
+      });
+}
+
+TxnId Transactions::horizon() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  TxnId horizon = this->next;
+  if (!this->active.empty())
+    horizon = std::min(horizon, *this->active.begin());
+  if (!this->snapshot_xmins.empty())
+    horizon = std::min(horizon, *this->snapshot_xmins.begin());
+  return horizon;
+}
+
+bool Transactions::reading() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return !this->snapshot_xmins.empty();
+}
+
+Transaction::Transaction(bool buffered)
+    : id(Transactions::instance().begin()), versioned(buffered),
+      buffered(buffered)
+{
+}
+
+Transaction::~Transaction()
+{
+  end();
+}
+
+void Transaction::own(Table* table, std::string const& table_name)
+{
+  if (this->tables.count(table_name))
+    return;
+  this->owners.push_back(
+      std::make_unique<TableOwner>(table_name, this->id, !this->buffered));
+  this->tables[table_name] = table;
+}
+
+void Transaction::end()
+{
+  if (this->ended)
+    return;
+  this->ended = 1;
+  Transactions::instance().commit(this->id);
+  this->owners.clear();
+  this->tables.clear();
+}
@@ -0,0 +1,169 @@
+#include "Vacuum.hh"
+#include "Table.hh"
+#include "TableCache.hh"
+#include "TableLock.hh"
+#include "VersionStore.hh"
+#include "filestruct.hh"
+#include "flaviadb_definitions.hh"
+#include <chrono>
+
+namespace fs = std::filesystem;
+namespace ft = ftools;
+
+Vacuum& Vacuum::instance()
+{
+  static Vacuum vacuum;
+  return vacuum;
+}
+
+Vacuum::~Vacuum()
+{
+  stop();
+}
+
+void Vacuum::start(size_t batch_rows, int delay_ms)
+{
+  if (this->running)
+    return;
+
+  this->batch_rows = batch_rows;
+  this->delay_ms = delay_ms;
+  this->running = 1;
+  this->stopping = 0;
+  this->worker = std::thread(&Vacuum::work, this);
+
+  // Tombstones left by earlier sessions
+  for (const auto& table : Catalog::instance().tables())
+  {
+    std::string path = ft::getTablePath(table);
+    if (ft::fileExists(path + "tombstones.dat") ||
+        ft::fileExists(path + "tombstones.vacuum"))
+      schedule(table);
+  }
+}
+
+void Vacuum::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->queue_mutex);
+    if (!this->running)
+      return;
+    this->running = 0;
+    this->stopping = 1;
+  }
+  this->queue_cv.notify_one();
+  this->worker.join();
+}
+
+void Vacuum::schedule(std::string const& table_name)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->queue_mutex);
+    if (!this->running)
+      return;
+    this->pending.insert(table_name);
+  }
+  this->queue_cv.notify_one();
+}
+
+void Vacuum::work()
+{
+  std::unique_lock<std::mutex> lock(this->queue_mutex);
+  while (this->running)
+  {
+    if (this->pending.empty())
+    {
+      this->queue_cv.wait(lock);
+      continue;
+    }
+
+    std::string table_name = *this->pending.begin();
+    this->pending.erase(this->pending.begin());
+    lock.unlock();
+    try
+    {
+      vacuum_table(table_name, this->batch_rows, this->delay_ms);
+    }
+    catch (const DBException& e)
+    {
+    }
+    lock.lock();
+  }
+}
+
+size_t Vacuum::vacuum_table(std::string const& table_name, size_t batch_rows,
+                            int delay_ms)
+{
+  // Versions every snapshot can see past go first
+  VersionStore::get(table_name)->collect(Transactions::instance().horizon());
+
+  // The handle statements use, so its indexes and tombstones follow
+  TableHandle handle;
+  std::vector<std::string> filenames;
+  {
+    TableLock lock(table_name, kLockExclusive);
+    if (!ft::dirExists(ft::getTablePath(table_name)))
+      return 0;
+    handle = TableCache::instance().get(table_name);
+    auto& table = *handle;
+
+    // An interrupted pass is resumed before taking new tombstones
+    if (!ft::fileExists(table->vacuum_path))
+    {
+      if (!ft::fileExists(table->tombstones_path))
+        return 0;
+      rename(table->tombstones_path.c_str(), table->vacuum_path.c_str());
+    }
+
+    std::ifstream vacuum_file(table->vacuum_path);
+    std::string filename;
+    while (getline(vacuum_file, filename))
+      filenames.push_back(filename);
+  }
+
+  auto& table = *handle;
+  if (batch_rows == 0)
+    batch_rows = filenames.size();
+
+  size_t reclaimed = 0;
+  std::string slot;
+  std::vector<std::string_view> reg_data;
+  for (size_t first = 0; first < filenames.size(); first += batch_rows)
+  {
+    if (first > 0 && delay_ms > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    if (instance().stopping)
+      return reclaimed;
+
+    TableLock lock(table_name, kLockExclusive);
+    // The table was dropped (and maybe recreated) between batches
+    if (!ft::fileExists(table->vacuum_path))
+      return reclaimed;
+
+    // Index entries go first, so a pass interrupted here can be redone
+    std::vector<std::string> batch(filenames.begin() + first,
+                                   filenames.begin() +
+                                       std::min(first + batch_rows,
+                                                filenames.size()));
+    for (const auto& filename : batch)
+      if (!table->indexes->empty() &&
+          table->readRegister(filename, slot, reg_data))
+        for (const auto& index : *table->indexes)
+          index->remove(index->key(reg_data), filename);
+
+    size_t removed = table->removeRegisters(batch);
+    Catalog::instance().count(table_name, 0, -(int64_t)removed);
+    reclaimed += removed;
+
+    // Their tombstones can go once no register in memory needs hiding
+    if (table->lingering && table->scans == 0)
+      table->purgeDeleted();
+    if (!table->lingering)
+      for (const auto& filename : batch)
+        table->tombstones.erase(filename);
+  }
+
+  TableLock lock(table_name, kLockExclusive);
+  remove(table->vacuum_path.c_str());
+  return reclaimed;
+}
@@ -0,0 +1,115 @@
+#include "VersionStore.hh"
+
+std::mutex VersionStore::registry_mutex;
+
+std::map<std::string, std::shared_ptr<VersionStore>>& VersionStore::registry()
+{
+  static std::map<std::string, std::shared_ptr<VersionStore>> stores;
+  return stores;
+}
+
+std::shared_ptr<VersionStore> VersionStore::get(std::string const& table_name)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto& store = registry()[table_name];
+  if (store == nullptr)
+    store = std::make_shared<VersionStore>();
+  return store;
+}
+
+void VersionStore::forget(std::string const& table_name)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry().erase(table_name);
+}
+
+void VersionStore::record(TxnId txn, std::string const& filename,
+                          const std::vector<std::string>* before)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  // A transaction changing a register twice only keeps its first version
+  auto& chain = this->chains[filename];
+  if (!chain.empty() && chain.back().txn == txn)
+    return;
+
+  chain.push_back({txn, before != nullptr,
+                   before != nullptr ? *before : std::vector<std::string>()});
+  this->log.push_back({txn, filename});
+  this->recorded++;
+}
+
+bool VersionStore::unseen(Snapshot const& snapshot) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return !this->log.empty() && !snapshot.sees(this->log.back().first);
+}
+
+std::vector<std::string> VersionStore::changed(Snapshot const& snapshot) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  std::vector<std::string> filenames;
+  // Transactions come in order, so the unseen ones are at the end
+  for (auto it = this->log.rbegin();
+       it != this->log.rend() && it->first >= snapshot.xmin; ++it)
+    if (!snapshot.sees(it->first))
+      filenames.push_back(it->second);
+  return filenames;
+}
+
+Visibility VersionStore::visible(Snapshot const& snapshot,
+                                 std::string const& filename,
+                                 std::vector<std::string>& image) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto chain = this->chains.find(filename);
+  if (chain == this->chains.end())
+    return kVisibleStored;
+
+  // Changes the snapshot doesn't see are undone from the newest one
+  const Version* oldest_unseen = nullptr;
+  for (auto it = chain->second.rbegin(); it != chain->second.rend(); ++it)
+  {
+    if (snapshot.sees(it->txn))
+      break;
+    oldest_unseen = &*it;
+  }
+
+  if (oldest_unseen == nullptr)
+    return kVisibleStored;
+  if (!oldest_unseen->existed)
+    return kVisibleNone;
+  image = oldest_unseen->before;
+  return kVisibleOlder;
+}
+
+void VersionStore::collect(TxnId horizon)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  while (!this->log.empty() && this->log.front().first < horizon)
+  {
+    auto chain = this->chains.find(this->log.front().second);
+    chain->second.pop_front();
+    if (chain->second.empty())
+      this->chains.erase(chain);
+    this->log.pop_front();
+  }
+}
+
+void VersionStore::discard(TxnId txn)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  while (!this->log.empty() && this->log.back().first == txn)
+  {
+    auto chain = this->chains.find(this->log.back().second);
+    chain->second.pop_back();
+    if (chain->second.empty())
+      this->chains.erase(chain);
+    this->log.pop_back();
+  }
+}
+
+size_t VersionStore::size() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->log.size();
+}
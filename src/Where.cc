@@ -1,7 +1,65 @@
 #include "Where.hh"
+#include "Output.hh"
+#include <charconv>
+
+bool dateToDays(std::string_view value, int32_t& days)
+{
+  char date[11] = {0};
+  struct tm tm = {0};
+  if (value.size() > 10)
+    return 0;
+  value.copy(date, value.size());
+  if (!strptime(date, DATE_FORMAT, &tm))
+    return 0;
+
+  // Civil calendar to day number, without going through the time zone
+  int year = tm.tm_year + 1900 - (tm.tm_mon < 2);
+  int era = (year >= 0 ? year : year - 399) / 400;
+  int year_of_era = year - era * 400;
+  int month = tm.tm_mon + 1;
+  int day_of_year =
+      (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + tm.tm_mday - 1;
+  int day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  days = era * 146097 + day_of_era - 719468;
+  return 1;
+}
+
+std::string daysToDate(int32_t days)
+{
+  int shifted = days + 719468;
+  int era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+  int day_of_era = shifted - era * 146097;
+  int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+                     day_of_era / 146096) /
+                    365;
+  int day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  int shifted_month = (5 * day_of_year + 2) / 153;
+  int day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+  int month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+  int year = year_of_era + era * 400 + (month <= 2);
+
+  char date[32];
+  snprintf(date, sizeof(date), "%02d-%02d-%d", day, month, year);
+  return date;
+}
+
+std::string formatDate(std::string_view days)
+{
+  int32_t number;
+  auto [end, error] =
+      std::from_chars(days.data(), days.data() + days.size(), number);
+  if (error != std::errc() || end != days.data() + days.size())
+    return std::string(days);
+  return daysToDate(number);
+}
 
 Where* Where::get(hsql::Expr* const& where_clause, hsql::DataType data_type)
 {
+  if (where_clause == nullptr)
+    return new NullWhere();
+
   switch (data_type)
   {
   case hsql::DataType::INT:
@@ -43,13 +101,11 @@ WhereInt::WhereInt(hsql::Expr* const& where_clause)
   this->value = where_clause->expr2->ival;
 }
 
-bool WhereInt::compare(std::string data)
+bool WhereInt::compare(std::string_view data)
 {
-  comparison_result = stoi(data) - value;
-  if (comparison_result < 0)
-    comparison_result = -1;
-  else if (comparison_result > 0)
-    comparison_result = 1;
+  int data_value = 0;
+  std::from_chars(data.data(), data.data() + data.size(), data_value);
+  comparison_result = (data_value > value) - (data_value < value);
 
   return compare_helper();
 }
@@ -60,7 +116,7 @@ WhereChar::WhereChar(hsql::Expr* const& where_clause)
   this->value = where_clause->expr2->name;
 }
 
-bool WhereChar::compare(std::string data)
+bool WhereChar::compare(std::string_view data)
 {
   comparison_result = value.compare(data);
   if (comparison_result < 0)
@@ -74,36 +130,21 @@ bool WhereChar::compare(std::string data)
 WhereDate::WhereDate(hsql::Expr* const& where_clause)
 {
   this->opType = where_clause->opType;
-  this->date = where_clause->expr2->name;
-}
-
-short int WhereDate::compareToDate(std::string otherDate)
-{
-  struct tm data_time = {0};
-  struct tm expr_time = {0};
-
-  strptime(otherDate.c_str(), DATE_FORMAT, &data_time);
-  strptime(date.c_str(), DATE_FORMAT, &expr_time);
-
-  double diff = difftime(mktime(&data_time), mktime(&expr_time));
-
-  if (diff < 0)
-    return -1;
-  if (diff == 0)
-    return 0;
-  return 1;
+  dateToDays(where_clause->expr2->name, this->days);
 }
 
-bool WhereDate::compare(std::string data)
+bool WhereDate::compare(std::string_view data)
 {
-  comparison_result = compareToDate(data);
+  int32_t data_days = 0;
+  std::from_chars(data.data(), data.data() + data.size(), data_days);
+  comparison_result = (data_days > days) - (data_days < days);
 
   return compare_helper();
 }
 
 NullWhere::NullWhere(){}
 
-bool NullWhere::compare(std::string data)
+bool NullWhere::compare(std::string_view data)
 {
   return true;
 }
@@ -111,22 +152,32 @@ bool NullWhere::compare(std::string data)
 bool valid_where(const hsql::Expr* where, int* where_column_pos,
                  hsql::DataType* column_data_type, std::unique_ptr<Table> const& table)
 {
+  // Without WHERE every register matches. NullWhere ignores the column
   if (where == nullptr)
+  {
+    *where_column_pos = 0;
     return 1;
+  }
+
+  if (where->opType == hsql::kOpOr)
+  {
+    output::err() << "ERROR: WHERE conditions can only be joined by AND.\n";
+    return 0;
+  }
 
   // Check WHERE clause correctness
   // Check left hand expression is a ColumnRef
   if (where->expr->type != hsql::kExprColumnRef)
   {
-    fprintf(stderr, "ERROR: Left hand expression of WHERE clause must be a "
-                    "column reference.\n");
+    output::err() << "ERROR: Left hand expression of WHERE clause must be a "
+                     "column reference.\n";
     return 0;
   }
 
   // Check if operator is =, !=, <, <=, >, >=
   if (where->opType < 10 || where->opType > 15)
   {
-    fprintf(stderr, "ERROR: Unknown operator.\n");
+    output::err() << "ERROR: Unknown operator.\n";
     return 0;
   }
 
@@ -134,7 +185,7 @@ bool valid_where(const hsql::Expr* where, int* where_column_pos,
   if (where->expr2->type != hsql::kExprLiteralInt &&
       where->expr2->type != hsql::kExprLiteralString)
   {
-    fprintf(stderr, "ERROR: Unknown right hand expression.\n");
+    output::err() << "ERROR: Unknown right hand expression.\n";
     return 0;
   }
 
@@ -160,15 +211,29 @@ bool valid_where(const hsql::Expr* where, int* where_column_pos,
        *column_data_type != hsql::DataType::INT))
     throw DBException{INVALID_DATA_TYPE, table->name, where->expr->name};
 
-  if (*column_data_type == hsql::DataType::DATE)
-  {
-    if (strlen(where->expr2->name) > 10)
-      throw DBException{INVALID_DATE, table->name, where->expr2->name};
+  // Dates are parsed here once, into the day number WhereDate compares
+  int32_t days;
+  if (*column_data_type == hsql::DataType::DATE &&
+      !dateToDays(where->expr2->name, days))
+    throw DBException{INVALID_DATE, table->name, where->expr2->name};
 
-    struct tm tm = {0};
-    if (!strptime(where->expr2->name, DATE_FORMAT, &tm))
-      throw DBException{INVALID_DATE, table->name, where->expr->name};
-  }
+  return 1;
+}
+
+bool WhereClause::parse(hsql::Expr* where, std::unique_ptr<Table> const& table)
+{
+  if (where == nullptr)
+    return 1;
+
+  if (where->opType == hsql::kOpAnd)
+    return parse(where->expr, table) && parse(where->expr2, table);
+
+  int column_pos;
+  hsql::DataType data_type;
+  if (!valid_where(where, &column_pos, &data_type, table))
+    return 0;
 
+  this->predicates.push_back(
+      {column_pos, where, std::unique_ptr<Where>(Where::get(where, data_type))});
   return 1;
 }
@@ -0,0 +1,219 @@
+#include "ZoneMap.hh"
+#include "Where.hh"
+#include "filestruct.hh"
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ft = ftools;
+
+ZoneMap::ZoneMap(std::string const& table_path,
+                 std::vector<hsql::ColumnDefinition*> const* columns)
+    : path(table_path + "zonemap.dat")
+{
+  for (size_t i = 0; i < columns->size(); i++)
+  {
+    hsql::DataType type = columns->at(i)->type.data_type;
+    if (type == hsql::DataType::INT || type == hsql::DataType::DATE)
+    {
+      zone_columns.push_back(i);
+      zone_types.push_back(type);
+    }
+  }
+
+  int fd = open(this->path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  if (pread(fd, &this->header, sizeof(Header), 0) != sizeof(Header) ||
+      this->header.group_rows == 0)
+    this->header = Header{};
+  close(fd);
+}
+
+void ZoneMap::create(std::string const& table_path, uint32_t group_rows)
+{
+  Header header{MAGIC, group_rows, 0};
+  ft::writeFile(table_path + "zonemap.dat",
+                std::string((const char*)&header, sizeof(Header)));
+}
+
+int ZoneMap::registerId(std::string const& filename)
+{
+  int reg_id = 0;
+  std::from_chars(filename.data(), filename.data() + filename.size(), reg_id);
+  return reg_id;
+}
+
+size_t ZoneMap::recordSize() const
+{
+  return sizeof(uint32_t) + zone_columns.size() * sizeof(Range);
+}
+
+bool ZoneMap::toValue(std::string_view value, int32_t& number)
+{
+  return std::from_chars(value.data(), value.data() + value.size(), number)
+             .ec == std::errc();
+}
+
+void ZoneMap::widen(Record& record, size_t column, std::string_view value) const
+{
+  if (record.ranges.empty())
+    record.ranges.assign(zone_columns.size(), Range{INT32_MAX, INT32_MIN});
+
+  // A value that can't be read leaves the column unbounded
+  int32_t number;
+  Range& range = record.ranges[column];
+  if (!toValue(value, number))
+    range = Range{INT32_MIN, INT32_MAX};
+  else
+  {
+    range.min = std::min(range.min, number);
+    range.max = std::max(range.max, number);
+  }
+}
+
+std::vector<ZoneMap::Record> ZoneMap::load() const
+{
+  std::string data;
+  std::vector<Record> records;
+  if (!exists() || !ft::readSlot(this->path, data) ||
+      data.size() < sizeof(Header))
+    return records;
+
+  size_t record_size = recordSize();
+  for (size_t offset = sizeof(Header); offset + record_size <= data.size();
+       offset += record_size)
+  {
+    Record& record = records.emplace_back();
+    memcpy(&record.rows, data.data() + offset, sizeof(uint32_t));
+    record.ranges.resize(zone_columns.size());
+    memcpy(record.ranges.data(), data.data() + offset + sizeof(uint32_t),
+           zone_columns.size() * sizeof(Range));
+  }
+  return records;
+}
+
+bool ZoneMap::save()
+{
+  if (!exists() || this->pending.empty())
+    return 1;
+
+  int fd = open(this->path.c_str(), O_RDWR);
+  if (fd < 0)
+    return 0;
+
+  // Each changed group is merged with its record on disk, so other handles
+  // on the table never lose their widenings
+  size_t record_size = recordSize();
+  std::string buffer(record_size, '\0');
+  bool written = 1;
+  for (auto& [group, record] : this->pending)
+  {
+    off_t offset = sizeof(Header) + (off_t)group * record_size;
+    uint32_t rows = 0;
+    std::vector<Range> ranges(zone_columns.size());
+    if (pread(fd, buffer.data(), record_size, offset) == (ssize_t)record_size)
+    {
+      memcpy(&rows, buffer.data(), sizeof(uint32_t));
+      memcpy(ranges.data(), buffer.data() + sizeof(uint32_t),
+             zone_columns.size() * sizeof(Range));
+    }
+
+    for (size_t i = 0; i < ranges.size(); i++)
+      ranges[i] = (rows == 0) ? record.ranges[i]
+                              : Range{std::min(ranges[i].min,
+                                               record.ranges[i].min),
+                                      std::max(ranges[i].max,
+                                               record.ranges[i].max)};
+    rows += record.rows;
+
+    memcpy(buffer.data(), &rows, sizeof(uint32_t));
+    memcpy(buffer.data() + sizeof(uint32_t), ranges.data(),
+           ranges.size() * sizeof(Range));
+    written &= pwrite(fd, buffer.data(), record_size, offset) ==
+               (ssize_t)record_size;
+  }
+
+  close(fd);
+  this->pending.clear();
+  return written;
+}
+
+std::vector<bool> ZoneMap::candidates(WhereClause const& clause) const
+{
+  std::vector<Record> records = load();
+  std::vector<bool> groups(records.size(), 1);
+  bool pruned = 0;
+  for (size_t g = 0; g < records.size(); g++)
+    if (records[g].rows == 0)
+    {
+      groups[g] = 0;
+      pruned = 1;
+    }
+
+  for (const auto& predicate : clause.predicates)
+  {
+    auto column = std::find(zone_columns.begin(), zone_columns.end(),
+                            predicate.column_pos);
+    if (column == zone_columns.end())
+      continue;
+    size_t i = column - zone_columns.begin();
+
+    const hsql::Expr* literal = predicate.expr->expr2;
+    int32_t value;
+    if (literal->type == hsql::kExprLiteralInt)
+    {
+      if (literal->ival < INT32_MIN || literal->ival > INT32_MAX)
+        continue;
+      value = literal->ival;
+    }
+    else if (zone_types[i] != hsql::DataType::DATE ||
+             !dateToDays(literal->name, value))
+      continue;
+
+    for (size_t g = 0; g < records.size(); g++)
+    {
+      if (!groups[g])
+        continue;
+
+      const Range& range = records[g].ranges[i];
+      bool may_match = 1;
+      switch (predicate.expr->opType)
+      {
+      case hsql::kOpEquals:
+        may_match = range.min <= value && value <= range.max;
+        break;
+      case hsql::kOpNotEquals:
+        may_match = range.min != value || range.max != value;
+        break;
+      case hsql::kOpLess:
+        may_match = range.min < value;
+        break;
+      case hsql::kOpLessEq:
+        may_match = range.min <= value;
+        break;
+      case hsql::kOpGreater:
+        may_match = range.max > value;
+        break;
+      case hsql::kOpGreaterEq:
+        may_match = range.max >= value;
+        break;
+      default:
+        break;
+      }
+
+      if (!may_match)
+      {
+        groups[g] = 0;
+        pruned = 1;
+      }
+    }
+  }
+
+  if (!pruned)
+    groups.clear();
+  return groups;
+}
@@ -1,4 +1,6 @@
 #include "filestruct.hh"
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace ftools
 {
@@ -58,14 +60,14 @@ std::string getRegCountPath(std::string const& tableName)
   return FLAVIADB_TEST_DB + tableName + "/reg_count.dat";
 }
 
-std::string getNewRegPath(std::string const& tableName)
+int getRegCount(std::string const& tableName)
 {
   std::string reg_count_file_path = FLAVIADB_TEST_DB + tableName + "/reg_count.dat";
   std::ifstream rCount(reg_count_file_path);
   if (!rCount.is_open())
   {
     fprintf(stderr, "ERROR: Couldn't read %s.\n", reg_count_file_path.c_str());
-    return nullptr;
+    return -1;
   }
 
   int count;
@@ -74,30 +76,81 @@ std::string getNewRegPath(std::string const& tableName)
   rCount.close();
   count = stoi(data);
 
-  std::string reg_path = getRegistersPath(tableName) + std::to_string(++count) + ".sqlito";
+  return count;
+}
 
-  std::ofstream wCount(reg_count_file_path);
-  wCount << count;
+bool setRegCount(std::string const& tableName, int count)
+{
+  std::string path = getRegCountPath(tableName);
+  return writeFile(path + ".tmp", std::to_string(count), 1) &&
+         rename((path + ".tmp").c_str(), path.c_str()) == 0 &&
+         syncDir(getTablePath(tableName));
+}
 
-  return reg_path;
+bool writeSlot(std::string const& path, std::string const& slot, bool sync)
+{
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return 0;
+
+  bool written =
+      pwrite(fd, slot.data(), slot.size(), 0) == (ssize_t)slot.size() &&
+      (!sync || fsync(fd) == 0);
+  close(fd);
+  return written;
 }
 
-int getRegCount(std::string const& tableName)
+bool readSlot(std::string const& path, std::string& buffer)
 {
-  std::string reg_count_file_path = FLAVIADB_TEST_DB + tableName + "/reg_count.dat";
-  std::ifstream rCount(reg_count_file_path);
-  if (!rCount.is_open())
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0)
   {
-    fprintf(stderr, "ERROR: Couldn't read %s.\n", reg_count_file_path.c_str());
-    return -1;
+    close(fd);
+    return 0;
   }
 
-  int count;
-  std::string data;
-  getline(rCount, data);
-  rCount.close();
-  count = stoi(data);
+  buffer.resize(info.st_size);
+  bool read = pread(fd, buffer.data(), buffer.size(), 0) == info.st_size;
+  close(fd);
+  return read;
+}
 
-  return count;
+bool writeFile(std::string const& path, std::string const& data, bool sync)
+{
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return 0;
+
+  bool written = write(fd, data.data(), data.size()) == (ssize_t)data.size() &&
+                 (!sync || fsync(fd) == 0);
+  close(fd);
+  return written;
+}
+
+bool appendFile(std::string const& path, std::string const& data, bool sync)
+{
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return 0;
+
+  bool written = write(fd, data.data(), data.size()) == (ssize_t)data.size() &&
+                 (!sync || fsync(fd) == 0);
+  close(fd);
+  return written;
+}
+
+bool syncDir(std::string const& path)
+{
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+    return 0;
+
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
 }
 }
@@ -0,0 +1,82 @@
+#include "Client.hh"
+#include "DBException.hh"
+#include "flaviadb_definitions.hh"
+#include <iostream>
+#include <memory>
+#include <readline/history.h>
+#include <readline/readline.h>
+#include <unistd.h>    // getopt
+
+int main(int argc, char** argv)
+{
+  std::string socket_path = FLAVIADB_SOCKET;
+  std::string host = "127.0.0.1";
+  std::string query_arg;
+  int port = -1;
+  int option;
+  while ((option = getopt(argc, argv, "s:h:p:e:")) != -1)
+  {
+    if (option == 's')
+      socket_path = optarg;
+    else if (option == 'h')
+      host = optarg;
+    else if (option == 'p')
+      port = atoi(optarg);
+    else if (option == 'e')
+      query_arg = optarg;
+    else
+    {
+      fprintf(stderr,
+              "Usage: %s [-s socket_path | -h host -p port] [-e query]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  try
+  {
+    std::unique_ptr<Client> client;
+    if (port >= 0)
+      client = std::make_unique<Client>(host, uint16_t(port));
+    else
+      client = std::make_unique<Client>(socket_path);
+
+    // Runs the one query given and leaves
+    if (!query_arg.empty())
+    {
+      std::cout << client->query(query_arg);
+      return 0;
+    }
+
+    std::string query_str;
+    while (1)
+    {
+      // Queries may span lines, and are sent once they end with ';'
+      char* query =
+          (query_str.empty()) ? readline("FlaviaDB> ") : readline("\t-> ");
+
+      if (!query)
+        break;
+
+      query_str += query;
+      if (*query && query_str.back() == ';')
+      {
+        std::cout << client->query(query_str);
+        std::cout.flush();
+        add_history(query_str.c_str());
+        query_str.clear();
+      }
+      else
+        query_str += "\n";
+
+      free(query);
+    }
+  }
+  catch (const DBException& e)
+  {
+    std::cerr << e.what();
+    return 1;
+  }
+
+  return 0;
+}
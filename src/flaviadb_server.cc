@@ -0,0 +1,98 @@
+#include "Catalog.hh"
+#include "DBException.hh"
+#include "ResultCache.hh"
+#include "Server.hh"
+#include "Settings.hh"
+#include "TableCache.hh"
+#include "Vacuum.hh"
+#include "filestruct.hh"
+#include "flaviadb_definitions.hh"
+#include "printutils.hh"
+#include <csignal>
+#include <iostream>
+#include <thread>
+#include <unistd.h>    // getopt
+
+namespace ft = ftools;
+namespace pu = printUtils;
+
+int main(int argc, char** argv)
+{
+  std::string socket_path = FLAVIADB_SOCKET;
+  int port = -1;
+  int option;
+  while ((option = getopt(argc, argv, "s:p:")) != -1)
+  {
+    if (option == 's')
+      socket_path = optarg;
+    else if (option == 'p')
+      port = atoi(optarg);
+    else
+    {
+      fprintf(stderr, "Usage: %s [-s socket_path | -p port]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // Blocked before any thread starts, so only the one waiting for them
+  // ever sees SIGINT and SIGTERM
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  if (!ft::dirExists(FLAVIADB_DIR))
+    ft::createFolder(FLAVIADB_DIR);
+  if (!ft::dirExists(FLAVIADB_TEST_DB))
+    ft::createFolder(FLAVIADB_TEST_DB);
+
+  Settings::get().load_from_env();
+  Catalog::instance().open();
+  if (Settings::get().result_cache_bytes > 0)
+    ResultCache::instance().enable(Settings::get().result_cache_bytes);
+  TableCache::instance().configure(Settings::get().table_cache_tables,
+                                   Settings::get().table_cache_bytes);
+  if (Settings::get().vacuum_batch_rows > 0)
+    Vacuum::instance().start(Settings::get().vacuum_batch_rows,
+                             Settings::get().vacuum_delay_ms);
+
+  std::unique_ptr<Server> server;
+  try
+  {
+    size_t workers = Settings::get().server_workers;
+    if (port >= 0)
+      server = std::make_unique<Server>(uint16_t(port), workers);
+    else
+      server = std::make_unique<Server>(socket_path, workers);
+  }
+  catch (const DBException& e)
+  {
+    std::cerr << e.what();
+    return 1;
+  }
+
+  std::thread([&server, signals] {
+    int signal;
+    sigwait(&signals, &signal);
+    server->stop();
+  }).detach();
+
+  if (port >= 0)
+    std::cout << "FlaviaDB listening on 127.0.0.1:" << server->port() << "\n";
+  else
+    std::cout << "FlaviaDB listening on " << socket_path << "\n";
+  std::cout.flush();
+  server->run();
+
+  // Waits for running queries and rolls back open transactions
+  server.reset();
+  Vacuum::instance().stop();
+  if (ResultCache::instance().enabled())
+    pu::print_cache_stats(ResultCache::instance());
+  if (Settings::get().table_cache_stats)
+    pu::print_table_cache_stats(TableCache::instance());
+  TableCache::instance().clear();
+
+  return 0;
+}
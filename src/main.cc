@@ -1,25 +1,20 @@
-#include "DBException.hh"
-#include "Processor.hh"
-#include "Table.hh"
+#include "Catalog.hh"
+#include "ResultCache.hh"
+#include "Session.hh"
+#include "Settings.hh"
+#include "TableCache.hh"
+#include "Vacuum.hh"
 #include "filestruct.hh"
 #include "flaviadb_definitions.hh"
 #include "printutils.hh"
-#include <filesystem>
-#include <fstream>                  // ifstream, ofstream
-#include <hsql/SQLParser.h>         // Include SQL Parser
-#include <hsql/util/sqlhelper.h>    // Contains printing utilities
 #include <iostream>
-#include <map>
 #include <readline/history.h>
 #include <readline/readline.h>
 #include <sys/stat.h>    // stat, mkdir
 
-namespace fs = std::filesystem;
 namespace ft = ftools;
 namespace pu = printUtils;
 
-std::map<std::string, std::unique_ptr<Table>> tables{};
-
 int main()
 {
   if (!ft::dirExists(FLAVIADB_DIR))
@@ -27,8 +22,19 @@ int main()
   if (!ft::dirExists(FLAVIADB_TEST_DB))
     ft::createFolder(FLAVIADB_TEST_DB);
 
+  Settings::get().load_from_env();
+  Catalog::instance().open();
+  if (Settings::get().result_cache_bytes > 0)
+    ResultCache::instance().enable(Settings::get().result_cache_bytes);
+  TableCache::instance().configure(Settings::get().table_cache_tables,
+                                   Settings::get().table_cache_bytes);
+  if (Settings::get().vacuum_batch_rows > 0)
+    Vacuum::instance().start(Settings::get().vacuum_batch_rows,
+                             Settings::get().vacuum_delay_ms);
+
   pu::print_welcome_message();
 
+  Session session;
   std::string query_str;
   while (1)
   {
@@ -45,222 +51,7 @@ int main()
     query_str += query;
     if (*query && query_str.back() == ';')
     {
-      hsql::SQLParserResult* result = new hsql::SQLParserResult;
-      hsql::SQLParser::parse(query_str, result);
-
-      if (result->isValid() && result->size())
-      {
-        for (size_t i = 0; i < result->size(); i++)
-        {
-          const hsql::SQLStatement* statement = result->getStatement(i);
-
-          switch (statement->type())
-          {
-          case hsql::kStmtSelect:
-          {
-            auto select_stmt = (hsql::SelectStatement*)statement;
-
-            if (select_stmt->fromTable != nullptr)
-            {
-              try
-              {
-                auto table_name{select_stmt->fromTable->name};
-                auto table_it = tables.find(table_name);
-                if (table_it == tables.end())
-                {
-                  auto [pair, inserted] = tables.insert(
-                      {table_name, std::make_unique<Table>(table_name)});
-                  table_it = pair;
-                }
-                Processor::show_records(select_stmt, table_it->second);
-              }
-              catch (const DBException& e)
-              {
-                std::cout << e.what() << "\n";
-              }
-            }
-            else
-              fprintf(stderr, "ERROR: No source table was specified.\n");
-
-            break;
-          }
-          case hsql::kStmtInsert:
-          {
-            auto insert_stmt = (hsql::InsertStatement*)statement;
-
-            try
-            {
-              auto table_it = tables.find(insert_stmt->tableName);
-              if (table_it == tables.end())
-              {
-                auto [pair, inserted] = tables.insert(
-                    {insert_stmt->tableName,
-                     std::make_unique<Table>(insert_stmt->tableName)});
-                table_it = pair;
-              }
-              Processor::insert_record(insert_stmt, table_it->second);
-            }
-            catch (const DBException& e)
-            {
-              std::cout << e.what() << "\n";
-            }
-
-            break;
-          }
-          case hsql::kStmtUpdate:
-          {
-            auto update_stmt = (hsql::UpdateStatement*)statement;
-
-            try
-            {
-              auto table_it = tables.find(update_stmt->table->name);
-              if (table_it == tables.end())
-              {
-                auto [pair, inserted] = tables.insert(
-                    {update_stmt->table->name,
-                     std::make_unique<Table>(update_stmt->table->name)});
-                table_it = pair;
-              }
-              Processor::update_records(update_stmt, table_it->second);
-            }
-            catch (const DBException& e)
-            {
-              std::cout << e.what() << "\n";
-            }
-
-            break;
-          }
-          case hsql::kStmtDelete:
-          {
-            auto delete_stmt = (hsql::DeleteStatement*)statement;
-
-            try
-            {
-              auto table_it = tables.find(delete_stmt->tableName);
-              if (table_it == tables.end())
-              {
-                auto [pair, inserted] = tables.insert(
-                    {delete_stmt->tableName,
-                     std::make_unique<Table>(delete_stmt->tableName)});
-                table_it = pair;
-              }
-              Processor::delete_records(delete_stmt, table_it->second);
-            }
-            catch (const DBException& e)
-            {
-              std::cout << e.what() << "\n";
-            }
-
-            break;
-          }
-          case hsql::kStmtCreate:
-          {
-            auto create_stmt = (hsql::CreateStatement*)statement;
-            std::string table_path = ft::getTablePath(create_stmt->tableName);
-
-            if (create_stmt->type == hsql::kCreateTable)
-            {
-              if (!ft::dirExists(table_path))
-              {
-                tables.insert({create_stmt->tableName,
-                               std::make_unique<Table>(create_stmt->tableName,
-                                                       create_stmt->columns)});
-              }
-              else
-                fprintf(stderr, "Table named %s already exists!\n",
-                        create_stmt->tableName);
-            }
-            else if (create_stmt->type == hsql::kCreateIndex)
-            {
-              try
-              {
-                auto table_it = tables.find(create_stmt->tableName);
-                if (table_it == tables.end())
-                {
-                  auto [pair, inserted] = tables.insert(
-                      {create_stmt->tableName,
-                       std::make_unique<Table>(create_stmt->tableName)});
-                  table_it = pair;
-                }
-                Processor::create_index(create_stmt->columns->at(0)->name,
-                                        table_it->second);
-              }
-              catch (const DBException& e)
-              {
-                std::cout << e.what() << "\n";
-              }
-            }
-
-            break;
-          }
-          case hsql::kStmtDrop:
-          {
-            auto drop_stmt = (hsql::DropStatement*)statement;
-
-            try
-            {
-              auto table_it = tables.find(drop_stmt->name);
-              if (table_it == tables.end())
-              {
-                auto [pair, inserted] =
-                    tables.insert({drop_stmt->name,
-                                   std::make_unique<Table>(drop_stmt->name)});
-                table_it = pair;
-              }
-              Processor::drop_table(table_it->second);
-            }
-            catch (const DBException& e)
-            {
-              std::cout << e.what() << "\n";
-            }
-
-            break;
-          }
-          case hsql::kStmtShow:    // DESCRIBE
-          {
-            auto show_stmt = (hsql::ShowStatement*)statement;
-
-            if (show_stmt->type == hsql::ShowType::kShowTables)
-            {
-              std::vector<std::string> tables;
-              for (const auto& table : fs::directory_iterator(FLAVIADB_TEST_DB))
-                tables.push_back(table.path().filename());
-              pu::print_tables_list(tables);
-            }
-            else
-            {
-              try
-              {
-                auto table_it = tables.find(show_stmt->name);
-                if (table_it == tables.end())
-                {
-                  auto [pair, inserted] =
-                      tables.insert({show_stmt->name,
-                                     std::make_unique<Table>(show_stmt->name)});
-                  table_it = pair;
-                }
-                pu::print_table_desc(table_it->second);
-              }
-              catch (const DBException& e)
-              {
-                std::cout << e.what() << "\n";
-              }
-            }
-
-            break;
-          }
-
-          default:
-            fprintf(stderr, "Query implementation missing!\n");
-          }
-        }
-      }
-      else
-      {
-        fprintf(stderr, "Given string is not a valid SQL query.\n");
-        fprintf(stderr, "%s\n", result->errorMsg());
-      }
-
+      session.run(query_str);
       add_history(query_str.c_str());
       query_str.clear();
     }
@@ -270,5 +61,13 @@ int main()
     free(query);
   }
 
+  session.close();
+  Vacuum::instance().stop();
+  if (ResultCache::instance().enabled())
+    pu::print_cache_stats(ResultCache::instance());
+  if (Settings::get().table_cache_stats)
+    pu::print_table_cache_stats(TableCache::instance());
+  TableCache::instance().clear();
+
   return 0;
 }
@@ -1,4 +1,5 @@
 #include "printutils.hh"
+#include "Output.hh"
 
 namespace printUtils
 {
@@ -13,32 +14,32 @@ void print_welcome_message()
   std::cout << "\e[1mCopyright (c) 2019, FlaviaDB Corporation.\e[0m\n\n";
 }
 
-std::string centered(std::string str, size_t width)
-{
-  int spaces = 0;
-  spaces = (width - str.size()) / 2;
-  if (spaces > 0)
-    str = std::string(spaces, ' ') + str;
-  return str;
-}
-
 void print_row(const std::vector<std::string>* row,
                const std::vector<size_t>* fields_width,
                std::string separator = "|")
 {
-  std::cout << std::left << std::setw(1) << "|";
+  // Center each value in its cell without building temporaries
+  std::ostream& stream = output::out();
+  std::ostreambuf_iterator<char> out(stream);
+  stream << "|";
   for (size_t i = 0; i < row->size(); i++)
   {
-    std::cout << std::setw(fields_width->at(i))
-              << centered(row->at(i), fields_width->at(i));
-    std::cout << ((i == row->size() - 1) ? "|" : separator);
+    size_t width = fields_width->at(i);
+    size_t size = row->at(i).size();
+    size_t left = (size < width) ? (width - size) / 2 : 0;
+    std::fill_n(out, left, ' ');
+    stream << row->at(i);
+    if (left + size < width)
+      std::fill_n(out, width - left - size, ' ');
+    stream << ((i == row->size() - 1) ? "|" : separator);
   }
-  std::cout << "\n";
+  stream << "\n";
 }
 
-void print_select_result(std::vector<hsql::ColumnDefinition*>* columns,
-                         std::vector<std::vector<std::string>>* regs_data,
-                         std::vector<size_t>* fields_width)
+void print_select_result(
+    std::vector<hsql::ColumnDefinition*>* columns,
+    const std::vector<std::vector<std::string>>* regs_data,
+    const std::vector<size_t>* fields_width)
 {
   // header[0] has the first row with the column names
   std::vector<std::vector<std::string>> header;
@@ -51,16 +52,17 @@ void print_select_result(std::vector<hsql::ColumnDefinition*>* columns,
   for (size_t i = 0; i < fields_width->size(); i++)
     header[1].push_back(std::string(fields_width->at(i), '-'));
 
-  std::cout << "\n";
+  output::out() << "\n";
   print_row(&header[0], fields_width);
   print_row(&header[1], fields_width, "+");
-  for (auto row : *regs_data)
+  for (const auto& row : *regs_data)
     print_row(&row, fields_width);
 }
 
-void print_select_result(std::vector<hsql::Expr*>* fields,
-                         std::vector<std::vector<std::string>>* regs_data,
-                         std::vector<size_t>* fields_width)
+void print_select_result(
+    std::vector<hsql::Expr*>* fields,
+    const std::vector<std::vector<std::string>>* regs_data,
+    const std::vector<size_t>* fields_width)
 {
   // header[0] has the first row with the column names
   std::vector<std::vector<std::string>> header;
@@ -73,13 +75,28 @@ void print_select_result(std::vector<hsql::Expr*>* fields,
   for (size_t i = 0; i < fields_width->size(); i++)
     header[1].push_back(std::string(fields_width->at(i), '-'));
 
-  std::cout << "\n";
+  output::out() << "\n";
   print_row(&header[0], fields_width);
   print_row(&header[1], fields_width, "+");
   for (auto& row : *regs_data)
     print_row(&row, fields_width);
 }
 
+size_t column_width(const hsql::ColumnDefinition* column)
+{
+  switch (column->type.data_type)
+  {
+  case hsql::DataType::INT:
+    return 11;    // Size of "-2147483648"
+  case hsql::DataType::DATE:
+    return 10;    // Size of "dd-mm-YYYY"
+  case hsql::DataType::CHAR:
+    return column->type.length;
+  default:
+    return 0;
+  }
+}
+
 std::string dataTypeToString(hsql::ColumnType type)
 {
   switch (type.data_type)
@@ -96,7 +113,7 @@ std::string dataTypeToString(hsql::ColumnType type)
   }
 }
 
-void print_tables_list(std::vector<std::string>& tables)
+void print_tables_list(std::vector<std::string> const& tables)
 {
   std::vector<size_t> fields_width;
   fields_width.push_back(7);    // Size of "Table" + 2
@@ -115,7 +132,7 @@ void print_tables_list(std::vector<std::string>& tables)
   header.push_back(std::vector<std::string>());
   for (size_t i = 0; i < header[0].size(); i++)
     header[1].push_back(std::string(fields_width[i], '-'));
-  std::cout << "\n";
+  output::out() << "\n";
   // TODO: Refactor header printing
 
   print_row(&header[0], &fields_width);
@@ -128,7 +145,7 @@ void print_tables_list(std::vector<std::string>& tables)
     print_row(&table, &fields_width);
     table.pop_back();
   }
-  std::cout << "\n";
+  output::out() << "\n";
 }
 
 void print_table_desc(std::unique_ptr<Table> const& table)
@@ -158,7 +175,7 @@ void print_table_desc(std::unique_ptr<Table> const& table)
   for (size_t i = 0; i < header[0].size(); i++)
     header[1].push_back(std::string(fields_width[i], '-'));
 
-  std::cout << "\n";
+  output::out() << "\n";
   print_row(&header[0], &fields_width);
   print_row(&header[1], &fields_width, "+");
 
@@ -170,6 +187,22 @@ void print_table_desc(std::unique_ptr<Table> const& table)
     cols_info.back().push_back(dataTypeToString(col->type));
     print_row(&cols_info.back(), &fields_width);
   }
-  std::cout << "\n";
+  output::out() << "\n";
+}
+
+void print_cache_stats(ResultCache const& cache)
+{
+  std::cout << "Result cache: " << cache.hits << " hits, " << cache.misses
+            << " misses, " << cache.evictions << " evictions, "
+            << cache.entries() << " entries using " << cache.used() << "/"
+            << cache.budget() << " bytes.\n";
+}
+
+void print_table_cache_stats(TableCache const& cache)
+{
+  std::cout << "Table cache: " << cache.hits << " hits, " << cache.misses
+            << " misses, " << cache.evictions << " evictions, "
+            << cache.tables() << " open tables using " << cache.used()
+            << " bytes.\n";
 }
 }    // namespace printUtils
@@ -1,21 +1,18 @@
-#include "Processor.hh"
-#include "Table.hh"
+#include "Catalog.hh"
+#include "ResultCache.hh"
+#include "Session.hh"
+#include "Settings.hh"
+#include "TableCache.hh"
+#include "Vacuum.hh"
 #include "filestruct.hh"
 #include "flaviadb_definitions.hh"
 #include "printutils.hh"
-#include <filesystem>
-#include <fstream>                  // ifstream, ofstream
-#include <hsql/SQLParser.h>         // Include SQL Parser
-#include <hsql/util/sqlhelper.h>    // Contains printing utilities
+#include <fstream>    // ifstream, ofstream
 #include <iostream>
-#include <sys/stat.h>    // stat, mkdir
 
-namespace fs = std::filesystem;
 namespace ft = ftools;
 namespace pu = printUtils;
 
-std::map<std::string, std::unique_ptr<Table>> tables;
-
 int main()
 {
   if (!ft::dirExists(FLAVIADB_DIR))
@@ -29,216 +26,33 @@ int main()
     exit(0);
   }
 
+  Settings::get().load_from_env();
+  Catalog::instance().open();
+  if (Settings::get().result_cache_bytes > 0)
+    ResultCache::instance().enable(Settings::get().result_cache_bytes);
+  TableCache::instance().configure(Settings::get().table_cache_tables,
+                                   Settings::get().table_cache_bytes);
+  if (Settings::get().vacuum_batch_rows > 0)
+    Vacuum::instance().start(Settings::get().vacuum_batch_rows,
+                             Settings::get().vacuum_delay_ms);
+
   std::string filename;
   std::cout << "filename: ";
   std::cin >> filename;
 
   std::ifstream inFile(filename + ".fdb");
+  Session session;
   std::string query;
   while (std::getline(inFile, query))
-  {
-    hsql::SQLParserResult* result = new hsql::SQLParserResult;
-    hsql::SQLParser::parse(query, result);
-
-    if (result->isValid() && result->size())
-    {
-      for (auto i = 0; i < result->size(); i++)
-      {
-        const hsql::SQLStatement* statement = result->getStatement(i);
-
-        switch (statement->type())
-        {
-        case hsql::kStmtSelect:
-        {
-          auto select_stmt = (hsql::SelectStatement*)statement;
-
-          if (select_stmt->fromTable != nullptr)
-          {
-            try
-            {
-              auto table_name{select_stmt->fromTable->name};
-              auto it = tables.find(table_name);
-              if (it == tables.end())
-              {
-                auto [it, inserted] = tables.insert(
-                    {table_name, std::make_unique<Table>(table_name)});
-              }
-              Processor::show_records(select_stmt, it->second);
-            }
-            catch (const DBException& e)
-            {
-              std::cout << e.what() << "\n";
-            }
-          }
-          else
-            fprintf(stderr, "ERROR: No source table was specified.\n");
-
-          break;
-        }
-        case hsql::kStmtInsert:
-        {
-          auto insert_stmt = (hsql::InsertStatement*)statement;
-
-          try
-          {
-            auto it = tables.find(insert_stmt->tableName);
-            if (it == tables.end())
-            {
-              auto [it, inserted] = tables.insert(
-                  {insert_stmt->tableName,
-                   std::make_unique<Table>(insert_stmt->tableName)});
-            }
-            Processor::insert_record(insert_stmt, it->second);
-          }
-          catch (const DBException& e)
-          {
-            std::cout << e.what() << "\n";
-          }
-
-          break;
-        }
-        case hsql::kStmtUpdate:
-        {
-          auto update_stmt = (hsql::UpdateStatement*)statement;
-
-          try
-          {
-            auto it = tables.find(update_stmt->table->name);
-            if (it == tables.end())
-            {
-              auto [it, inserted] = tables.insert(
-                  {update_stmt->table->name,
-                   std::make_unique<Table>(update_stmt->table->name)});
-            }
-            Processor::update_records(update_stmt, it->second);
-          }
-          catch (const DBException& e)
-          {
-            std::cout << e.what() << "\n";
-          }
-
-          break;
-        }
-        case hsql::kStmtDelete:
-        {
-          auto delete_stmt = (hsql::DeleteStatement*)statement;
-
-          try
-          {
-            auto it = tables.find(delete_stmt->tableName);
-            if (it == tables.end())
-            {
-              auto [it, inserted] = tables.insert(
-                  {delete_stmt->tableName,
-                   std::make_unique<Table>(delete_stmt->tableName)});
-            }
-            Processor::delete_records(delete_stmt, it->second);
-          }
-          catch (const DBException& e)
-          {
-            std::cout << e.what() << "\n";
-          }
-
-          break;
-        }
-        case hsql::kStmtCreate:
-        {
-          auto create_stmt = (hsql::CreateStatement*)statement;
-          std::string table_path = ft::getTablePath(create_stmt->tableName);
-
-          if (create_stmt->type == hsql::kCreateTable)
-          {
-            if (!ft::dirExists(table_path))
-            {
-              tables.insert({create_stmt->tableName,
-                             std::make_unique<Table>(create_stmt->tableName,
-                                                     create_stmt->columns)});
-            }
-            else
-              fprintf(stderr, "Table named %s already exists!\n",
-                      create_stmt->tableName);
-          }
-          else if (create_stmt->type == hsql::kCreateIndex)
-          {
-            try
-            {
-              auto it = tables.find(create_stmt->tableName);
-              if (it == tables.end())
-              {
-                auto [it, inserted] = tables.insert(
-                    {create_stmt->tableName,
-                     std::make_unique<Table>(create_stmt->tableName)});
-              }
-              Processor::create_index(create_stmt->columns->at(0)->name,
-                                      it->second);
-            }
-            catch (const DBException& e)
-            {
-              std::cout << e.what() << "\n";
-            }
-          }
-
-          break;
-        }
-        case hsql::kStmtDrop:
-        {
-          auto drop_stmt = (hsql::DropStatement*)statement;
-
-          try
-          {
-            auto it = tables.find(drop_stmt->name);
-            if (it == tables.end())
-            {
-              auto [it, inserted] = tables.insert(
-                  {drop_stmt->name, std::make_unique<Table>(drop_stmt->name)});
-            }
-            Processor::drop_table(it->second);
-          }
-          catch (const DBException& e)
-          {
-            std::cout << e.what() << "\n";
-          }
-
-          break;
-        }
-        case hsql::kStmtShow:    // DESCRIBE
-        {
-          auto show_stmt = (hsql::ShowStatement*)statement;
-
-          if (show_stmt->type == hsql::ShowType::kShowTables)
-          {
-            std::vector<std::string> tables;
-            for (const auto& table : fs::directory_iterator(FLAVIADB_TEST_DB))
-              tables.push_back(table.path().filename());
-            pu::print_tables_list(tables);
-          }
-          else
-          {
-            try
-            {
-              auto stored_tbl = std::make_unique<Table>(show_stmt->name);
-              pu::print_table_desc(std::move(stored_tbl));
-            }
-            catch (const DBException& e)
-            {
-              std::cout << e.what() << "\n";
-            }
-          }
-
-          break;
-        }
-
-        default:
-          fprintf(stderr, "Query implementation missing!\n");
-        }
-      }
-    }
-    else
-    {
-      fprintf(stderr, "Given string is not a valid SQL query.\n");
-      fprintf(stderr, "%s\n", result->errorMsg());
-    }
-  }
+    session.run(query);
+
+  session.close();
+  Vacuum::instance().stop();
+  if (ResultCache::instance().enabled())
+    pu::print_cache_stats(ResultCache::instance());
+  if (Settings::get().table_cache_stats)
+    pu::print_table_cache_stats(TableCache::instance());
+  TableCache::instance().clear();
 
   return 0;
 }
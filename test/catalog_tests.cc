@@ -0,0 +1,78 @@
+#include "thirdparty/microtest/microtest.h"
+#include "Catalog.hh"
+#include "filestruct.hh"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+namespace ft = ftools;
+
+const std::string CATALOG_TEST_PATH = "/tmp/flaviadb_catalog_test.dat";
+
+TEST(CatalogRecordsAndStatsTest)
+{
+  remove(CATALOG_TEST_PATH.c_str());
+  {
+    Catalog catalog(CATALOG_TEST_PATH);
+    ASSERT_FALSE(catalog.valid());
+    catalog.put("b", "second");
+    catalog.put("a", "first", TableStats{3, 0});
+    catalog.count("a", -1, 1);
+    catalog.count("b", 2, 0);
+    // Replacing a record keeps the statistics of its table
+    catalog.put("b", "replaced");
+  }
+
+  Catalog catalog(CATALOG_TEST_PATH);
+  ASSERT_TRUE(catalog.valid());
+  ASSERT_TRUE((catalog.tables() == std::vector<std::string>{"a", "b"}));
+  std::string record;
+  ASSERT_TRUE(catalog.find("b", record));
+  ASSERT_STREQ("replaced", record);
+  ASSERT_EQ(2, catalog.stats("a").rows);
+  ASSERT_EQ(1, catalog.stats("a").deleted);
+  ASSERT_EQ(2, catalog.stats("b").rows);
+
+  catalog.remove("a");
+  ASSERT_FALSE(catalog.find("a", record));
+  ASSERT_EQ(1, catalog.tables().size());
+
+  remove(CATALOG_TEST_PATH.c_str());
+}
+
+TEST(CatalogChecksumTest)
+{
+  remove(CATALOG_TEST_PATH.c_str());
+  Catalog(CATALOG_TEST_PATH).put("a", "first");
+
+  // A damaged schema makes the whole file be rebuilt
+  std::fstream file(CATALOG_TEST_PATH,
+                    std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(-1, std::ios::end);
+  file.put('X');
+  file.close();
+
+  Catalog catalog(CATALOG_TEST_PATH);
+  ASSERT_FALSE(catalog.valid());
+  std::string record;
+  ASSERT_FALSE(catalog.find("a", record));
+
+  remove(CATALOG_TEST_PATH.c_str());
+}
+
+TEST(CatalogOpenTest)
+{
+  remove(CATALOG_TEST_PATH.c_str());
+  Catalog(CATALOG_TEST_PATH).open();
+
+  // Every table of the data folder is registered by a single rewrite
+  Catalog catalog(CATALOG_TEST_PATH);
+  ASSERT_TRUE(catalog.valid());
+  std::string record;
+  for (const auto& entry : fs::directory_iterator(FLAVIADB_TEST_DB))
+    if (ft::fileExists(ft::getMetadataPath(entry.path().filename())))
+      ASSERT_TRUE(catalog.find(entry.path().filename(), record));
+
+  remove(CATALOG_TEST_PATH.c_str());
+}
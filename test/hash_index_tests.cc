@@ -0,0 +1,60 @@
+#include "thirdparty/microtest/microtest.h"
+#include "HashIndex.hh"
+#include "filestruct.hh"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+namespace ft = ftools;
+
+const std::string HASH_INDEX_TEST_DIR = "/tmp/flaviadb_hash_index_test/";
+
+TEST(HashIndexInsertSplitAndRemoveTest)
+{
+  fs::remove_all(HASH_INDEX_TEST_DIR);
+  ft::createFolder(HASH_INDEX_TEST_DIR);
+
+  // Enough entries to split buckets and chain overflow pages
+  {
+    HashIndex index(HASH_INDEX_TEST_DIR);
+    for (int i = 0; i < 20000; i++)
+      index.insert(i % 5000 - 2500, i);
+    ASSERT_EQ(20000, index.size());
+    ASSERT_TRUE(index.buckets() > 4);
+  }
+
+  HashIndex index(HASH_INDEX_TEST_DIR);
+  ASSERT_EQ(20000, index.size());
+  auto reg_ids = index.lookup(-2500);
+  std::sort(reg_ids.begin(), reg_ids.end());
+  ASSERT_TRUE((reg_ids == std::vector<uint32_t>{0, 5000, 10000, 15000}));
+  ASSERT_TRUE(index.lookup(2500).empty());
+
+  ASSERT_TRUE(index.remove(-2500, 5000));
+  ASSERT_FALSE(index.remove(-2500, 5000));
+  ASSERT_EQ(3, index.lookup(-2500).size());
+  ASSERT_EQ(19999, index.size());
+
+  fs::remove_all(HASH_INDEX_TEST_DIR);
+}
+
+TEST(HashIndexBuildTest)
+{
+  fs::remove_all(HASH_INDEX_TEST_DIR);
+  ft::createFolder(HASH_INDEX_TEST_DIR);
+
+  std::vector<HashIndex::Entry> entries;
+  for (uint32_t i = 0; i < 10000; i++)
+    entries.push_back({(int)(i % 100), i});
+  HashIndex::build(HASH_INDEX_TEST_DIR, entries);
+
+  HashIndex index(HASH_INDEX_TEST_DIR);
+  ASSERT_EQ(10000, index.size());
+  ASSERT_EQ(100, index.lookup(42).size());
+  ASSERT_TRUE(index.lookup(100).empty());
+
+  // A built index keeps growing through inserts
+  index.insert(100, 10000);
+  ASSERT_EQ(1, index.lookup(100).size());
+
+  fs::remove_all(HASH_INDEX_TEST_DIR);
+}
@@ -0,0 +1,23 @@
+#include "thirdparty/microtest/microtest.h"
+#include "parallelutils.hh"
+#include <cstdint>
+#include <random>
+
+TEST(ParallelSortTest)
+{
+  std::mt19937 generator(7);
+  std::vector<uint64_t> values(10007);
+  for (auto& value : values)
+    value = generator() % 1000;
+  std::vector<uint64_t> expected = values;
+  std::sort(expected.begin(), expected.end());
+
+  // A tiny chunk size forces several chunks and merge rounds
+  parallelUtils::sort(values.begin(), values.end(), std::less<>(), 100);
+  ASSERT_TRUE(values == expected);
+
+  std::vector<int> descending{3, -1, 2, -7, 0};
+  parallelUtils::sort(descending.begin(), descending.end(), std::greater<>(),
+                      1);
+  ASSERT_TRUE((descending == std::vector<int>{3, 2, 0, -1, -7}));
+}
@@ -0,0 +1,92 @@
+#include "thirdparty/microtest/microtest.h"
+
+#include "ResultCache.hh"
+#include <hsql/SQLParser.h>
+#include <string>
+using namespace std;
+
+CachedResult makeResult(vector<vector<string>> rows)
+{
+  CachedResult result;
+  result.regs_data = rows;
+  result.fields_width = vector<size_t>(rows.at(0).size(), 4);
+  return result;
+}
+
+TEST(ResultCacheKeyTest)
+{
+  auto& cache = ResultCache::instance();
+  cache.enable(1 << 20);
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse("SELECT id, name FROM cacheTable WHERE id = 17;"
+                         "SELECT id, name FROM cacheTable WHERE id = 18;",
+                         result);
+  auto stmt = (hsql::SelectStatement*)result->getStatement(0);
+  auto other_stmt = (hsql::SelectStatement*)result->getStatement(1);
+
+  string key = cache.key_for(stmt, "cacheTable");
+  ASSERT_STREQ(key, cache.key_for(stmt, "cacheTable"));
+  ASSERT_TRUE(key != cache.key_for(other_stmt, "cacheTable"));
+
+  // Writes bump the table's version, which changes the key
+  cache.bump("cacheTable");
+  ASSERT_TRUE(key != cache.key_for(stmt, "cacheTable"));
+
+  cache.disable();
+}
+
+TEST(ResultCacheHitMissTest)
+{
+  auto& cache = ResultCache::instance();
+  cache.enable(1 << 20);
+  unsigned long hits = cache.hits;
+  unsigned long misses = cache.misses;
+
+  ASSERT_NULL(cache.find("SELECT id, FROM hitTable@0"));
+  ASSERT_EQ(misses + 1, cache.misses);
+
+  cache.store("SELECT id, FROM hitTable@0", "hitTable",
+              makeResult({{"1"}, {"2"}}));
+  auto cached = cache.find("SELECT id, FROM hitTable@0");
+  ASSERT_NOTNULL(cached);
+  ASSERT_EQ(hits + 1, cache.hits);
+  ASSERT_EQ(2, cached->regs_data.size());
+
+  cache.bump("hitTable");
+  ASSERT_NULL(cache.find("SELECT id, FROM hitTable@0"));
+  ASSERT_EQ(0, cache.used());
+
+  cache.disable();
+}
+
+TEST(ResultCacheByteBudgetTest)
+{
+  auto& cache = ResultCache::instance();
+  cache.enable(1 << 20);
+  cache.store("first", "budgetTable", makeResult({{string(100, 'a')}}));
+  size_t entry_size = cache.used();
+
+  // Only room for two entries: storing a third evicts the least recently used
+  cache.enable(2 * entry_size + entry_size / 2);
+  cache.store("second", "budgetTable", makeResult({{string(100, 'b')}}));
+  ASSERT_NOTNULL(cache.find("first"));
+  cache.store("third", "budgetTable", makeResult({{string(100, 'c')}}));
+
+  ASSERT_EQ(2, cache.entries());
+  ASSERT_NOTNULL(cache.find("first"));
+  ASSERT_NULL(cache.find("second"));
+  ASSERT_TRUE(cache.used() <= cache.budget());
+
+  // Results larger than the whole budget are not cached
+  cache.store("huge", "budgetTable", makeResult({{string(4096, 'd')}}));
+  ASSERT_NULL(cache.find("huge"));
+
+  // Shrinking the budget evicts, and counts it
+  unsigned long evictions = cache.evictions;
+  cache.enable(entry_size + entry_size / 2);
+  ASSERT_EQ(1, cache.entries());
+  ASSERT_EQ(evictions + 1, cache.evictions);
+
+  cache.disable();
+}
@@ -0,0 +1,96 @@
+#include "thirdparty/microtest/microtest.h"
+
+#include "ResultSink.hh"
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+using namespace std;
+
+const string SINK_OUTPUT = "/tmp/flaviadb_sink_test.out";
+
+vector<hsql::Expr*>* makeFields(vector<const char*> names)
+{
+  auto fields = new vector<hsql::Expr*>;
+  for (const auto& name : names)
+  {
+    fields->push_back(new hsql::Expr(hsql::kExprColumnRef));
+    fields->back()->name = strdup(name);
+  }
+  return fields;
+}
+
+int openSinkOutput()
+{
+  return open(SINK_OUTPUT.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+              S_IRUSR | S_IWUSR);
+}
+
+string readSinkOutput()
+{
+  ifstream in(SINK_OUTPUT);
+  stringstream content;
+  content << in.rdbuf();
+  return content.str();
+}
+
+TEST(CsvSinkQuotingTest)
+{
+  auto fields = makeFields({"id", "name"});
+  {
+    DelimitedSink sink(openSinkOutput(), 1, fields,
+                       {hsql::DataType::INT, hsql::DataType::CHAR}, ',');
+    sink.add_row({"1", "plain"});
+    sink.add_row({"2", "with, comma"});
+    sink.add_row({"3", "say \"hi\""});
+    sink.finish();
+    ASSERT_EQ(3, sink.rows());
+  }
+
+  ASSERT_STREQ("id,name\n1,plain\n2,\"with, comma\"\n3,\"say \"\"hi\"\"\"\n",
+               readSinkOutput());
+}
+
+TEST(TsvSinkEscapingTest)
+{
+  auto fields = makeFields({"id", "name"});
+  {
+    DelimitedSink sink(openSinkOutput(), 1, fields,
+                       {hsql::DataType::INT, hsql::DataType::CHAR}, '\t');
+    sink.add_row({"1", "a\tb"});
+    sink.finish();
+  }
+
+  ASSERT_STREQ("id\tname\n1\ta\\tb\n", readSinkOutput());
+}
+
+TEST(JsonLinesSinkTest)
+{
+  auto fields = makeFields({"id", "name", "birthdate"});
+  {
+    JsonLinesSink sink(
+        openSinkOutput(), 1, fields,
+        {hsql::DataType::INT, hsql::DataType::CHAR, hsql::DataType::DATE});
+    sink.add_row({"7", "quote\"", "07-07-2001"});
+    sink.finish();
+  }
+
+  ASSERT_STREQ(
+      "{\"id\":7,\"name\":\"quote\\\"\",\"birthdate\":\"07-07-2001\"}\n",
+      readSinkOutput());
+}
+
+TEST(BoxSinkTest)
+{
+  auto fields = makeFields({"id", "name"});
+  {
+    BoxSink sink(openSinkOutput(), 1, fields,
+                 {hsql::DataType::INT, hsql::DataType::CHAR}, {4, 6}, 0, 0);
+    sink.add_row({"1", "flavia"});
+    sink.finish();
+  }
+
+  ASSERT_STREQ("\n| id |  name  |\n|----+--------|\n| 1  | flavia |\n",
+               readSinkOutput());
+}
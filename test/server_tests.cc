@@ -0,0 +1,184 @@
+#include "thirdparty/microtest/microtest.h"
+
+#include "Client.hh"
+#include "DBException.hh"
+#include "Output.hh"
+#include "Protocol.hh"
+#include "Server.hh"
+#include "Settings.hh"
+#include "TableCache.hh"
+#include "filestruct.hh"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace ft = ftools;
+
+const string SERVER_SOCKET = "/tmp/flaviadb_test.sock";
+
+// Serves on a thread of its own until the test leaves its scope, even
+// through a failed assertion
+struct ServerThread
+{
+  Server& server;
+  thread loop;
+
+  explicit ServerThread(Server& server)
+      : server(server), loop([&server] { server.run(); })
+  {
+  }
+  ~ServerThread()
+  {
+    server.stop();
+    loop.join();
+  }
+};
+
+TEST(FrameReaderTest)
+{
+  string stream = protocol::frame("SELECT 1;") + protocol::frame("") +
+                  protocol::frame("COMMIT;");
+  protocol::FrameReader reader;
+  vector<string> frames;
+  string payload;
+  // Byte by byte, as a slow socket could hand them over
+  for (char c : stream)
+  {
+    reader.feed(&c, 1);
+    while (reader.next(payload) == protocol::kFrameReady)
+      frames.push_back(payload);
+  }
+  ASSERT_EQ(3, frames.size());
+  ASSERT_EQ("SELECT 1;", frames[0]);
+  ASSERT_EQ("", frames[1]);
+  ASSERT_EQ("COMMIT;", frames[2]);
+  ASSERT_EQ(protocol::kFrameIncomplete, reader.next(payload));
+
+  string oversized = protocol::frame(string(10, 'x'));
+  oversized[0] = char(0xff);
+  reader.feed(oversized.data(), oversized.size());
+  ASSERT_EQ(protocol::kFrameTooLarge, reader.next(payload));
+}
+
+TEST(OutputCaptureTest)
+{
+  string captured;
+  {
+    output::Capture capture;
+    output::out() << "Inserted 1 row.\n";
+    output::err() << "ERROR: Unknown operator.\n";
+    captured = capture.str();
+  }
+  ASSERT_EQ("Inserted 1 row.\nERROR: Unknown operator.\n", captured);
+  ASSERT_TRUE(output::captured() == nullptr);
+}
+
+TEST(ServerTest)
+{
+  auto& settings = Settings::get();
+  string output_path = settings.output_path;
+  OutputFormat output_format = settings.output_format;
+  settings.output_path.clear();
+  settings.output_format = OutputFormat::CSV;
+  if (ft::dirExists(ft::getTablePath("serverTable")))
+    Session().run("DROP TABLE serverTable;");
+
+  Server server(SERVER_SOCKET, 4);
+  auto serving = make_unique<ServerThread>(server);
+  Client client(SERVER_SOCKET);
+  // ASSERT_EQ evaluates its arguments more than once, so replies are kept
+  string reply = client.query("CREATE TABLE serverTable (id int, grp int);");
+  ASSERT_EQ("Table serverTable was created successfully.\n", reply);
+  reply = client.query("INSERT INTO serverTable VALUES (1, 0);");
+  ASSERT_EQ("Inserted 1 row.\n", reply);
+  reply = client.query("SELECT * FROM serverTable;");
+  ASSERT_EQ("id,grp\n1,0\nReturned 1 rows.\n", reply);
+
+  // Each connection is a session of its own
+  Client other(SERVER_SOCKET);
+  reply = client.query("BEGIN;");
+  ASSERT_EQ("Began transaction.\n", reply);
+  client.query("INSERT INTO serverTable VALUES (2, 0);");
+  reply = other.query("SELECT id FROM serverTable;");
+  ASSERT_EQ("id\n1\nReturned 1 rows.\n", reply);
+  reply = client.query("COMMIT;");
+  ASSERT_EQ("Committed transaction.\n", reply);
+  reply = other.query("SELECT id FROM serverTable;");
+  ASSERT_EQ("id\n1\n2\nReturned 2 rows.\n", reply);
+
+  // Clients running at once over TCP
+  Server tcp_server(uint16_t(0), 2);
+  ServerThread tcp_serving(tcp_server);
+  vector<thread> writers;
+  for (int i = 0; i < 4; i++)
+    writers.emplace_back([&, i] {
+      Client writer("localhost", tcp_server.port());
+      for (int j = 0; j < 25; j++)
+        writer.query("INSERT INTO serverTable VALUES (" +
+                     to_string(100 + i * 25 + j) + ", 1);");
+    });
+  for (auto& writer : writers)
+    writer.join();
+  reply = other.query("SELECT id FROM serverTable WHERE grp = 1;");
+  ASSERT_EQ("Returned 100 rows.\n", reply.substr(3 + 100 * 4));
+
+  // A transaction left open by a client that hangs up is rolled back. The
+  // INSERT waits for the rollback to give the table back
+  {
+    Client quitter(SERVER_SOCKET);
+    quitter.query("BEGIN;");
+    quitter.query("INSERT INTO serverTable VALUES (3, 2);");
+  }
+  reply = other.query("INSERT INTO serverTable VALUES (4, 2);");
+  ASSERT_EQ("Inserted 1 row.\n", reply);
+  reply = other.query("SELECT id FROM serverTable WHERE grp = 2;");
+  ASSERT_EQ("id\n4\nReturned 1 rows.\n", reply);
+
+  // More clients waiting for the transaction's table than there are
+  // workers. They give up in time for the COMMIT to get a worker
+  settings.lock_timeout_ms = 200;
+  Server small_server(SERVER_SOCKET + ".small", 2);
+  ServerThread small_serving(small_server);
+  Client owner(SERVER_SOCKET + ".small");
+  owner.query("BEGIN;");
+  owner.query("INSERT INTO serverTable VALUES (5, 3);");
+  vector<string> waited(4);
+  vector<thread> waiters;
+  for (int i = 0; i < 4; i++)
+    waiters.emplace_back([&, i] {
+      Client waiter(SERVER_SOCKET + ".small");
+      waited[i] = waiter.query("INSERT INTO serverTable VALUES (6, 3);");
+    });
+  this_thread::sleep_for(chrono::milliseconds(50));
+  reply = owner.query("COMMIT;");
+  for (auto& waiter : waiters)
+    waiter.join();
+  settings.lock_timeout_ms = 5000;
+  ASSERT_EQ("Committed transaction.\n", reply);
+  string timed_out = DBException{LOCK_TIMEOUT, "serverTable"}.what();
+  for (const auto& waiter_reply : waited)
+  {
+    bool answered = waiter_reply == "Inserted 1 row.\n" ||
+                    waiter_reply == timed_out + "\n";
+    ASSERT_TRUE(answered);
+  }
+
+  serving.reset();
+  bool lost = 0;
+  try
+  {
+    other.query("SELECT id FROM serverTable;");
+  }
+  catch (const DBException& e)
+  {
+    lost = e.code() == CONNECTION_LOST;
+  }
+  ASSERT_TRUE(lost);
+
+  Session().run("DROP TABLE serverTable;");
+  settings.output_path = output_path;
+  settings.output_format = output_format;
+}
@@ -1,11 +1,19 @@
 #include "thirdparty/microtest/microtest.h"
 
 #include "Processor.hh"
+#include "Session.hh"
 #include "Table.hh"
+#include "TableCache.hh"
+#include "TableLock.hh"
+#include "VersionStore.hh"
 #include "filestruct.hh"
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <functional>
 #include <hsql/SQLParser.h>
 #include <string>
+#include <thread>
 using namespace std;
 
 namespace ft = ftools;
@@ -66,8 +74,8 @@ TEST(CreateAndDropTableTest)
   assertCorrectPaths(*tbl);
   assertPathsExist(*tbl);
 
-  // 4 (id) + 10 (name) + 8 (birthdate) = 22
-  ASSERT_EQ(22, tbl->reg_size);
+  // 4 (id) + 10 (name) + 4 (birthdate) = 18
+  ASSERT_EQ(18, tbl->reg_size);
 
   ASSERT_EQ(0, tbl->reg_count);
 
@@ -177,8 +185,9 @@ TEST(InsertRecordTest)
   auto inserted_register_name = inserted_register.at(1);
   ASSERT_STREQ("testName", inserted_register_name);
 
+  // Dates are stored as day numbers
   auto inserted_register_date = inserted_register.at(2);
-  ASSERT_STREQ("07-07-2001", inserted_register_date);
+  ASSERT_STREQ("11510", inserted_register_date);
 
   string filename = getFilenameWithExtension(tbl->reg_count);
   ASSERT_TRUE(ft::fileExists(tbl->regs_path + filename));
@@ -223,10 +232,53 @@ TEST(UpdateRecordsTest)
   ASSERT_STREQ(stored_data.at(1), updated_register_name);
 
   auto updated_register_date = updated_register.at(2);
-  ASSERT_STREQ("07-07-2001", updated_register_date);
+  ASSERT_STREQ("11510", updated_register_date);
   ASSERT_STREQ(stored_data.at(2), updated_register_date);
 }
 
+TEST(MultiColumnUpdateTest)
+{
+  dropIfExists("multiUpdateTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE multiUpdateTable (id int, name char(10), birthdate date);"
+      "INSERT INTO multiUpdateTable VALUES (1, 'old', '01-01-2000');"
+      "UPDATE multiUpdateTable SET id = 2, name = 'new', birthdate = "
+      "'02-02-2002' WHERE id = 1;"
+      "UPDATE multiUpdateTable SET name = 'other', id = 'wrong' WHERE id = 2;",
+      result);
+  auto tbl = make_unique<Table>(
+      "multiUpdateTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(1),
+                           tbl);
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(2),
+                            tbl);
+
+  vector<string> stored_data{};
+  readFromFileTo(stored_data, getFilePath(*tbl, tbl->reg_count));
+  ASSERT_STREQ("2", stored_data.at(0));
+  ASSERT_STREQ("new", stored_data.at(1));
+  ASSERT_STREQ("02-02-2002", formatDate(stored_data.at(2)));
+
+  // Every assignment is validated before any register is changed
+  bool threw = 0;
+  try
+  {
+    Processor::update_records((hsql::UpdateStatement*)result->getStatement(3),
+                              tbl);
+  }
+  catch (const DBException& e)
+  {
+    threw = 1;
+  }
+  ASSERT_TRUE(threw);
+  ASSERT_STREQ("new", tbl->registers->front().second.at(1));
+
+  dropIfExists("multiUpdateTable");
+}
+
 void readFromFileTo(vector<string>& values, string filename)
 {
   ifstream inFile(filename);
@@ -265,6 +317,581 @@ TEST(DeleteRecordsTest)
   ASSERT_TRUE(it == tbl->registers->end());
 }
 
+TEST(DeleteTombstonesAndVacuumTest)
+{
+  dropIfExists("vacuumedTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE vacuumedTable (id int, name char(10));"
+      "INSERT INTO vacuumedTable VALUES (1, 'kept');"
+      "INSERT INTO vacuumedTable VALUES (2, 'deleted');"
+      "DELETE FROM vacuumedTable WHERE id = 2;"
+      "SELECT * FROM vacuumedTable WHERE id = 2;"
+      "SELECT * FROM vacuumedTable;",
+      result);
+  auto tbl = make_unique<Table>(
+      "vacuumedTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(1),
+                           tbl);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(2),
+                           tbl);
+  Processor::create_index({"id"}, tbl);
+  string deleted_path = getFilePath(*tbl, tbl->reg_count);
+
+  // DELETE only tombstones the register
+  Processor::delete_records((hsql::DeleteStatement*)result->getStatement(3),
+                            tbl);
+  ASSERT_EQ(1, tbl->registers->size());
+  ASSERT_TRUE(ft::fileExists(deleted_path));
+  ASSERT_TRUE(ft::dirExists(tbl->indexes_path + "id/2/"));
+
+  // Neither a fresh handle nor the index see it anymore
+  auto reopened_tbl = make_unique<Table>("vacuumedTable");
+  Processor::show_records((hsql::SelectStatement*)result->getStatement(4),
+                          reopened_tbl);
+  Processor::show_records((hsql::SelectStatement*)result->getStatement(5),
+                          reopened_tbl);
+  ASSERT_EQ(1, reopened_tbl->registers->size());
+
+  size_t reclaimed = Vacuum::vacuum_table("vacuumedTable", 1, 0);
+  ASSERT_EQ(1, reclaimed);
+  ASSERT_FALSE(ft::fileExists(deleted_path));
+  ASSERT_FALSE(ft::dirExists(tbl->indexes_path + "id/2/"));
+  ASSERT_TRUE(ft::dirExists(tbl->indexes_path + "id/1/"));
+  ASSERT_FALSE(ft::fileExists(tbl->tombstones_path));
+  ASSERT_FALSE(ft::fileExists(tbl->vacuum_path));
+  // Vacuum works on the cached handle, which forgets the reclaimed register
+  auto cached = TableCache::instance().get("vacuumedTable");
+  ASSERT_TRUE((*cached)->tombstones.empty());
+
+  TableCache::instance().erase("vacuumedTable");
+  dropIfExists("vacuumedTable");
+}
+
+TEST(HashIndexLookupTest)
+{
+  dropIfExists("hashedTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE hashedTable (id int, name char(10));"
+      "INSERT INTO hashedTable VALUES (1, 'one');"
+      "INSERT INTO hashedTable VALUES (2, 'two');"
+      "INSERT INTO hashedTable VALUES (3, 'three');"
+      "UPDATE hashedTable SET id = 20 WHERE id = 2;"
+      "DELETE FROM hashedTable WHERE id = 3;",
+      result);
+  auto tbl = make_unique<Table>(
+      "hashedTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(1),
+                           tbl);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(2),
+                           tbl);
+
+  auto command =
+      Command::parse("CREATE INDEX hashed_id ON hashedTable USING HASH (id);");
+  ASSERT_EQ(kCommandCreateIndex, command.type);
+  ASSERT_EQ(kIndexHash, command.index_type);
+  ASSERT_STREQ("id", command.columns.at(0));
+  Processor::create_index(command.columns, tbl, command.index_type);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(3),
+                           tbl);
+
+  // Without USING it is left to the SQL parser
+  ASSERT_EQ(kCommandNone,
+            Command::parse("CREATE INDEX ON hashedTable (id);").type);
+
+  // A fresh handle only reads the registers the index points to
+  auto reopened_tbl = make_unique<Table>("hashedTable");
+  ASSERT_EQ(kIndexHash, reopened_tbl->indexes->at(0)->type);
+  ASSERT_EQ(1, reopened_tbl->indexes->at(0)->lookup({"3"}).size());
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(4),
+                            reopened_tbl);
+  Processor::delete_records((hsql::DeleteStatement*)result->getStatement(5),
+                            reopened_tbl);
+  ASSERT_TRUE(reopened_tbl->registers == nullptr);
+
+  auto index = reopened_tbl->indexes->at(0);
+  ASSERT_TRUE(index->lookup({"2"}).empty());
+  ASSERT_STREQ("2.sqlito", index->lookup({"20"}).at(0));
+  ASSERT_TRUE(reopened_tbl->isDeleted(index->lookup({"3"}).at(0)));
+
+  dropIfExists("hashedTable");
+}
+
+TEST(CompositeIndexLookupTest)
+{
+  dropIfExists("compositeTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE compositeTable (id int, birthdate date, name char(10));"
+      "INSERT INTO compositeTable VALUES (1, '01-01-2000', 'old');"
+      "INSERT INTO compositeTable VALUES (1, '01-01-2010', 'new');"
+      "INSERT INTO compositeTable VALUES (2, '01-01-2010', 'other');"
+      "UPDATE compositeTable SET name = 'newer' "
+      "WHERE id = 1 AND birthdate > '01-06-2005';"
+      "DELETE FROM compositeTable WHERE id = 2 AND birthdate = '1-1-2010';"
+      "UPDATE compositeTable SET name = 'none' WHERE id = 1 OR id = 2;"
+      "SELECT * FROM compositeTable;",
+      result);
+  auto tbl = make_unique<Table>(
+      "compositeTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  for (size_t i = 1; i <= 3; i++)
+    Processor::insert_record((hsql::InsertStatement*)result->getStatement(i),
+                             tbl);
+
+  auto command = Command::parse(
+      "CREATE INDEX ON compositeTable USING BTREE (id, birthdate);");
+  ASSERT_EQ(kCommandCreateIndex, command.type);
+  ASSERT_EQ(2, command.columns.size());
+  Processor::create_index(command.columns, tbl, command.index_type);
+  ASSERT_TRUE(
+      ft::dirExists(tbl->indexes_path + "id,birthdate/1/14610/"));
+
+  // The index is found again by its columns, and prefixes of it can be
+  // looked up
+  auto reopened_tbl = make_unique<Table>("compositeTable");
+  auto index = reopened_tbl->indexes->at(0);
+  ASSERT_EQ(2, index->column_pos.size());
+  ASSERT_EQ(1, index->column_pos.at(1));
+  ASSERT_EQ(2, index->lookup({"1"}).size());
+  ASSERT_EQ(1, index->lookup({"1", "10957"}).size());
+
+  // Equality on id and a condition on birthdate are served by the index
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(4),
+                            reopened_tbl);
+  Processor::delete_records((hsql::DeleteStatement*)result->getStatement(5),
+                            reopened_tbl);
+  ASSERT_TRUE(reopened_tbl->registers == nullptr);
+
+  // Conditions can only be joined by AND
+  ASSERT_FALSE(Processor::update_records(
+      (hsql::UpdateStatement*)result->getStatement(6), reopened_tbl));
+
+  Processor::show_records((hsql::SelectStatement*)result->getStatement(7),
+                          reopened_tbl);
+  ASSERT_EQ(2, reopened_tbl->registers->size());
+  for (const auto& [filename, reg_data] : *reopened_tbl->registers)
+  {
+    string expected_name = (reg_data[1] == "10957") ? "old" : "newer";
+    ASSERT_STREQ(expected_name, reg_data[2]);
+  }
+
+  dropIfExists("compositeTable");
+}
+
+TEST(CoveringIndexOnlyScanTest)
+{
+  dropIfExists("coveredTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE coveredTable (id int, status char(10), note char(10));"
+      "INSERT INTO coveredTable VALUES (1, 'open', 'first');"
+      "INSERT INTO coveredTable VALUES (2, 'open', 'second');"
+      "UPDATE coveredTable SET status = 'done' WHERE id = 1;"
+      "SELECT id, status FROM coveredTable WHERE id = 1;",
+      result);
+  auto tbl = make_unique<Table>(
+      "coveredTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(1),
+                           tbl);
+  string first_path = getFilePath(*tbl, tbl->reg_count);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(2),
+                           tbl);
+
+  auto command =
+      Command::parse("CREATE INDEX ON coveredTable (id) INCLUDE (status);");
+  ASSERT_EQ(kCommandCreateIndex, command.type);
+  ASSERT_STREQ("status", command.include.at(0));
+  Processor::create_index(command.columns, tbl, command.index_type,
+                          command.include);
+
+  // Updating an included column rewrites the entry in place
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(3),
+                            tbl);
+  auto reopened_tbl = make_unique<Table>("coveredTable");
+  auto index = reopened_tbl->indexes->at(0);
+  ASSERT_EQ(1, index->include_pos.at(0));
+  auto entries = index->scan({"1"});
+  ASSERT_EQ(1, entries.size());
+  ASSERT_STREQ("done", entries.at(0).values.at(1));
+
+  // Every column read is in the index, so the register file is not needed
+  remove(first_path.c_str());
+  auto& cache = ResultCache::instance();
+  cache.enable(1 << 20);
+  auto stmt = (hsql::SelectStatement*)result->getStatement(4);
+  string key = cache.key_for(stmt, "coveredTable");
+  Processor::show_records(stmt, reopened_tbl);
+  auto cached = cache.find(key);
+  ASSERT_NOTNULL(cached);
+  ASSERT_EQ(1, cached->regs_data.size());
+  ASSERT_STREQ("1", cached->regs_data.at(0).at(0));
+  ASSERT_STREQ("done", cached->regs_data.at(0).at(1));
+  ASSERT_TRUE(reopened_tbl->registers == nullptr);
+  cache.disable();
+
+  dropIfExists("coveredTable");
+}
+
+TEST(UniqueConstraintTest)
+{
+  dropIfExists("uniqueTable");
+
+  auto command = Command::parse(
+      "CREATE TABLE uniqueTable (id int PRIMARY KEY, code int, "
+      "name char(10), UNIQUE (code));");
+  ASSERT_EQ(kCommandCreateTable, command.type);
+  ASSERT_EQ(2, command.constraints.size());
+  ASSERT_EQ(kConstraintPrimaryKey, command.constraints.at(0).type);
+  ASSERT_STREQ("code", command.constraints.at(1).columns.at(0));
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      command.query +
+          "INSERT INTO uniqueTable VALUES (1, 10, 'one');"
+          "INSERT INTO uniqueTable VALUES (2, 20, 'two');"
+          "INSERT INTO uniqueTable VALUES (1, 30, 'again');"
+          "UPDATE uniqueTable SET id = 2 WHERE id = 1;"
+          "UPDATE uniqueTable SET id = 3 WHERE id = 1;"
+          "DELETE FROM uniqueTable WHERE id = 2;",
+      result);
+  ASSERT_TRUE(result->isValid());
+  auto tbl = make_unique<Table>(
+      "uniqueTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns,
+      command.constraints);
+  ASSERT_EQ(2, tbl->indexes->size());
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(1),
+                           tbl);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(2),
+                           tbl);
+
+  // Constraints are read back from the metadata
+  auto reopened_tbl = make_unique<Table>("uniqueTable");
+  ASSERT_EQ(2, reopened_tbl->constraints.size());
+  ASSERT_NOTNULL(reopened_tbl->constraintIndex(reopened_tbl->constraints[0]));
+
+  auto assert_duplicate = [&](std::function<void()> statement) {
+    bool duplicate = 0;
+    try
+    {
+      statement();
+    }
+    catch (const DBException& e)
+    {
+      duplicate = string(e.what()).find("Duplicate") != string::npos;
+    }
+    ASSERT_TRUE(duplicate);
+  };
+  assert_duplicate([&] {
+    Processor::insert_record((hsql::InsertStatement*)result->getStatement(3),
+                             reopened_tbl);
+  });
+  assert_duplicate([&] {
+    Processor::update_records((hsql::UpdateStatement*)result->getStatement(4),
+                              reopened_tbl);
+  });
+
+  // Keys freed by UPDATE or DELETE can be taken again
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(5),
+                            reopened_tbl);
+  Processor::delete_records((hsql::DeleteStatement*)result->getStatement(6),
+                            reopened_tbl);
+  hsql::SQLParser::parse("INSERT INTO uniqueTable VALUES (2, 30, 'three');",
+                         result);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(7),
+                           reopened_tbl);
+  ASSERT_EQ(2, reopened_tbl->registers->size());
+
+  // Only one PRIMARY KEY is allowed
+  bool rejected = 0;
+  try
+  {
+    Table("uniqueTable2",
+          ((hsql::CreateStatement*)result->getStatement(0))->columns,
+          {{kConstraintPrimaryKey, {"id"}}, {kConstraintPrimaryKey, {"code"}}});
+  }
+  catch (const DBException& e)
+  {
+    rejected = 1;
+  }
+  ASSERT_TRUE(rejected);
+  ASSERT_FALSE(ft::dirExists(ft::getTablePath("uniqueTable2")));
+
+  // DATE columns are keyed on their day numbers, so they can be unique too
+  dropIfExists("uniqueDates");
+  auto dates_command =
+      Command::parse("CREATE TABLE uniqueDates (day date PRIMARY KEY);");
+  auto dates = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(dates_command.query +
+                             "INSERT INTO uniqueDates VALUES ('01-01-2024');"
+                             "INSERT INTO uniqueDates VALUES ('01-01-2024');",
+                         dates);
+  auto dates_tbl = make_unique<Table>(
+      "uniqueDates", ((hsql::CreateStatement*)dates->getStatement(0))->columns,
+      dates_command.constraints);
+  Processor::insert_record((hsql::InsertStatement*)dates->getStatement(1),
+                           dates_tbl);
+  assert_duplicate([&] {
+    Processor::insert_record((hsql::InsertStatement*)dates->getStatement(2),
+                             dates_tbl);
+  });
+
+  dropIfExists("uniqueDates");
+  dropIfExists("uniqueTable");
+}
+
+TEST(ZoneMapSkipsRowGroupsTest)
+{
+  dropIfExists("zonedTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE zonedTable (id int, day date, name char(10));"
+      "INSERT INTO zonedTable VALUES (1, '01-01-2024', 'a');"
+      "INSERT INTO zonedTable VALUES (2, '15-06-2024', 'b');"
+      "INSERT INTO zonedTable VALUES (3, '01-01-2025', 'c');"
+      "INSERT INTO zonedTable VALUES (4, '15-06-2025', 'd');"
+      "INSERT INTO zonedTable VALUES (5, '01-01-2026', 'e');"
+      "INSERT INTO zonedTable VALUES (6, '15-06-2026', 'f');"
+      "SELECT id, name FROM zonedTable WHERE day >= '01-01-2026';"
+      "UPDATE zonedTable SET day = '01-01-2030' WHERE id = 1;",
+      result);
+  uint32_t group_rows = Settings::get().zone_group_rows;
+  Settings::get().zone_group_rows = 2;
+  auto tbl = make_unique<Table>(
+      "zonedTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  Settings::get().zone_group_rows = group_rows;
+  for (size_t i = 1; i <= 6; i++)
+    Processor::insert_record((hsql::InsertStatement*)result->getStatement(i),
+                             tbl);
+
+  // Only the last row group can hold 2026 dates
+  auto stmt = (hsql::SelectStatement*)result->getStatement(7);
+  WhereClause clause;
+  ASSERT_TRUE(clause.parse(stmt->whereClause, tbl));
+  ZoneMap zone_map(tbl->path, tbl->columns);
+  ASSERT_EQ(2, zone_map.group_rows());
+  ASSERT_TRUE((zone_map.candidates(clause) == vector<bool>{0, 0, 1}));
+
+  auto reopened_tbl = make_unique<Table>("zonedTable");
+  auto& cache = ResultCache::instance();
+  cache.enable(1 << 20);
+  string key = cache.key_for(stmt, "zonedTable");
+  Processor::show_records(stmt, reopened_tbl);
+  ASSERT_EQ(2, cache.find(key)->regs_data.size());
+  ASSERT_TRUE(reopened_tbl->registers == nullptr);
+  cache.disable();
+
+  // Updates widen the group of the register
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(8),
+                            reopened_tbl);
+  ASSERT_TRUE((zone_map.candidates(clause) == vector<bool>{1, 0, 1}));
+
+  dropIfExists("zonedTable");
+}
+
+TEST(BloomFilterSkipsRowGroupsTest)
+{
+  dropIfExists("bloomTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE bloomTable (id int, name char(10));"
+      "INSERT INTO bloomTable VALUES (1, 'a');"
+      "INSERT INTO bloomTable VALUES (2, 'b');"
+      "INSERT INTO bloomTable VALUES (3, 'c');"
+      "INSERT INTO bloomTable VALUES (4, 'd');"
+      "INSERT INTO bloomTable VALUES (5, 'e');"
+      "INSERT INTO bloomTable VALUES (6, 'f');"
+      "SELECT id, name FROM bloomTable WHERE name = 'e';",
+      result);
+  uint32_t group_rows = Settings::get().zone_group_rows;
+  Settings::get().zone_group_rows = 2;
+  auto tbl = make_unique<Table>(
+      "bloomTable", ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  for (size_t i = 1; i <= 4; i++)
+    Processor::insert_record((hsql::InsertStatement*)result->getStatement(i),
+                             tbl);
+
+  Command command =
+      Command::parse("CREATE BLOOM FILTER ON bloomTable (name) FPR 0.001;");
+  ASSERT_EQ(kCommandCreateBloomFilter, command.type);
+  Processor::create_bloom_filter(command.columns, tbl,
+                                 command.false_positive_rate);
+  Settings::get().zone_group_rows = group_rows;
+
+  // Registers inserted afterwards are added to the filters
+  for (size_t i = 5; i <= 6; i++)
+    Processor::insert_record((hsql::InsertStatement*)result->getStatement(i),
+                             tbl);
+
+  auto reopened_tbl = make_unique<Table>("bloomTable");
+  ASSERT_TRUE((reopened_tbl->bloom_columns == vector<string>{"name"}));
+  ASSERT_EQ(0.001, reopened_tbl->bloom_fpr);
+
+  auto stmt = (hsql::SelectStatement*)result->getStatement(7);
+  WhereClause clause;
+  ASSERT_TRUE(clause.parse(stmt->whereClause, reopened_tbl));
+  BloomFilter bloom(reopened_tbl->path, reopened_tbl->columns,
+                    reopened_tbl->bloom_columns);
+  ASSERT_TRUE((bloom.candidates(clause) == vector<bool>{0, 0, 1}));
+
+  auto& cache = ResultCache::instance();
+  cache.enable(1 << 20);
+  string key = cache.key_for(stmt, "bloomTable");
+  Processor::show_records(stmt, reopened_tbl);
+  ASSERT_EQ(1, cache.find(key)->regs_data.size());
+  ASSERT_TRUE(reopened_tbl->registers == nullptr);
+  cache.disable();
+
+  dropIfExists("bloomTable");
+}
+
+TEST(ColumnarTableTest)
+{
+  dropIfExists("columnarTable");
+
+  Command command = Command::parse("CREATE TABLE columnarTable (id int, name "
+                                   "char(10)) WITH (storage = columnar);");
+  ASSERT_EQ(kCommandCreateTable, command.type);
+  ASSERT_EQ(kStorageColumnar, command.storage);
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      command.query + "INSERT INTO columnarTable VALUES (1, 'a');"
+                      "INSERT INTO columnarTable VALUES (2, 'b');"
+                      "INSERT INTO columnarTable VALUES (3, 'c');"
+                      "UPDATE columnarTable SET name = 'z' WHERE id = 2;"
+                      "DELETE FROM columnarTable WHERE id = 3;"
+                      "SELECT name FROM columnarTable WHERE id = 2;",
+      result);
+  uint32_t group_rows = Settings::get().zone_group_rows;
+  Settings::get().zone_group_rows = 2;
+  auto tbl = make_unique<Table>(
+      "columnarTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns,
+      command.constraints, command.storage);
+  Settings::get().zone_group_rows = group_rows;
+  for (size_t i = 1; i <= 3; i++)
+    Processor::insert_record((hsql::InsertStatement*)result->getStatement(i),
+                             tbl);
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(4),
+                            tbl);
+  Processor::delete_records((hsql::DeleteStatement*)result->getStatement(5),
+                            tbl);
+
+  // Registers live in one file per row group, not one per register
+  ASSERT_TRUE(ft::fileExists(tbl->regs_path + "0.pax"));
+  ASSERT_TRUE(ft::fileExists(tbl->regs_path + "1.pax"));
+  ASSERT_FALSE(ft::fileExists(getFilePath(*tbl, 1)));
+
+  auto reopened_tbl = make_unique<Table>("columnarTable");
+  ASSERT_TRUE(reopened_tbl->column_store != nullptr);
+  ASSERT_EQ(2, reopened_tbl->column_store->group_rows());
+  string slot;
+  vector<string_view> fields;
+  ASSERT_TRUE(reopened_tbl->readRegister("2.sqlito", slot, fields));
+  ASSERT_TRUE(fields[1] == "z");
+
+  auto stmt = (hsql::SelectStatement*)result->getStatement(6);
+  auto& cache = ResultCache::instance();
+  cache.enable(1 << 20);
+  string key = cache.key_for(stmt, "columnarTable");
+  Processor::show_records(stmt, reopened_tbl);
+  ASSERT_EQ(1, cache.find(key)->regs_data.size());
+  ASSERT_STREQ("z", cache.find(key)->regs_data[0][0]);
+  ASSERT_TRUE(reopened_tbl->registers == nullptr);
+  cache.disable();
+
+  // The deleted register stays until vacuum reclaims it
+  ASSERT_EQ(3, reopened_tbl->registerFilenames().size());
+  ASSERT_EQ(1, reopened_tbl->removeRegisters({"3.sqlito"}));
+  ASSERT_EQ(2, reopened_tbl->registerFilenames().size());
+
+  // A group that can't be read is never overwritten as if it were empty
+  string group_path = tbl->regs_path + "0.pax";
+  ft::writeFile(group_path, "broken");
+  ASSERT_EQ(0, reopened_tbl->removeRegisters({"1.sqlito"}));
+  string group_data;
+  ft::readSlot(group_path, group_data);
+  ASSERT_EQ("broken", group_data);
+
+  dropIfExists("columnarTable");
+}
+
+TEST(ColumnEncodingTest)
+{
+  auto cells = [](vector<string> const& values, size_t width)
+  {
+    string cells;
+    for (const auto& value : values)
+      cells += value + string(width - value.size(), '\0');
+    return cells;
+  };
+  string chars = cells({"ab", "ab", "cd", "ab", "cd", "cd", "ab", "ab"}, 4);
+  string ints = cells(
+      {"1000", "2000", "3000", "4000", "5000", "6000", "7000", "8000"}, 11);
+  // Dates are day numbers, from 01-01-2024 to 08-01-2024
+  string dates = cells(
+      {"19723", "19724", "19725", "19726", "19727", "19728", "19729", "19730"},
+      10);
+
+  // Each column gets the encoding that makes it smallest, and reads back
+  // exactly as written
+  string chunk, decoded;
+  ColumnEncoding encoding =
+      columnEncoding::encode(chars, 4, hsql::DataType::CHAR, chunk);
+  ASSERT_EQ(kEncodingDictionary, encoding);
+  ASSERT_TRUE(columnEncoding::decode(chunk, encoding, 4, 8, decoded));
+  ASSERT_TRUE(decoded == chars);
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse("SELECT * FROM t WHERE name = 'cd';"
+                         "SELECT * FROM t WHERE id >= 5000;",
+                         result);
+  auto name_expr = ((hsql::SelectStatement*)result->getStatement(0))->whereClause;
+  unique_ptr<Where> name_where(Where::get(name_expr, hsql::DataType::CHAR));
+  string selected(8, 1);
+  ASSERT_TRUE(columnEncoding::filter(chunk, encoding, hsql::DataType::CHAR, 8,
+                                     name_expr, *name_where, selected));
+  ASSERT_TRUE((selected == string{0, 0, 1, 0, 1, 1, 0, 0}));
+
+  encoding = columnEncoding::encode(ints, 11, hsql::DataType::INT, chunk);
+  ASSERT_EQ(kEncodingDelta, encoding);
+  ASSERT_TRUE(columnEncoding::decode(chunk, encoding, 11, 8, decoded));
+  ASSERT_TRUE(decoded == ints);
+
+  auto id_expr = ((hsql::SelectStatement*)result->getStatement(1))->whereClause;
+  unique_ptr<Where> id_where(Where::get(id_expr, hsql::DataType::INT));
+  selected.assign(8, 1);
+  ASSERT_TRUE(columnEncoding::filter(chunk, encoding, hsql::DataType::INT, 8,
+                                     id_expr, *id_where, selected));
+  ASSERT_TRUE((selected == string{0, 0, 0, 0, 1, 1, 1, 1}));
+
+  encoding = columnEncoding::encode(dates, 10, hsql::DataType::DATE, chunk);
+  ASSERT_EQ(kEncodingFrameOfReference, encoding);
+  ASSERT_TRUE(columnEncoding::decode(chunk, encoding, 10, 8, decoded));
+  ASSERT_TRUE(decoded == dates);
+
+  // Values that wouldn't read back as written aren't packed as numbers
+  string loose_dates = cells({"019723", "019723"}, 10);
+  encoding =
+      columnEncoding::encode(loose_dates, 10, hsql::DataType::DATE, chunk);
+  ASSERT_EQ(kEncodingRunLength, encoding);
+  ASSERT_TRUE(columnEncoding::decode(chunk, encoding, 10, 2, decoded));
+  ASSERT_TRUE(decoded == loose_dates);
+}
+
 TEST(CreateIndexOnEmptyTableTest)
 {
   dropIfExists("indexedEmptyTable");
@@ -277,7 +904,7 @@ TEST(CreateIndexOnEmptyTableTest)
 
   auto tbl = make_unique<Table>("indexedEmptyTable", stmt->columns);
 
-  Processor::create_index("id", tbl);
+  Processor::create_index({"id"}, tbl);
   ASSERT_TRUE(ft::dirExists(tbl->indexes_path + "id/"));
 
   dropIfExists("indexedEmptyTable");
@@ -306,7 +933,7 @@ TEST(CreateIndexOnPopulatedTableTest)
   for (const auto& stmt : result->getStatements())
     Processor::insert_record((hsql::InsertStatement*)stmt, tbl);
 
-  Processor::create_index("id", tbl);
+  Processor::create_index({"id"}, tbl);
   ASSERT_TRUE(ft::dirExists(tbl->indexes_path + "id/"));
   ASSERT_TRUE(ft::dirExists(tbl->indexes_path + "id/" + "1/"));
   ASSERT_TRUE(ft::fileExists(tbl->indexes_path + "id/" + "1/" + "1.sqlito"));
@@ -338,7 +965,7 @@ TEST(InsertRegisterToIndexedTableTest)
       "'03-01-2000');",
       result);
 
-  Processor::create_index("id", tbl);
+  Processor::create_index({"id"}, tbl);
   for (const auto& stmt : result->getStatements())
     Processor::insert_record((hsql::InsertStatement*)stmt, tbl);
 
@@ -352,3 +979,580 @@ TEST(InsertRegisterToIndexedTableTest)
 
   dropIfExists("indexedTable");
 }
+
+TEST(LegacyDatesMigrationTest)
+{
+  dropIfExists("legacyDatesTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE legacyDatesTable (id int, birthdate date);", result);
+  auto tbl = make_unique<Table>(
+      "legacyDatesTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  Processor::create_index({"birthdate"}, tbl);
+
+  // Lay the table out the way it was kept when dates were text
+  RegisterData reg_data{"1", "07-07-2001"};
+  tbl->writeRegister("1.sqlito", reg_data);
+  tbl->indexes->at(0)->add(tbl->indexes->at(0)->key(reg_data), "1.sqlito");
+  tbl->reg_size = 12;
+  tbl->writeMetadata();
+
+  auto reopened_tbl = make_unique<Table>("legacyDatesTable");
+  ASSERT_EQ(8, reopened_tbl->reg_size);
+  string slot;
+  vector<string_view> fields;
+  ASSERT_TRUE(reopened_tbl->readRegister("1.sqlito", slot, fields));
+  ASSERT_TRUE(fields.at(1) == "11510");
+  ASSERT_EQ(1, reopened_tbl->indexes->at(0)->lookup({"11510"}).size());
+  ASSERT_EQ(0, reopened_tbl->indexes->at(0)->lookup({"07-07-2001"}).size());
+
+  dropIfExists("legacyDatesTable");
+}
+
+TEST(CopyRecordsTest)
+{
+  dropIfExists("copiedTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse("CREATE TABLE copiedTable (id int, name "
+                         "char(10), birthdate date);",
+                         result);
+  auto createStmt = (hsql::CreateStatement*)result->getStatement(0);
+
+  auto tbl = make_unique<Table>("copiedTable", createStmt->columns);
+  Processor::create_index({"id"}, tbl);
+
+  ofstream data_file("/tmp/copiedTable.csv");
+  data_file << "id,name,birthdate\n"
+            << "1,testName1,01-01-2000\n"
+            << "2,\"test, 2\",02-01-2000\n"
+            << "2,testName3,03-01-2000\n";
+  data_file.close();
+
+  auto command =
+      Command::parse("COPY copiedTable FROM '/tmp/copiedTable.csv' HEADER;");
+  ASSERT_EQ(kCommandCopy, command.type);
+  Processor::copy_records(&command, tbl);
+
+  ASSERT_EQ(3, tbl->registers->size());
+  ASSERT_EQ(3, tbl->reg_count);
+  ASSERT_EQ(3, RegIdAllocator::get("copiedTable").last());
+
+  vector<string> stored_data{};
+  readFromFileTo(stored_data, getFilePath(*tbl, 2));
+  ASSERT_STREQ("test, 2", stored_data.at(1));
+
+  ASSERT_TRUE(ft::fileExists(tbl->indexes_path + "id/" + "1/" + "1.sqlito"));
+  ASSERT_TRUE(ft::fileExists(tbl->indexes_path + "id/" + "2/" + "2.sqlito"));
+  ASSERT_TRUE(ft::fileExists(tbl->indexes_path + "id/" + "2/" + "3.sqlito"));
+
+  // A bad line aborts the whole load
+  data_file.open("/tmp/copiedTable.csv");
+  data_file << "4,testName4,04-01-2000\n"
+            << "notAnInt,testName5,05-01-2000\n";
+  data_file.close();
+
+  command = Command::parse("COPY copiedTable FROM '/tmp/copiedTable.csv';");
+  try
+  {
+    Processor::copy_records(&command, tbl);
+    ASSERT_TRUE(false);
+  }
+  catch (const DBException& e)
+  {
+  }
+  ASSERT_EQ(3, tbl->registers->size());
+
+  dropIfExists("copiedTable");
+}
+
+TEST(RegIdAllocatorReservationTest)
+{
+  dropIfExists("allocatedTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse("CREATE TABLE allocatedTable (id int);", result);
+  auto createStmt = (hsql::CreateStatement*)result->getStatement(0);
+  auto tbl = make_unique<Table>("allocatedTable", createStmt->columns);
+
+  auto& allocator = RegIdAllocator::get("allocatedTable");
+  int first_id = allocator.allocate();
+  ASSERT_EQ(1, first_id);
+  first_id = allocator.allocate(10);
+  ASSERT_EQ(2, first_id);
+  ASSERT_EQ(11, allocator.last());
+
+  // Only the reservation reaches reg_count.dat until a checkpoint
+  ASSERT_EQ(1 + REG_ID_RESERVATION, ft::getRegCount("allocatedTable"));
+  allocator.allocate();
+  ASSERT_EQ(1 + REG_ID_RESERVATION, ft::getRegCount("allocatedTable"));
+
+  allocator.checkpoint();
+  ASSERT_EQ(12, ft::getRegCount("allocatedTable"));
+
+  // Other handles on the same table share the allocator
+  auto other_tbl = make_unique<Table>("allocatedTable");
+  ASSERT_EQ(12, other_tbl->reg_count);
+
+  dropIfExists("allocatedTable");
+}
+
+TEST(UpdateInPlaceAndJournalRecoveryTest)
+{
+  dropIfExists("journaledTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      "CREATE TABLE journaledTable (id int, name char(10));"
+      "INSERT INTO journaledTable VALUES (1, 'before');"
+      "UPDATE journaledTable SET name = 'after' WHERE id = 1;",
+      result);
+  auto tbl = make_unique<Table>(
+      "journaledTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(1),
+                           tbl);
+
+  // Registers are fixed size slots that UPDATE overwrites in place
+  string reg_path = getFilePath(*tbl, tbl->reg_count);
+  struct stat before_update, after_update;
+  stat(reg_path.c_str(), &before_update);
+  ASSERT_EQ(tbl->slot_size, before_update.st_size);
+
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(2),
+                            tbl);
+  stat(reg_path.c_str(), &after_update);
+  ASSERT_EQ(before_update.st_ino, after_update.st_ino);
+  ASSERT_EQ(tbl->slot_size, after_update.st_size);
+  ASSERT_FALSE(ft::fileExists(tbl->path + "journal.dat"));
+
+  vector<string> stored_data{};
+  readFromFileTo(stored_data, reg_path);
+  ASSERT_STREQ("after", stored_data.at(1));
+
+  // A committed journal whose registers weren't written yet is replayed
+  // when the table is opened
+  Journal journal(tbl->path, tbl->regs_path);
+  journal.log_update(getFilenameWithExtension(tbl->reg_count),
+                     tbl->formatRegister({"1", "after"}),
+                     tbl->formatRegister({"1", "replayed"}));
+  journal.commit();
+
+  auto reopened_tbl = make_unique<Table>("journaledTable");
+  ASSERT_FALSE(ft::fileExists(tbl->path + "journal.dat"));
+  stored_data.clear();
+  readFromFileTo(stored_data, reg_path);
+  ASSERT_STREQ("replayed", stored_data.at(1));
+
+  dropIfExists("journaledTable");
+}
+
+TEST(CatalogTableTest)
+{
+  dropIfExists("catalogedTable");
+
+  auto command = Command::parse(
+      "CREATE TABLE catalogedTable (id int PRIMARY KEY, birthdate date);");
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse(
+      command.query +
+          "INSERT INTO catalogedTable VALUES (1, '01-01-2000');"
+          "INSERT INTO catalogedTable VALUES (2, '02-01-2000');"
+          "DELETE FROM catalogedTable WHERE id = 2;",
+      result);
+  auto tbl = make_unique<Table>(
+      "catalogedTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns,
+      command.constraints);
+  Processor::create_index({"birthdate"}, tbl);
+  for (size_t i = 1; i <= 2; i++)
+    Processor::insert_record((hsql::InsertStatement*)result->getStatement(i),
+                             tbl);
+  Processor::delete_records((hsql::DeleteStatement*)result->getStatement(3),
+                            tbl);
+
+  TableStats stats = Catalog::instance().stats("catalogedTable");
+  ASSERT_EQ(1, stats.rows);
+  ASSERT_EQ(1, stats.deleted);
+  auto tables = Catalog::instance().tables();
+  ASSERT_EQ(1, count(tables.begin(), tables.end(), "catalogedTable"));
+
+  // The schema comes back from the catalog as it was created
+  auto reopened_tbl = make_unique<Table>("catalogedTable");
+  ASSERT_EQ(2, reopened_tbl->columns->size());
+  ASSERT_TRUE(reopened_tbl->columns->at(1)->type.data_type ==
+              hsql::DataType::DATE);
+  ASSERT_EQ(1, reopened_tbl->constraints.size());
+  ASSERT_EQ(2, reopened_tbl->indexes->size());
+  ASSERT_EQ(8, reopened_tbl->reg_size);
+
+  // A record cut short, in its columns or at its end, is read from the
+  // table's files instead
+  string record;
+  Catalog::instance().find("catalogedTable", record);
+  for (size_t cut : {(size_t)30, record.size() - 1})
+  {
+    Catalog::instance().put("catalogedTable", record.substr(0, cut));
+    auto fallback_tbl = make_unique<Table>("catalogedTable");
+    ASSERT_EQ(2, fallback_tbl->columns->size());
+    ASSERT_STREQ("birthdate", fallback_tbl->columns->at(1)->name);
+    ASSERT_EQ(2, fallback_tbl->indexes->size());
+  }
+
+  dropIfExists("catalogedTable");
+  tables = Catalog::instance().tables();
+  ASSERT_EQ(0, count(tables.begin(), tables.end(), "catalogedTable"));
+}
+
+TEST(TableCacheEvictionTest)
+{
+  dropIfExists("cachedTable");
+  TableCache& cache = TableCache::instance();
+  cache.clear();
+  cache.hits = cache.misses = cache.evictions = 0;
+  cache.configure(2, 0);
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse("CREATE TABLE cachedTable (id int);"
+                         "INSERT INTO cachedTable VALUES (1);"
+                         "SELECT * FROM cachedTable;",
+                         result);
+
+  // The least recently used table is closed once a third one is open
+  auto dummy = cache.get("dummyTable");
+  cache.get("testTable");
+  ASSERT_TRUE(dummy == cache.get("dummyTable"));
+  auto cached = cache.put(make_unique<Table>(
+      "cachedTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns));
+  ASSERT_EQ(2, cache.tables());
+  ASSERT_EQ(1, cache.hits);
+  ASSERT_EQ(2, cache.misses);
+  ASSERT_EQ(1, cache.evictions);
+
+  // Tables holding their registers are closed to stay under the memory cap
+  Processor::insert_record((hsql::InsertStatement*)result->getStatement(1),
+                           *cached);
+  Processor::show_records((hsql::SelectStatement*)result->getStatement(2),
+                          *cached);
+  // Handles still in use are left alone
+  ASSERT_EQ(0, cache.used());
+  dummy.reset();
+  cached.reset();
+  ASSERT_TRUE(cache.used() > 0);
+  cache.get("testTable");
+  cache.configure(0, 1);
+  ASSERT_EQ(1, cache.tables());
+  ASSERT_EQ(3, cache.evictions);
+
+  try
+  {
+    cache.get("missingTable");
+  }
+  catch (const DBException& e)
+  {
+  }
+  ASSERT_EQ(1, cache.tables());
+
+  // Sessions asking for a table at once wait for a single open of it
+  cache.configure(0, 0);
+  cache.clear();
+  unsigned long misses = cache.misses;
+  vector<TableHandle> opened(4);
+  vector<thread> openers;
+  for (int i = 0; i < 4; i++)
+    openers.emplace_back([&, i] { opened[i] = cache.get("cachedTable"); });
+  for (auto& opener : openers)
+    opener.join();
+  ASSERT_EQ(misses + 1, cache.misses);
+  for (const auto& handle : opened)
+    ASSERT_TRUE(handle == opened[0]);
+
+  opened.clear();
+  cache.clear();
+  dropIfExists("cachedTable");
+}
+
+TEST(ConcurrentSessionsTest)
+{
+  dropIfExists("sharedTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse("CREATE TABLE sharedTable (id int);"
+                         "INSERT INTO sharedTable VALUES (1);",
+                         result);
+  auto tbl = make_unique<Table>(
+      "sharedTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+
+  // Readers share the table while a writer keeps adding to it
+  vector<thread> sessions;
+  atomic<int> selects = 0;
+  for (int i = 0; i < 4; i++)
+    sessions.emplace_back(
+        [&]
+        {
+          hsql::SQLParserResult select;
+          hsql::SQLParser::parse("SELECT id FROM sharedTable WHERE id = 2;",
+                                 &select);
+          for (int j = 0; j < 5; j++)
+            selects += Processor::show_records(
+                (hsql::SelectStatement*)select.getStatement(0), tbl);
+        });
+  sessions.emplace_back(
+      [&]
+      {
+        for (int j = 0; j < 20; j++)
+          Processor::insert_record(
+              (hsql::InsertStatement*)result->getStatement(1), tbl);
+      });
+  for (auto& session : sessions)
+    session.join();
+  ASSERT_EQ(20, selects);
+  ASSERT_EQ(20, tbl->allRegisters()->size());
+
+  // Statements locking the same tables in any order never deadlock, and
+  // only one of them holds a table exclusively at a time
+  int changes = 0;
+  thread first(
+      [&]
+      {
+        for (int i = 0; i < 1000; i++)
+        {
+          TableLock lock({{"sharedTable", kLockExclusive},
+                          {"otherTable", kLockShared}});
+          changes++;
+        }
+      });
+  thread second(
+      [&]
+      {
+        for (int i = 0; i < 1000; i++)
+        {
+          TableLock lock({{"otherTable", kLockExclusive},
+                          {"sharedTable", kLockExclusive}});
+          changes++;
+        }
+      });
+  first.join();
+  second.join();
+  ASSERT_EQ(2000, changes);
+
+  dropIfExists("sharedTable");
+}
+
+TEST(SnapshotScanTest)
+{
+  dropIfExists("snapshotTable");
+
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse("CREATE TABLE snapshotTable (id int, grp int);"
+                         "UPDATE snapshotTable SET grp = 1 WHERE grp = 0;"
+                         "UPDATE snapshotTable SET grp = 0 WHERE grp = 1;"
+                         "SELECT id FROM snapshotTable WHERE grp = 0;",
+                         result);
+  auto tbl = make_unique<Table>(
+      "snapshotTable",
+      ((hsql::CreateStatement*)result->getStatement(0))->columns);
+
+  ofstream data_file("/tmp/snapshotTable.csv");
+  for (int i = 1; i <= 3 * SCAN_BATCH_ROWS; i++)
+    data_file << i << ",0\n";
+  data_file.close();
+  auto command =
+      Command::parse("COPY snapshotTable FROM '/tmp/snapshotTable.csv';");
+  Processor::copy_records(&command, tbl);
+
+  // Scans let the writer in between batches, but still see every register
+  // as of their snapshot: the UPDATEs moved either all of them or none
+  auto& settings = Settings::get();
+  string output_path = "/tmp/snapshotTable.out";
+  remove(output_path.c_str());
+  settings.output_path = output_path;
+  settings.output_format = OutputFormat::CSV;
+  thread writer(
+      [&]
+      {
+        for (int i = 0; i < 10; i++)
+          Processor::update_records(
+              (hsql::UpdateStatement*)result->getStatement(1 + i % 2), tbl);
+      });
+  for (int i = 0; i < 10; i++)
+    Processor::show_records((hsql::SelectStatement*)result->getStatement(3),
+                            tbl);
+  writer.join();
+  settings.output_path.clear();
+  settings.output_format = OutputFormat::BOX;
+
+  ifstream output(output_path);
+  string line;
+  vector<int> returned;
+  while (getline(output, line))
+    if (line == "id")
+      returned.push_back(0);
+    else
+      returned.back()++;
+  ASSERT_EQ(10, returned.size());
+  for (const auto& rows : returned)
+    ASSERT_TRUE(rows == 0 || rows == 3 * SCAN_BATCH_ROWS);
+
+  // Once no snapshot is held, writers drop every older version
+  Processor::update_records((hsql::UpdateStatement*)result->getStatement(1),
+                            tbl);
+  ASSERT_EQ(0, VersionStore::get("snapshotTable")->size());
+
+  remove(output_path.c_str());
+  remove("/tmp/snapshotTable.csv");
+  dropIfExists("snapshotTable");
+}
+
+// Rows each SELECT written to a CSV output file returned
+vector<int> csvResultRows(string const& path, string const& header)
+{
+  ifstream output(path);
+  string line;
+  vector<int> returned;
+  while (getline(output, line))
+    if (line == header)
+      returned.push_back(0);
+    else
+      returned.back()++;
+  return returned;
+}
+
+TEST(TransactionTest)
+{
+  dropIfExists("txnTable");
+  TableCache::instance().erase("txnTable");
+  auto& settings = Settings::get();
+  string output_path = "/tmp/txnTable.out";
+  remove(output_path.c_str());
+  settings.output_path = output_path;
+  settings.output_format = OutputFormat::CSV;
+
+  Session session;
+  session.run("CREATE TABLE txnTable (id int, grp int);");
+  session.run("CREATE INDEX ON txnTable USING HASH (id);");
+  session.run("INSERT INTO txnTable VALUES (1, 0);");
+  auto table = TableCache::instance().get("txnTable");
+  const Index* index = (*table)->indexes->at(0);
+
+  // Writes wait in memory, invisible to other sessions, while index entries
+  // change in place
+  session.run("BEGIN;");
+  ASSERT_TRUE(session.inTransaction());
+  session.run("INSERT INTO txnTable VALUES (2, 0);");
+  session.run("INSERT INTO txnTable VALUES (3, 0);");
+  session.run("UPDATE txnTable SET grp = 1 WHERE id = 1;");
+  session.run("DELETE FROM txnTable WHERE id = 3;");
+  ASSERT_FALSE(ft::fileExists(getFilePath(**table, 2)));
+  ASSERT_EQ(1, index->lookup({"2"}).size());
+  Session other;
+  other.run("SELECT id FROM txnTable WHERE grp = 0;");
+  session.run("SELECT id FROM txnTable WHERE grp = 0;");
+  session.run("CREATE INDEX ON txnTable USING HASH (grp);");
+  ASSERT_EQ(1, (*table)->indexes->size());
+
+  // ROLLBACK leaves the table as it was
+  session.run("ROLLBACK;");
+  ASSERT_FALSE(session.inTransaction());
+  ASSERT_EQ(1, (*table)->registers->size());
+  ASSERT_EQ("0", (*table)->registers->front().second[1]);
+  ASSERT_EQ(0, index->lookup({"2"}).size());
+  ASSERT_EQ(0, VersionStore::get("txnTable")->size());
+  other.run("SELECT id FROM txnTable WHERE grp = 0;");
+
+  // A younger transaction asking for a table an older one changes gives up
+  Session younger;
+  session.run("BEGIN;");
+  younger.run("BEGIN;");
+  session.run("INSERT INTO txnTable VALUES (2, 0);");
+  younger.run("INSERT INTO txnTable VALUES (4, 0);");
+  ASSERT_FALSE(younger.inTransaction());
+
+  // COMMIT writes everything at once, and nothing is left to replay
+  ofstream data_file("/tmp/txnTable.csv");
+  for (int i = 10; i < 20; i++)
+    data_file << i << ",2\n";
+  data_file.close();
+  session.run("COPY txnTable FROM '/tmp/txnTable.csv';");
+  session.run("DELETE FROM txnTable WHERE id = 1;");
+  session.run("UPDATE txnTable SET grp = 3 WHERE id = 10;");
+  session.run("COMMIT;");
+  ASSERT_FALSE(ft::fileExists((*table)->path + "journal.dat"));
+  other.run("SELECT id FROM txnTable WHERE grp = 0;");
+
+  auto reopened = make_unique<Table>("txnTable");
+  // Registers 2 and 3 were rolled back, so the COMMIT wrote 4 to 14
+  ASSERT_TRUE(reopened->isDeleted(getFilenameWithExtension(1)));
+  ASSERT_FALSE(ft::fileExists(getFilePath(*reopened, 2)));
+  ASSERT_EQ(12, reopened->registerFilenames().size());
+  string slot;
+  vector<string_view> reg_data;
+  reopened->readRegister(getFilenameWithExtension(5), slot, reg_data);
+  ASSERT_EQ("3", string(reg_data[1]));
+  ASSERT_EQ(1, index->lookup({"10"}).size());
+
+  // The other session saw the first row until the rollback, and the row
+  // inserted by the transaction once it committed. Inside it, the
+  // transaction saw its own changes
+  vector<int> returned = csvResultRows(output_path, "id");
+  ASSERT_EQ(4, returned.size());
+  ASSERT_EQ(1, returned[0]);
+  ASSERT_EQ(1, returned[1]);
+  ASSERT_EQ(1, returned[2]);
+  ASSERT_EQ(1, returned[3]);
+
+  settings.output_path.clear();
+  settings.output_format = OutputFormat::BOX;
+  remove(output_path.c_str());
+  remove("/tmp/txnTable.csv");
+  table.reset();
+  TableCache::instance().erase("txnTable");
+  dropIfExists("txnTable");
+}
+
+TEST(TransactionDeadlockTest)
+{
+  auto& settings = Settings::get();
+  settings.lock_timeout_ms = 0;
+  Session setup;
+  for (string name : {"deadlockA", "deadlockB"})
+  {
+    dropIfExists(name);
+    TableCache::instance().erase(name);
+    setup.run("CREATE TABLE " + name + " (id int);");
+  }
+
+  // Without a timeout, wait-die alone keeps two transactions from waiting on
+  // each other: the older one waits and the younger one gives up
+  Session older, younger;
+  older.run("BEGIN;");
+  younger.run("BEGIN;");
+  older.run("INSERT INTO deadlockA VALUES (1);");
+  younger.run("INSERT INTO deadlockB VALUES (1);");
+  atomic<bool> waited = 0;
+  thread waiter(
+      [&]
+      {
+        older.run("INSERT INTO deadlockB VALUES (2);");
+        waited = 1;
+      });
+  this_thread::sleep_for(chrono::milliseconds(50));
+  bool waiting = !waited;
+  younger.run("INSERT INTO deadlockA VALUES (2);");
+  waiter.join();
+  ASSERT_TRUE(waiting);
+  ASSERT_FALSE(younger.inTransaction());
+  ASSERT_TRUE(waited);
+  older.run("COMMIT;");
+  settings.lock_timeout_ms = 5000;
+
+  for (string name : {"deadlockA", "deadlockB"})
+  {
+    TableCache::instance().erase(name);
+    dropIfExists(name);
+  }
+}
@@ -0,0 +1,71 @@
+#include "thirdparty/microtest/microtest.h"
+
+#include "VersionStore.hh"
+#include <string>
+#include <vector>
+using namespace std;
+
+TEST(SnapshotVisibilityTest)
+{
+  auto& transactions = Transactions::instance();
+  TxnId running = transactions.begin();
+  auto snapshot = transactions.snapshot();
+  TxnId later = transactions.begin();
+
+  ASSERT_TRUE(snapshot->sees(running - 1));
+  ASSERT_FALSE(snapshot->sees(running));
+  ASSERT_FALSE(snapshot->sees(later));
+
+  // Nothing the snapshot misses can be dropped while it is held
+  transactions.commit(running);
+  transactions.commit(later);
+  ASSERT_TRUE(transactions.horizon() <= running);
+  snapshot.reset();
+  ASSERT_TRUE(transactions.horizon() > later);
+}
+
+TEST(VersionStoreTest)
+{
+  auto& transactions = Transactions::instance();
+  auto versions = VersionStore::get("versionedTable");
+  auto snapshot = transactions.snapshot();
+
+  {
+    Transaction txn(1);
+    ASSERT_TRUE(txn.versioned);
+    vector<string> before{"1", "old"};
+    versions->record(txn.id, "1.sqlito", &before);
+    versions->record(txn.id, "2.sqlito", nullptr);
+    // Only the version from before the transaction is kept
+    vector<string> changed{"1", "changed"};
+    versions->record(txn.id, "1.sqlito", &changed);
+  }
+  ASSERT_EQ(2, versions->size());
+
+  // The snapshot sees the registers as they were before
+  vector<string> image;
+  ASSERT_TRUE(versions->unseen(*snapshot));
+  ASSERT_TRUE(versions->visible(*snapshot, "1.sqlito", image) ==
+              kVisibleOlder);
+  ASSERT_STREQ("old", image.at(1));
+  ASSERT_TRUE(versions->visible(*snapshot, "2.sqlito", image) ==
+              kVisibleNone);
+  ASSERT_TRUE(versions->visible(*snapshot, "3.sqlito", image) ==
+              kVisibleStored);
+  ASSERT_EQ(2, versions->changed(*snapshot).size());
+
+  // Later snapshots see the stored registers
+  auto later = transactions.snapshot();
+  ASSERT_FALSE(versions->unseen(*later));
+  ASSERT_TRUE(versions->visible(*later, "1.sqlito", image) ==
+              kVisibleStored);
+
+  versions->collect(transactions.horizon());
+  ASSERT_EQ(2, versions->size());
+  snapshot.reset();
+  later.reset();
+  versions->collect(transactions.horizon());
+  ASSERT_EQ(0, versions->size());
+
+  VersionStore::forget("versionedTable");
+}
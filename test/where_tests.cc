@@ -63,9 +63,35 @@ TEST(WhereDateTest)
 
   auto w = Where::get(stmt->whereClause, hsql::DataType::DATE);
 
-  ASSERT_FALSE(w->compare("07-07-2001"));
-  ASSERT_FALSE(w->compare("01-01-2000"));
-  ASSERT_TRUE(w->compare("31-12-2018"));
+  // Registers hold day numbers
+  ASSERT_FALSE(w->compare("11510"));
+  ASSERT_FALSE(w->compare("10957"));
+  ASSERT_TRUE(w->compare("17896"));
 
   delete w;
 }
+
+TEST(WhereComparesViewsIntoSlotsTest)
+{
+  auto result = new hsql::SQLParserResult;
+  hsql::SQLParser::parse("SELECT * FROM testTable WHERE id = 17;"
+                         "SELECT * FROM testTable WHERE bday = '07-07-2001';",
+                         result);
+
+  // Views into a stored slot aren't null terminated
+  std::string_view slot = "17\t11510\t     ";
+  auto where_int = Where::get(
+      ((hsql::SelectStatement*)result->getStatement(0))->whereClause,
+      hsql::DataType::INT);
+  ASSERT_TRUE(where_int->compare(slot.substr(0, 2)));
+  ASSERT_FALSE(where_int->compare(slot.substr(0, 1)));
+
+  auto where_date = Where::get(
+      ((hsql::SelectStatement*)result->getStatement(1))->whereClause,
+      hsql::DataType::DATE);
+  ASSERT_TRUE(where_date->compare(slot.substr(3, 5)));
+  ASSERT_FALSE(where_date->compare(slot.substr(3, 4)));
+
+  delete where_int;
+  delete where_date;
+}